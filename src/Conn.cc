@@ -27,6 +27,7 @@ namespace zeek
 
 uint64_t Connection::total_connections = 0;
 uint64_t Connection::current_connections = 0;
+std::vector<Connection*> Connection::packet_conns;
 
 Connection::Connection(const detail::ConnKey& k, double t, const ConnTuple* id, uint32_t flow,
                        const Packet* pkt)
@@ -63,6 +64,10 @@ Connection::Connection(const detail::ConnKey& k, double t, const ConnTuple* id,
 
 	finished = 0;
 
+	in_next_packet = 0;
+	conn_val_current = 0;
+	conn_val_stale = 0;
+
 	hist_seen = 0;
 	history = "";
 
@@ -212,6 +217,38 @@ void Connection::HistoryThresholdEvent(EventHandlerPtr e, bool is_orig, uint32_t
 	EnqueueEvent(e, nullptr, GetVal(), val_mgr->Bool(is_orig), val_mgr->Count(threshold));
 	}
 
+void Connection::BeginPacket()
+	{
+	in_next_packet = 1;
+	conn_val_current = 0;
+	packet_conns.push_back(this);
+	}
+
+void Connection::EndPacket()
+	{
+	in_next_packet = 0;
+	packet_conns.pop_back();
+
+	// Events queued while processing this packet all share the
+	// connection record, so bring it up to date once for them.
+	if ( conn_val_stale )
+		UpdateVal();
+	}
+
+void Connection::RefreshPacketVals()
+	{
+	for ( auto* c : packet_conns )
+		{
+		// Handlers about to run may look at the record, and later
+		// calls to GetVal() during the packet need to refresh it again.
+		if ( c->conn_val_current )
+			{
+			c->UpdateVal();
+			c->conn_val_current = 0;
+			}
+		}
+	}
+
 const RecordValPtr& Connection::GetVal()
 	{
 	if ( ! conn_val )
@@ -267,6 +304,25 @@ const RecordValPtr& Connection::GetVal()
 			conn_val->Assign(10, inner_vlan);
 		}
 
+	if ( in_next_packet && conn_val_current )
+		{
+		// Already refreshed while processing the current packet. The
+		// analyzers' endpoint state is brought up to date once more
+		// when the packet is done, see EndPacket().
+		conn_val_stale = 1;
+		conn_val->AssignTime(3, start_time);
+		conn_val->AssignInterval(4, last_time - start_time);
+		return conn_val;
+		}
+
+	UpdateVal();
+	conn_val_current = in_next_packet;
+
+	return conn_val;
+	}
+
+void Connection::UpdateVal()
+	{
 	if ( adapter )
 		adapter->UpdateConnVal(conn_val.get());
 
@@ -278,7 +334,7 @@ const RecordValPtr& Connection::GetVal()
 
 	conn_val->SetOrigin(this);
 
-	return conn_val;
+	conn_val_stale = 0;
 	}
 
 analyzer::Analyzer* Connection::FindAnalyzer(analyzer::ID id)
@@ -362,6 +418,7 @@ void Connection::FlipRoles()
 	orig_flow_label = tmp_flow;
 
 	conn_val = nullptr;
+	conn_val_current = conn_val_stale = 0;
 
 	if ( adapter )
 		adapter->FlipRoles();
@@ -6,6 +6,7 @@
 #include <string>
 #include <tuple>
 #include <type_traits>
+#include <vector>
 
 #include "zeek/Dict.h"
 #include "zeek/IPAddr.h"
@@ -117,6 +118,22 @@ public:
 	                // arguments for reproducing packets
 	                const Packet* pkt);
 
+	/**
+	 * Mark the beginning and the end of processing a packet of the
+	 * connection. In between, GetVal() transfers the analyzers' state
+	 * into the connection record only on its first call, and EndPacket()
+	 * does so once more if there were further calls.
+	 */
+	void BeginPacket();
+	void EndPacket();
+
+	/**
+	 * Brings the records of all connections with a packet in process up
+	 * to date. Needs to be called before draining events in the middle of
+	 * a packet, as their handlers would see outdated state otherwise.
+	 */
+	static void RefreshPacketVals();
+
 	// Keys are only considered valid for a connection when a
 	// connection is in the session map. If it is removed, the key
 	// should be marked invalid.
@@ -158,7 +175,11 @@ public:
 	bool IsReuse(double t, const u_char* pkt);
 
 	/**
-	 * Returns the associated "connection" record.
+	 * Returns the associated "connection" record. The record is built on
+	 * first access. While a packet is being processed, the analyzers'
+	 * per-endpoint state is transferred into it only on the first call
+	 * and once more after the packet has been processed, rather than on
+	 * every call. See BeginPacket().
 	 */
 	const RecordValPtr& GetVal() override;
 
@@ -252,6 +273,14 @@ public:
 	bool PermitWeird(const char* name, uint64_t threshold, uint64_t rate, double duration);
 
 private:
+	// Transfers the current connection state into conn_val, which
+	// must exist.
+	void UpdateVal();
+
+	// Connections whose packets are being processed, innermost last.
+	// Tunnels nest them.
+	static std::vector<Connection*> packet_conns;
+
 	friend class session::detail::Timer;
 
 	IPAddr orig_addr;
@@ -271,6 +300,9 @@ private:
 	unsigned int weird : 1;
 	unsigned int finished : 1;
 	unsigned int saw_first_orig_packet : 1, saw_first_resp_packet : 1;
+	unsigned int in_next_packet : 1; // between BeginPacket() and EndPacket()
+	unsigned int conn_val_current : 1; // conn_val updated for current packet
+	unsigned int conn_val_stale : 1; // conn_val needs update after packet
 
 	uint32_t hist_seen;
 	std::string history;
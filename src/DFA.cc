@@ -7,10 +7,38 @@
 #include "zeek/Desc.h"
 #include "zeek/EquivClass.h"
 #include "zeek/Hash.h"
+#include "zeek/NetVar.h"
+#include "zeek/telemetry/Manager.h"
 
 namespace zeek::detail
 	{
 
+// The number of states an uncached machine keeps around for matchers.
+constexpr size_t DFA_NUM_TRANSIENTS = 16;
+
+// Metrics are set up on first use, as machines for the scripts' patterns
+// exist early on.
+static telemetry::IntCounter& eviction_counter()
+	{
+	static auto counter = telemetry_mgr->CounterSingleton("zeek", "dfa-state-evictions",
+	                                                      "DFA states evicted from their cache");
+	return counter;
+	}
+
+static telemetry::IntCounter& rebuild_counter()
+	{
+	static auto counter = telemetry_mgr->CounterSingleton(
+		"zeek", "dfa-state-rebuilds", "DFA states built by machines that have evicted states");
+	return counter;
+	}
+
+static telemetry::IntCounter& uncached_counter()
+	{
+	static auto counter = telemetry_mgr->CounterSingleton(
+		"zeek", "dfa-uncached-machines", "DFA machines that stopped caching states");
+	return counter;
+	}
+
 unsigned int DFA_State::transition_counter = 0;
 
 DFA_State::DFA_State(int arg_state_num, const EquivClass* ec, NFA_state_list* arg_nfa_states,
@@ -89,6 +117,9 @@ DFA_State* DFA_State::ComputeXtion(int sym, DFA_Machine* machine)
 
 	DFA_State* next_d;
 
+	// Adding the next state to the cache may evict this one.
+	Ref(this);
+
 	NFA_state_list* ns = SymFollowSet(equiv_sym, ec);
 	if ( ns->length() > 0 )
 		{
@@ -102,11 +133,34 @@ DFA_State* DFA_State::ComputeXtion(int sym, DFA_Machine* machine)
 		next_d = nullptr; // Jam
 		}
 
-	AddXtion(equiv_sym, next_d);
-	if ( sym != equiv_sym )
-		AddXtion(sym, next_d);
+	if ( ! uncached && ! (next_d && next_d->uncached) )
+		{
+		AddXtion(equiv_sym, next_d);
+		if ( sym != equiv_sym )
+			AddXtion(sym, next_d);
+		}
+
+	Unref(this);
+	return next_d;
+	}
+
+void DFA_State::Uncache()
+	{
+	uncached = true;
+
+	for ( int i = 0; i < num_sym; ++i )
+		xtions[i] = DFA_UNCOMPUTED_STATE_PTR;
+	}
 
-	return xtions[sym];
+void DFA_State::DropXtionsTo(const std::unordered_set<DFA_State*>& targets)
+	{
+	for ( int i = 0; i < num_sym; ++i )
+		{
+		DFA_State* s = xtions[i];
+
+		if ( s && s != DFA_UNCOMPUTED_STATE_PTR && targets.count(s) )
+			xtions[i] = DFA_UNCOMPUTED_STATE_PTR;
+		}
 	}
 
 void DFA_State::AppendIfNew(int sym, int_list* sym_list)
@@ -291,7 +345,7 @@ unsigned int DFA_State::Size()
 
 DFA_State_Cache::DFA_State_Cache()
 	{
-	hits = misses = 0;
+	hits = misses = evicted = 0;
 	}
 
 DFA_State_Cache::~DFA_State_Cache()
@@ -352,9 +406,66 @@ DFA_State* DFA_State_Cache::Lookup(const NFA_state_list& nfas, DigestStr* digest
 DFA_State* DFA_State_Cache::Insert(DFA_State* state, DigestStr digest)
 	{
 	states.emplace(std::move(digest), state);
+	mem += StateMemory(state);
 	return state;
 	}
 
+int DFA_State_Cache::Evict(size_t target, const DFA_State* keep1, const DFA_State* keep2)
+	{
+	std::unordered_set<DFA_State*> victims;
+
+	// A clock sweep: states used since the hand last passed them get
+	// another chance. Two rounds evict anything but the kept states.
+	auto it = states.lower_bound(clock_hand);
+	size_t visits_left = 2 * states.size();
+
+	while ( mem > target && visits_left-- > 0 )
+		{
+		if ( it == states.end() )
+			it = states.begin();
+
+		DFA_State* s = it->second;
+
+		if ( s == keep1 || s == keep2 )
+			++it;
+
+		else if ( s->used )
+			{
+			s->used = false;
+			++it;
+			}
+
+		else
+			{
+			mem -= StateMemory(s);
+			victims.insert(s);
+			it = states.erase(it);
+			}
+		}
+
+	clock_hand = (it == states.end() ? DigestStr() : it->first);
+
+	if ( victims.empty() )
+		return 0;
+
+	for ( auto& entry : states )
+		entry.second->DropXtionsTo(victims);
+
+	for ( auto s : victims )
+		{
+		s->Uncache();
+		Unref(s);
+		}
+
+	evicted += victims.size();
+	return victims.size();
+	}
+
+size_t DFA_State_Cache::StateMemory(DFA_State* state)
+	{
+	return util::pad_size(state->Size()) + padded_sizeof(*state);
+	}
+
 void DFA_State_Cache::GetStats(Stats* s)
 	{
 	s->dfa_states = 0;
@@ -364,6 +475,7 @@ void DFA_State_Cache::GetStats(Stats* s)
 	s->mem = 0;
 	s->hits = hits;
 	s->misses = misses;
+	s->evicted = evicted;
 
 	for ( const auto& state : states )
 		{
@@ -403,6 +515,9 @@ DFA_Machine::DFA_Machine(NFA_Machine* n, EquivClass* arg_ec)
 
 DFA_Machine::~DFA_Machine()
 	{
+	for ( auto s : transients )
+		Unref(s);
+
 	delete dfa_state_cache;
 	Unref(nfa);
 	}
@@ -456,11 +571,53 @@ bool DFA_Machine::StateSetToDFA_State(NFA_state_list* state_set, DFA_State*& d,
 		}
 
 	DFA_State* ds = new DFA_State(state_count++, ec, state_set, accept);
+
+	if ( eviction_passes > 0 )
+		rebuild_counter().Inc();
+
+	if ( uncached )
+		{
+		// Keep the state only until enough others have come along.
+		ds->uncached = true;
+
+		if ( transients.size() < DFA_NUM_TRANSIENTS )
+			transients.push_back(ds);
+		else
+			{
+			Unref(transients[next_transient]);
+			transients[next_transient] = ds;
+			next_transient = (next_transient + 1) % DFA_NUM_TRANSIENTS;
+			}
+
+		d = ds;
+		return true;
+		}
+
 	d = dfa_state_cache->Insert(ds, std::move(digest));
 
+	if ( dfa_max_memory > 0 && dfa_state_cache->Memory() > dfa_max_memory )
+		EvictStates(d);
+
 	return true;
 	}
 
+void DFA_Machine::EvictStates(DFA_State* keep)
+	{
+	// Evict a good chunk at once, as each eviction has to go over all
+	// the remaining states.
+	int n = dfa_state_cache->Evict(dfa_max_memory / 4 * 3, start_state, keep);
+	eviction_counter().Inc(n);
+
+	++eviction_passes;
+
+	if ( ! uncached && dfa_max_eviction_passes > 0 &&
+	     eviction_passes >= dfa_max_eviction_passes )
+		{
+		uncached = true;
+		uncached_counter().Inc();
+		}
+	}
+
 int DFA_Machine::Rep(int sym)
 	{
 	for ( int i = 0; i < NUM_SYM; ++i )
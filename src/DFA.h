@@ -6,6 +6,8 @@
 #include <sys/types.h> // for u_char
 #include <map>
 #include <string>
+#include <unordered_set>
+#include <vector>
 
 #include "zeek/NFA.h"
 #include "zeek/Obj.h"
@@ -55,10 +57,17 @@ public:
 
 protected:
 	friend class DFA_State_Cache;
+	friend class DFA_Machine;
 
 	DFA_State* ComputeXtion(int sym, DFA_Machine* machine);
 	void AppendIfNew(int sym, int_list* sym_list);
 
+	// Marks the state as no longer cached and forgets its transitions.
+	void Uncache();
+
+	// Forgets transitions into any of the given states.
+	void DropXtionsTo(const std::unordered_set<DFA_State*>& targets);
+
 	int state_num;
 	int num_sym;
 
@@ -69,6 +78,15 @@ protected:
 	EquivClass* meta_ec; // which ec's make same transition
 	DFA_State* mark;
 
+	// Set whenever the state gets used, and cleared by the cache's
+	// eviction, to tell recently used states from cold ones.
+	bool used = false;
+
+	// True if the state isn't in its machine's cache (anymore). Such a
+	// state only lives as long as a matcher keeps a reference to it, so
+	// transitions from or to it aren't remembered.
+	bool uncached = false;
+
 	static unsigned int transition_counter; // see Xtion()
 	};
 
@@ -86,8 +104,18 @@ public:
 	// Takes ownership of state; digest is the one returned by Lookup().
 	DFA_State* Insert(DFA_State* state, DigestStr digest);
 
+	// Evicts states that haven't been used recently until the remaining
+	// ones take at most target bytes. The given states stay. Transitions
+	// into evicted states get recomputed when needed, and matchers still
+	// referring to an evicted state keep it alive until they move on.
+	// Returns the number of states evicted.
+	int Evict(size_t target, const DFA_State* keep1, const DFA_State* keep2);
+
 	int NumEntries() const { return states.size(); }
 
+	// Returns the bytes taken by the cached states.
+	size_t Memory() const { return mem; }
+
 	struct Stats
 		{
 		// Sum of all NFA states
@@ -98,13 +126,22 @@ public:
 		unsigned int mem;
 		unsigned int hits;
 		unsigned int misses;
+		unsigned int evicted;
 		};
 
 	void GetStats(Stats* s);
 
 private:
+	static size_t StateMemory(DFA_State* state);
+
 	int hits; // Statistics
 	int misses;
+	int evicted;
+
+	size_t mem = 0;
+
+	// Where the last eviction stopped, for the next one to go on from.
+	DigestStr clock_hand;
 
 	// Hash indexed by NFA states (MD5s of them, actually).
 	std::map<DigestStr, DFA_State*> states;
@@ -141,15 +178,30 @@ protected:
 	bool StateSetToDFA_State(NFA_state_list* state_set, DFA_State*& d, const EquivClass* ec);
 	const EquivClass* EC() const { return ec; }
 
+	// Brings the cache back under dfa_max_memory, keeping the given
+	// new state.
+	void EvictStates(DFA_State* keep);
+
 	EquivClass* ec; // equivalence classes corresponding to NFAs
 	DFA_State* start_state;
 	DFA_State_Cache* dfa_state_cache;
 
 	NFA_Machine* nfa;
+
+	uint64_t eviction_passes = 0;
+
+	// Once evictions become too frequent, the machine stops caching new
+	// states. It then computes them from the NFA on each step, keeping
+	// only the last few around for matchers that are using them.
+	bool uncached = false;
+	std::vector<DFA_State*> transients;
+	size_t next_transient = 0;
 	};
 
 inline DFA_State* DFA_State::Xtion(int sym, DFA_Machine* machine)
 	{
+	used = true;
+
 	if ( xtions[sym] == DFA_UNCOMPUTED_STATE_PTR )
 		return ComputeXtion(sym, machine);
 	else
@@ -441,6 +441,18 @@ void DNS_Mgr::InitSource()
 	did_init = true;
 	}
 
+void DNS_Mgr::InitPostFork()
+	{
+	if ( ! nb_dns )
+		return;
+
+	iosource_mgr->UnregisterFd(nb_dns_fd(nb_dns), this);
+	nb_dns_finish(nb_dns);
+	nb_dns = nullptr;
+	did_init = false;
+	InitSource();
+	}
+
 void DNS_Mgr::InitPostScript()
 	{
 	dm_rec = id::find_type<RecordType>("dns_mapping");
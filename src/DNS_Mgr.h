@@ -59,6 +59,11 @@ public:
 	~DNS_Mgr() override;
 
 	void InitPostScript();
+
+	// Opens a new resolver socket in a forked process, which otherwise
+	// could receive its parent's replies.
+	void InitPostFork();
+
 	void Flush();
 
 	// Looks up the address or addresses of the given host, and returns
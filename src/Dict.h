@@ -304,6 +304,9 @@ public:
 	// True if the dictionary is ordered, false otherwise.
 	int IsOrdered() const { return order != nullptr; }
 
+	// True if any iterators over the dictionary are currently live.
+	bool IsIterating() const { return num_iterators > 0; }
+
 	// If the dictionary is ordered then returns the n'th entry's value;
 	// the second method also returns the key.  The first entry inserted
 	// corresponds to n=0.
@@ -8,11 +8,26 @@
 #include "zeek/Func.h"
 #include "zeek/NetVar.h"
 #include "zeek/RunState.h"
+#include "zeek/Stats.h"
 #include "zeek/Trigger.h"
 #include "zeek/Val.h"
 #include "zeek/iosource/Manager.h"
 #include "zeek/iosource/PktSrc.h"
 #include "zeek/plugin/Manager.h"
+#include "zeek/telemetry/Manager.h"
+
+namespace
+	{
+
+// Released Event instances kept around for reuse.  Events are only
+// created and destroyed by the main thread.  This needs to be defined
+// before the event manager so that it outlives the manager's destructor,
+// which releases the pool.  Events freed after that bypass it.
+constexpr size_t max_free_events = 4096;
+std::vector<void*> free_events;
+bool free_events_released = false;
+
+	} // namespace
 
 zeek::EventMgr zeek::event_mgr;
 zeek::EventMgr& mgr = zeek::event_mgr;
@@ -20,6 +35,26 @@ zeek::EventMgr& mgr = zeek::event_mgr;
 namespace zeek
 	{
 
+void* Event::operator new(size_t size)
+	{
+	if ( size == sizeof(Event) && ! free_events.empty() )
+		{
+		void* ptr = free_events.back();
+		free_events.pop_back();
+		return ptr;
+		}
+
+	return ::operator new(size);
+	}
+
+void Event::operator delete(void* ptr)
+	{
+	if ( ! free_events_released && free_events.size() < max_free_events )
+		free_events.push_back(ptr);
+	else
+		::operator delete(ptr);
+	}
+
 Event::Event(EventHandlerPtr arg_handler, zeek::Args arg_args, util::detail::SourceID arg_src,
              analyzer::ID arg_aid, Obj* arg_obj)
 	: handler(arg_handler), args(std::move(arg_args)), src(arg_src), aid(arg_aid), obj(arg_obj),
@@ -89,11 +124,26 @@ EventMgr::~EventMgr()
 		}
 
 	Unref(src_val);
+
+	for ( auto ptr : free_events )
+		::operator delete(ptr);
+
+	free_events.clear();
+	free_events.shrink_to_fit();
+	free_events_released = true;
 	}
 
 void EventMgr::Enqueue(const EventHandlerPtr& h, Args vl, util::detail::SourceID src,
                        analyzer::ID aid, Obj* obj)
 	{
+	if ( ! h->NeedsDispatch() && ! plugin_mgr->HavePluginForHook(plugin::HOOK_QUEUE_EVENT) )
+		{
+		++num_events_elided;
+		return;
+		}
+
+	detail::PacketStageProfiler::Sample stage_sample(detail::packet_stage_profiler,
+	                                                 detail::PacketStageProfiler::EVENT_QUEUEING);
 	QueueEvent(new Event(h, std::move(vl), src, aid, obj));
 	}
 
@@ -136,6 +186,10 @@ void EventMgr::Drain()
 
 	draining = true;
 
+	// Objects released while draining get deleted in one go at the end,
+	// or earlier once too many have piled up.
+	detail::DeferReleases defer_releases;
+
 	// Past Zeek versions drained as long as there events, including when
 	// a handler queued new events during its execution. This could lead
 	// to endless loops in case a handler kept triggering its own event.
@@ -143,23 +197,28 @@ void EventMgr::Drain()
 	// just one round to make it less likley to break existing scripts
 	// that expect the old behavior to trigger something quickly.
 
-	for ( int round = 0; head && round < 2; round++ )
 		{
-		Event* current = head;
-		head = nullptr;
-		tail = nullptr;
+		detail::PacketStageProfiler::Sample stage_sample(detail::packet_stage_profiler,
+		                                                 detail::PacketStageProfiler::EVENT_DRAIN);
 
-		while ( current )
+		for ( int round = 0; head && round < 2; round++ )
 			{
-			Event* next = current->NextEvent();
-
-			current_src = current->Source();
-			current_aid = current->Analyzer();
-			current->Dispatch();
-			Unref(current);
-
-			++event_mgr.num_events_dispatched;
-			current = next;
+			Event* current = head;
+			head = nullptr;
+			tail = nullptr;
+
+			while ( current )
+				{
+				Event* next = current->NextEvent();
+
+				current_src = current->Source();
+				current_aid = current->Analyzer();
+				current->Dispatch();
+				Unref(current);
+
+				++event_mgr.num_events_dispatched;
+				current = next;
+				}
 			}
 		}
 
@@ -170,6 +229,14 @@ void EventMgr::Drain()
 	// Make sure all of the triggers get processed every time the events
 	// drain.
 	detail::trigger_mgr->Process();
+
+	detail::update_val_metrics();
+
+	if ( detail::packet_stage_profiler )
+		detail::packet_stage_profiler->Finish();
+
+	if ( telemetry_mgr )
+		telemetry_mgr->SyncShardedMetrics();
 	}
 
 void EventMgr::Describe(ODesc* d) const
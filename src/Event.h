@@ -34,6 +34,11 @@ public:
 
 	void Describe(ODesc* d) const override;
 
+	// Events are allocated from a free list of previously released
+	// instances to avoid a heap allocation per queued event.
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr);
+
 protected:
 	friend class EventMgr;
 
@@ -66,6 +71,10 @@ public:
 	 * @param aid  identifies the protocol analyzer generating the event.
 	 * @param obj  an arbitrary object to use as a "cookie" or just hold a
 	 * reference to until dispatching the event.
+	 *
+	 * If dispatching the event could not have any effect (no bodies, no
+	 * remote subscribers, no plugin hooking into the queue), the event is
+	 * dropped right away without being queued and counted as elided.
 	 */
 	void Enqueue(const EventHandlerPtr& h, zeek::Args vl,
 	             util::detail::SourceID src = util::detail::SOURCE_LOCAL, analyzer::ID aid = 0,
@@ -106,6 +115,7 @@ public:
 
 	uint64_t num_events_queued = 0;
 	uint64_t num_events_dispatched = 0;
+	uint64_t num_events_elided = 0;
 
 protected:
 	void QueueEvent(Event* event);
@@ -27,6 +27,12 @@ EventHandler::operator bool() const
 	return enabled && ((local && local->HasBodies()) || generate_always || ! auto_publish.empty());
 	}
 
+bool EventHandler::NeedsDispatch() const
+	{
+	return (local && local->HasBodies()) || generate_always || ! auto_publish.empty() ||
+	       new_event;
+	}
+
 const FuncTypePtr& EventHandler::GetType(bool check_export)
 	{
 	if ( type )
@@ -61,7 +67,10 @@ void EventHandler::Call(Args* vl, bool no_remote)
 
 	if ( ! no_remote )
 		{
-		if ( ! auto_publish.empty() )
+		// The compact encoding leaves arguments it doesn't support to
+		// Broker data.
+		if ( ! auto_publish.empty() &&
+		     ! (broker_mgr->UsesCompactEventEncoding() && PublishCompact(*vl)) )
 			{
 			// Send event in form [name, xs...] where xs represent the arguments.
 			broker::vector xs;
@@ -107,6 +116,24 @@ void EventHandler::Call(Args* vl, bool no_remote)
 		local->Invoke(vl);
 	}
 
+bool EventHandler::PublishCompact(const Args& vl)
+	{
+	const auto& ft = GetType(false);
+
+	if ( ! ft )
+		return false;
+
+	const auto& types = ft->ParamList()->GetTypes();
+
+	// The encoding either works for all topics or for none, since it
+	// only depends on the arguments.
+	for ( const auto& topic : auto_publish )
+		if ( ! broker_mgr->PublishCompactEvent(topic, Name(), types, vl) )
+			return false;
+
+	return true;
+	}
+
 void EventHandler::NewEvent(Args* vl)
 	{
 	if ( ! new_event )
@@ -37,6 +37,13 @@ public:
 	// Returns true if there is at least one local or remote handler.
 	explicit operator bool() const;
 
+	// Returns true if calling this handler can have any effect, i.e.,
+	// there are local bodies, remote subscribers, plugins interested
+	// in it, or a new_event() handler to report it to. Unlike the bool
+	// operator, this ignores whether the handler has been disabled, as
+	// Call() does.
+	bool NeedsDispatch() const;
+
 	void SetUsed() { used = true; }
 	bool Used() { return used; }
 
@@ -54,6 +61,7 @@ public:
 
 private:
 	void NewEvent(zeek::Args* vl); // Raise new_event() meta event.
+	bool PublishCompact(const zeek::Args& vl); // Auto-publish in compact encoding.
 
 	std::string name;
 	FuncPtr local;
@@ -4520,6 +4520,20 @@ CallExpr::CallExpr(ExprPtr arg_func, ListExprPtr arg_args, bool in_hook)
 		else
 			SetType(yield);
 
+		// Some built-ins declared as returning "any" have a return
+		// type that follows from their argument.
+		if ( func->Tag() == EXPR_NAME )
+			{
+			auto id = func->AsNameExpr()->Id();
+
+			if ( id->IsGlobal() )
+				if ( auto bt = built_in_call_type(id->Name(), this) )
+					SetType(std::move(bt));
+
+			if ( IsError() )
+				return;
+			}
+
 		// Check for call to built-ins that can be statically analyzed.
 		ValPtr func_val;
 
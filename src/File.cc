@@ -176,6 +176,9 @@ void File::Init()
 	buffered = true;
 	raw_output = false;
 
+	// Dropping a file closes it, which scripts may rely on right away.
+	ReleaseImmediately();
+
 #ifdef USE_PERFTOOLS_DEBUG
 	heap_checker->IgnoreObject(this);
 #endif
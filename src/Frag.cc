@@ -2,6 +2,8 @@
 
 #include "zeek/Frag.h"
 
+#include <algorithm>
+
 #include "zeek/zeek-config.h"
 
 #include "zeek/Hash.h"
@@ -10,10 +12,14 @@
 #include "zeek/Reporter.h"
 #include "zeek/RunState.h"
 #include "zeek/session/Manager.h"
+#include "zeek/telemetry/Manager.h"
 
 constexpr uint32_t MIN_ACCEPTABLE_FRAG_SIZE = 64;
 constexpr uint32_t MAX_ACCEPTABLE_FRAG_SIZE = 64000;
 
+// Initial number of slots of the fragment table; a power of two.
+constexpr size_t INITIAL_FRAG_TABLE_SIZE = 1024;
+
 namespace zeek::detail
 	{
 
@@ -32,7 +38,7 @@ void FragTimer::Dispatch(double t, bool /* is_expire */)
 	}
 
 FragReassembler::FragReassembler(session::Manager* arg_s, const std::shared_ptr<IP_Hdr>& ip,
-                                 const u_char* pkt, const FragReassemblerKey& k, double t)
+                                 const FragReassemblerKey& k, double t)
 	: Reassembler(0, REASSEM_FRAG)
 	{
 	s = arg_s;
@@ -64,8 +70,6 @@ FragReassembler::FragReassembler(session::Manager* arg_s, const std::shared_ptr<
 		}
 	else
 		expire_timer = nullptr;
-
-	AddFragment(t, ip, pkt);
 	}
 
 FragReassembler::~FragReassembler()
@@ -157,6 +161,14 @@ void FragReassembler::AddFragment(double t, const std::shared_ptr<IP_Hdr>& ip, c
 	NewBlock(run_state::network_time, offset, len, pkt);
 	}
 
+uint64_t FragReassembler::MemoryUsage() const
+	{
+	uint64_t hdr_size = ((const struct ip*)proto_hdr)->ip_v == 4 ? 64 : proto_hdr_len;
+
+	return padded_sizeof(*this) + hdr_size + TotalSize() +
+	       block_list.NumBlocks() * sizeof(DataBlockMap::value_type);
+	}
+
 void FragReassembler::Weird(const char* name) const
 	{
 	unsigned int version = ((const ip*)proto_hdr)->ip_v;
@@ -317,8 +329,12 @@ void FragReassembler::BlockInserted(DataBlockMap::const_iterator /* it */)
 void FragReassembler::Expire(double t)
 	{
 	block_list.Clear();
-	expire_timer->ClearReassembler();
-	expire_timer = nullptr; // timer manager will delete it
+
+	if ( expire_timer )
+		{
+		expire_timer->ClearReassembler();
+		expire_timer = nullptr; // timer manager will delete it
+		}
 
 	fragment_mgr->Remove(this);
 	}
@@ -333,41 +349,204 @@ void FragReassembler::DeleteTimer()
 		}
 	}
 
+FragmentTable::FragmentTable() : slots(INITIAL_FRAG_TABLE_SIZE, nullptr) { }
+
+hash_t FragmentTable::Hash(const FragReassemblerKey& key)
+	{
+	struct
+		{
+		uint32_t src[4];
+		uint32_t dst[4];
+		uint64_t id;
+		} buf;
+
+	std::get<0>(key).CopyIPv6(buf.src);
+	std::get<1>(key).CopyIPv6(buf.dst);
+	buf.id = std::get<2>(key);
+
+	return HashKey::HashBytes(&buf, sizeof(buf));
+	}
+
+FragReassembler* FragmentTable::Lookup(const FragReassemblerKey& key, hash_t hash) const
+	{
+	size_t mask = slots.size() - 1;
+
+	for ( size_t i = hash & mask; slots[i]; i = (i + 1) & mask )
+		{
+		FragReassembler* f = slots[i];
+
+		if ( f->key_hash == hash && f->Key() == key )
+			return f;
+		}
+
+	return nullptr;
+	}
+
+void FragmentTable::Insert(FragReassembler* f)
+	{
+	// Keep the load factor at or below one half so that probe
+	// sequences stay short.
+	if ( 2 * (num_entries + 1) > slots.size() )
+		Grow();
+
+	size_t mask = slots.size() - 1;
+	size_t i = f->key_hash & mask;
+
+	while ( slots[i] )
+		i = (i + 1) & mask;
+
+	slots[i] = f;
+	++num_entries;
+	}
+
+bool FragmentTable::Remove(FragReassembler* f)
+	{
+	size_t mask = slots.size() - 1;
+	size_t i = f->key_hash & mask;
+
+	while ( slots[i] != f )
+		{
+		if ( ! slots[i] )
+			return false;
+
+		i = (i + 1) & mask;
+		}
+
+	// Shift following entries of the probe sequence back instead of
+	// leaving a tombstone, so lookups never have to skip deleted slots.
+	for ( size_t j = (i + 1) & mask; slots[j]; j = (j + 1) & mask )
+		{
+		size_t home = slots[j]->key_hash & mask;
+
+		if ( ((j - home) & mask) >= ((j - i) & mask) )
+			{
+			slots[i] = slots[j];
+			i = j;
+			}
+		}
+
+	slots[i] = nullptr;
+	--num_entries;
+	return true;
+	}
+
+std::vector<FragReassembler*> FragmentTable::Entries() const
+	{
+	std::vector<FragReassembler*> entries;
+	entries.reserve(num_entries);
+
+	for ( auto* f : slots )
+		if ( f )
+			entries.push_back(f);
+
+	return entries;
+	}
+
+void FragmentTable::Clear()
+	{
+	std::fill(slots.begin(), slots.end(), nullptr);
+	num_entries = 0;
+	}
+
+void FragmentTable::Grow()
+	{
+	std::vector<FragReassembler*> old_slots(slots.size() * 2, nullptr);
+	old_slots.swap(slots);
+
+	size_t mask = slots.size() - 1;
+
+	for ( auto* f : old_slots )
+		{
+		if ( ! f )
+			continue;
+
+		size_t i = f->key_hash & mask;
+
+		while ( slots[i] )
+			i = (i + 1) & mask;
+
+		slots[i] = f;
+		}
+	}
+
 FragmentManager::~FragmentManager()
 	{
 	Clear();
 	}
 
+void FragmentManager::InitPostScript()
+	{
+	evictions_metric = telemetry_mgr->CounterSingleton(
+		"zeek", "fragment-evictions",
+		"Fragment reassemblers discarded to stay below frag_max_memory");
+	memory_metric = telemetry_mgr->GaugeSingleton("zeek", "fragment-memory",
+	                                              "Memory held by pending fragments", "bytes");
+	}
+
 FragReassembler* FragmentManager::NextFragment(double t, const std::shared_ptr<IP_Hdr>& ip,
                                                const u_char* pkt)
 	{
 	uint32_t frag_id = ip->ID();
 	FragReassemblerKey key = std::make_tuple(ip->SrcAddr(), ip->DstAddr(), frag_id);
+	hash_t hash = FragmentTable::Hash(key);
 
-	FragReassembler* f = nullptr;
-	auto it = fragments.find(key);
-	if ( it != fragments.end() )
-		f = it->second;
+	FragReassembler* f = fragments.Lookup(key, hash);
 
 	if ( ! f )
 		{
-		f = new FragReassembler(session_mgr, ip, pkt, key, t);
-		fragments[key] = f;
-		if ( fragments.size() > max_fragments )
-			max_fragments = fragments.size();
-		return f;
+		f = new FragReassembler(session_mgr, ip, key, t);
+		f->key_hash = hash;
+		fragments.Insert(f);
+		if ( fragments.Size() > max_fragments )
+			max_fragments = fragments.Size();
 		}
 
+	// A broken reassembly expires the reassembler right away, which
+	// removes it from the manager. Keep it alive until we've checked.
+	Ref(f);
 	f->AddFragment(t, ip, pkt);
+
+	if ( f->removed )
+		{
+		Unref(f);
+		return nullptr;
+		}
+
+	Unref(f);
+
+	if ( f->reassembled_pkt )
+		{
+		// A reassembler that has produced its packet gets removed once
+		// the packet has been processed. Until then, it neither counts
+		// toward frag_max_memory nor is a candidate for eviction.
+		Unlink(f);
+		Account(f, 0);
+		return f;
+		}
+
+	Touch(f);
+	Account(f, f->MemoryUsage());
+
+	if ( frag_max_memory && memory_usage > frag_max_memory )
+		Evict(f);
+
 	return f;
 	}
 
 void FragmentManager::Clear()
 	{
-	for ( const auto& entry : fragments )
-		Unref(entry.second);
+	auto all = fragments.Entries();
+
+	fragments.Clear();
+	lru_head = lru_tail = nullptr;
+
+	if ( memory_metric )
+		memory_metric->Dec(static_cast<int64_t>(memory_usage));
 
-	fragments.clear();
+	memory_usage = 0;
+
+	for ( auto* f : all )
+		Unref(f);
 	}
 
 void FragmentManager::Remove(detail::FragReassembler* f)
@@ -375,15 +554,82 @@ void FragmentManager::Remove(detail::FragReassembler* f)
 	if ( ! f )
 		return;
 
-	if ( fragments.erase(f->Key()) == 0 )
+	if ( ! fragments.Remove(f) )
 		reporter->InternalWarning("fragment reassembler not in dict");
 
+	Unlink(f);
+	Account(f, 0);
+	f->removed = true;
 	Unref(f);
 	}
 
+void FragmentManager::Touch(FragReassembler* f)
+	{
+	if ( f == lru_head )
+		return;
+
+	Unlink(f);
+
+	f->lru_prev = nullptr;
+	f->lru_next = lru_head;
+
+	if ( lru_head )
+		lru_head->lru_prev = f;
+	else
+		lru_tail = f;
+
+	lru_head = f;
+	f->in_lru = true;
+	}
+
+void FragmentManager::Unlink(FragReassembler* f)
+	{
+	if ( ! f->in_lru )
+		return;
+
+	if ( f->lru_prev )
+		f->lru_prev->lru_next = f->lru_next;
+	else
+		lru_head = f->lru_next;
+
+	if ( f->lru_next )
+		f->lru_next->lru_prev = f->lru_prev;
+	else
+		lru_tail = f->lru_prev;
+
+	f->lru_prev = f->lru_next = nullptr;
+	f->in_lru = false;
+	}
+
+void FragmentManager::Account(FragReassembler* f, uint64_t usage)
+	{
+	int64_t delta = static_cast<int64_t>(usage) - static_cast<int64_t>(f->accounted_memory);
+
+	memory_usage += delta;
+
+	if ( memory_metric )
+		memory_metric->Inc(delta);
+
+	f->accounted_memory = usage;
+	}
+
+void FragmentManager::Evict(const FragReassembler* keep)
+	{
+	while ( memory_usage > frag_max_memory && lru_tail && lru_tail != keep )
+		{
+		++num_evictions;
+
+		if ( evictions_metric )
+			evictions_metric->Inc();
+
+		// Removing cancels the reassembler's timer on destruction.
+		Remove(lru_tail);
+		}
+	}
+
 uint32_t FragmentManager::MemoryAllocation() const
 	{
-	return fragments.size() * (sizeof(FragmentMap::key_type) + sizeof(FragmentMap::value_type));
+	return fragments.Capacity() * sizeof(FragReassembler*);
 	}
 
 	} // namespace zeek::detail
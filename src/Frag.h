@@ -3,11 +3,16 @@
 #pragma once
 
 #include <sys/types.h> // for u_char
+#include <optional>
 #include <tuple>
+#include <vector>
 
+#include "zeek/Hash.h"
 #include "zeek/IPAddr.h"
 #include "zeek/Reassem.h"
 #include "zeek/Timer.h"
+#include "zeek/telemetry/Counter.h"
+#include "zeek/telemetry/Gauge.h"
 #include "zeek/util.h" // for bro_uint_t
 
 namespace zeek
@@ -31,7 +36,7 @@ using FragReassemblerKey = std::tuple<IPAddr, IPAddr, bro_uint_t>;
 class FragReassembler : public Reassembler
 	{
 public:
-	FragReassembler(session::Manager* s, const std::shared_ptr<IP_Hdr>& ip, const u_char* pkt,
+	FragReassembler(session::Manager* s, const std::shared_ptr<IP_Hdr>& ip,
 	                const FragReassemblerKey& k, double t);
 	~FragReassembler() override;
 
@@ -44,7 +49,13 @@ public:
 	std::shared_ptr<IP_Hdr> ReassembledPkt() { return std::move(reassembled_pkt); }
 	const FragReassemblerKey& Key() const { return key; }
 
+	// Approximate number of bytes held by the reassembler.
+	uint64_t MemoryUsage() const;
+
 protected:
+	friend class FragmentManager;
+	friend class FragmentTable;
+
 	void BlockInserted(DataBlockMap::const_iterator it) override;
 	void Overlap(const u_char* b1, const u_char* b2, uint64_t n) override;
 	void Weird(const char* name) const;
@@ -58,6 +69,14 @@ protected:
 	uint16_t proto_hdr_len;
 
 	FragTimer* expire_timer;
+
+	// Bookkeeping of the FragmentManager.
+	hash_t key_hash = 0;
+	uint64_t accounted_memory = 0;
+	bool in_lru = false;
+	bool removed = false;
+	FragReassembler* lru_prev = nullptr;
+	FragReassembler* lru_next = nullptr;
 	};
 
 class FragTimer final : public Timer
@@ -75,26 +94,84 @@ protected:
 	FragReassembler* f;
 	};
 
+/**
+ * An open-addressing hash table of fragment reassemblers, using linear
+ * probing. The reassemblers remember their key's hash, so lookups
+ * rarely need to compare full keys. The table starts out with room for
+ * a fixed number of reassemblers and only allocates when growing
+ * beyond that.
+ */
+class FragmentTable
+	{
+public:
+	FragmentTable();
+
+	static hash_t Hash(const FragReassemblerKey& key);
+
+	FragReassembler* Lookup(const FragReassemblerKey& key, hash_t hash) const;
+
+	// The reassembler's key_hash must be set, and its key must not be
+	// in the table yet.
+	void Insert(FragReassembler* f);
+
+	bool Remove(FragReassembler* f);
+
+	std::vector<FragReassembler*> Entries() const;
+
+	void Clear();
+
+	size_t Size() const { return num_entries; }
+	size_t Capacity() const { return slots.size(); }
+
+private:
+	void Grow();
+
+	std::vector<FragReassembler*> slots;
+	size_t num_entries = 0;
+	};
+
 class FragmentManager
 	{
 public:
 	FragmentManager() = default;
 	~FragmentManager();
 
+	void InitPostScript();
+
 	FragReassembler* NextFragment(double t, const std::shared_ptr<IP_Hdr>& ip, const u_char* pkt);
 	void Clear();
 	void Remove(detail::FragReassembler* f);
 
-	size_t Size() const { return fragments.size(); }
+	size_t Size() const { return fragments.Size(); }
 	size_t MaxFragments() const { return max_fragments; }
+	uint64_t MemoryUsage() const { return memory_usage; }
+	uint64_t Evictions() const { return num_evictions; }
 	[[deprecated("Remove in v5.1. MemoryAllocation() is deprecated and will be removed. See "
 	             "GHI-572.")]] uint32_t
 	MemoryAllocation() const;
 
 private:
-	using FragmentMap = std::map<detail::FragReassemblerKey, detail::FragReassembler*>;
-	FragmentMap fragments;
+	// Maintains the LRU list of reassemblers still waiting for
+	// fragments, most recently active first.
+	void Touch(FragReassembler* f);
+	void Unlink(FragReassembler* f);
+
+	// Updates the memory accounted for a reassembler.
+	void Account(FragReassembler* f, uint64_t usage);
+
+	// Discards the least recently active reassemblers until below
+	// frag_max_memory, sparing the given one.
+	void Evict(const FragReassembler* keep);
+
+	FragmentTable fragments;
+	FragReassembler* lru_head = nullptr;
+	FragReassembler* lru_tail = nullptr;
 	size_t max_fragments = 0;
+	uint64_t memory_usage = 0;
+	uint64_t num_evictions = 0;
+
+	std::optional<telemetry::IntCounter> evictions_metric;
+	std::optional<telemetry::IntGauge> memory_metric;
 	};
 
 extern FragmentManager* fragment_mgr;
@@ -418,6 +418,8 @@ ValPtr ScriptFunc::Invoke(zeek::Args* args, Frame* parent) const
 		if ( sample_logger )
 			sample_logger->LocationSeen(body.stmts->GetLocationInfo());
 
+		HandlerProfiler::Sample prof_sample(handler_profiler, this, body.stmts.get());
+
 		// Fill in the rest of the frame with the function's arguments.
 		for ( auto j = 0u; j < args->size(); ++j )
 			{
@@ -866,6 +868,65 @@ bool check_built_in_call(BuiltinFunc* f, CallExpr* call)
 	return true;
 	}
 
+TypePtr built_in_call_type(const char* name, CallExpr* call)
+	{
+	bool is_reduction = util::streq(name, "vector_sum") || util::streq(name, "vector_min") ||
+	                    util::streq(name, "vector_max");
+	bool is_keys = util::streq(name, "table_keys");
+	bool is_values = util::streq(name, "table_values");
+
+	if ( ! is_reduction && ! is_keys && ! is_values )
+		return nullptr;
+
+	const ExprPList& args = call->Args()->Exprs();
+	if ( args.length() != 1 )
+		// Reported elsewhere.
+		return nullptr;
+
+	const auto& t = args[0]->GetType();
+	if ( t->Tag() == TYPE_ANY )
+		// Checked at run-time by the BiF itself.
+		return nullptr;
+
+	if ( is_reduction )
+		{
+		if ( t->Tag() == TYPE_VECTOR )
+			switch ( t->Yield()->Tag() )
+				{
+				case TYPE_COUNT:
+				case TYPE_INT:
+				case TYPE_DOUBLE:
+				case TYPE_TIME:
+				case TYPE_INTERVAL:
+					return t->Yield();
+
+				default:
+					break;
+				}
+
+		call->Error(util::fmt("%s() requires a vector of a numeric type", name));
+		call->SetError();
+		return nullptr;
+		}
+
+	if ( is_keys )
+		{
+		if ( t->Tag() == TYPE_TABLE )
+			return make_intrusive<SetType>(t->AsTableType()->GetIndices(), nullptr);
+
+		call->Error("table_keys() requires a table or set argument");
+		call->SetError();
+		return nullptr;
+		}
+
+	if ( t->IsTable() )
+		return make_intrusive<VectorType>(t->Yield());
+
+	call->Error("table_values() requires a table argument");
+	call->SetError();
+	return nullptr;
+	}
+
 // Gets a function's priority from its Scope's attributes. Errors if it sees any
 // problems.
 static int get_func_priority(const std::vector<AttrPtr>& attrs)
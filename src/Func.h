@@ -350,6 +350,13 @@ protected:
 
 extern bool check_built_in_call(BuiltinFunc* f, CallExpr* call);
 
+// Returns the type of a call to the BiF with the given name, for those
+// BiFs declared as returning "any" whose actual return type follows from
+// their argument's type (such as vector_sum() and table_keys()).  Returns
+// nil if the BiF isn't one of those or if its argument's type isn't known
+// statically.  Flags the call as an error if the argument's type is wrong.
+extern TypePtr built_in_call_type(const char* name, CallExpr* call);
+
 struct CallInfo
 	{
 	const CallExpr* call;
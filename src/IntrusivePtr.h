@@ -131,8 +131,17 @@ public:
 
 	IntrusivePtr& operator=(const IntrusivePtr& other) noexcept
 		{
-		IntrusivePtr tmp{other};
-		swap(tmp);
+		// Assigning the object we already point to doesn't need to touch
+		// its reference count.
+		if ( ptr_ != other.ptr_ )
+			{
+			if ( other.ptr_ )
+				Ref(other.ptr_);
+
+			if ( auto old = std::exchange(ptr_, other.ptr_) )
+				Unref(old);
+			}
+
 		return *this;
 		}
 
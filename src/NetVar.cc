@@ -119,6 +119,7 @@ int tcp_SYN_ack_ok;
 int tcp_match_undelivered;
 
 double frag_timeout;
+bro_uint_t frag_max_memory;
 
 double tcp_SYN_timeout;
 double tcp_session_timer;
@@ -171,6 +172,8 @@ int other_addr_anonymization;
 double profiling_interval;
 int expensive_profiling_multiple;
 int segment_profiling;
+int handler_profiling_sample_rate;
+int packet_stage_sample_rate;
 int pkt_profile_mode;
 double pkt_profile_freq;
 
@@ -179,6 +182,9 @@ int load_sample_freq;
 int packet_filter_default;
 
 int sig_max_group_size;
+int sig_prefilter;
+bro_uint_t dfa_max_memory;
+bro_uint_t dfa_max_eviction_passes;
 
 int dpd_reassemble_first_packets;
 int dpd_buffer_size;
@@ -240,6 +246,9 @@ void init_general_global_var()
 	table_incremental_step = id::find_val("table_incremental_step")->AsCount();
 	packet_filter_default = id::find_val("packet_filter_default")->AsBool();
 	sig_max_group_size = id::find_val("sig_max_group_size")->AsCount();
+	sig_prefilter = id::find_val("sig_prefilter")->AsBool();
+	dfa_max_memory = id::find_val("dfa_max_memory")->AsCount();
+	dfa_max_eviction_passes = id::find_val("dfa_max_eviction_passes")->AsCount();
 	check_for_unused_event_handlers = id::find_val("check_for_unused_event_handlers")->AsBool();
 	record_all_packets = id::find_val("record_all_packets")->AsBool();
 	bits_per_uid = id::find_val("bits_per_uid")->AsCount();
@@ -261,6 +270,7 @@ void init_net_var()
 	tcp_match_undelivered = id::find_val("tcp_match_undelivered")->AsBool();
 
 	frag_timeout = id::find_val("frag_timeout")->AsInterval();
+	frag_max_memory = id::find_val("frag_max_memory")->AsCount();
 
 	tcp_SYN_timeout = id::find_val("tcp_SYN_timeout")->AsInterval();
 	tcp_session_timer = id::find_val("tcp_session_timer")->AsInterval();
@@ -331,6 +341,8 @@ void init_net_var()
 	expensive_profiling_multiple = id::find_val("expensive_profiling_multiple")->AsCount();
 	profiling_interval = id::find_val("profiling_interval")->AsInterval();
 	segment_profiling = id::find_val("segment_profiling")->AsBool();
+	handler_profiling_sample_rate = id::find_val("handler_profiling_sample_rate")->AsCount();
+	packet_stage_sample_rate = id::find_val("packet_stage_sample_rate")->AsCount();
 
 	pkt_profile_mode = id::find_val("pkt_profile_mode")->InternalInt();
 	pkt_profile_freq = id::find_val("pkt_profile_freq")->AsDouble();
@@ -19,6 +19,7 @@ extern int tcp_SYN_ack_ok;
 extern int tcp_match_undelivered;
 
 extern double frag_timeout;
+extern bro_uint_t frag_max_memory;
 
 extern double tcp_SYN_timeout;
 extern double tcp_session_timer;
@@ -73,6 +74,8 @@ extern double profiling_interval;
 extern int expensive_profiling_multiple;
 
 extern int segment_profiling;
+extern int handler_profiling_sample_rate;
+extern int packet_stage_sample_rate;
 extern int pkt_profile_mode;
 extern double pkt_profile_freq;
 extern int load_sample_freq;
@@ -80,6 +83,9 @@ extern int load_sample_freq;
 extern int packet_filter_default;
 
 extern int sig_max_group_size;
+extern int sig_prefilter;
+extern bro_uint_t dfa_max_memory;
+extern bro_uint_t dfa_max_eviction_passes;
 
 extern int dpd_reassemble_first_packets;
 extern int dpd_buffer_size;
@@ -5,6 +5,7 @@
 #include "zeek/zeek-config.h"
 
 #include <stdlib.h>
+#include <vector>
 
 #include "zeek/Desc.h"
 #include "zeek/File.h"
@@ -215,4 +216,42 @@ void obj_delete_func(void* v)
 	Unref((Obj*)v);
 	}
 
+namespace detail
+	{
+
+// Beyond this many buffered objects, deferring releases mostly costs
+// memory, for example in script loops creating lots of temporary values.
+static constexpr size_t MAX_DEFERRED_RELEASES = 4096;
+
+int defer_releases = 0;
+static std::vector<Obj*> deferred_releases;
+static bool releasing = false;
+
+void defer_release(Obj* o)
+	{
+	deferred_releases.push_back(o);
+
+	if ( deferred_releases.size() >= MAX_DEFERRED_RELEASES )
+		release_deferred();
+	}
+
+void release_deferred()
+	{
+	// Destructors running below may buffer further objects, which the
+	// loop picks up as well.
+	if ( releasing )
+		return;
+
+	releasing = true;
+
+	// Objects get deleted in the order their last references went away.
+	for ( size_t i = 0; i < deferred_releases.size(); ++i )
+		delete deferred_releases[i];
+
+	deferred_releases.clear();
+	releasing = false;
+	}
+
+	} // namespace detail
+
 	} // namespace zeek
@@ -130,6 +130,11 @@ public:
 	// Enable notification of plugins when this objects gets destroyed.
 	void NotifyPluginsOnDtor() { notify_plugins = true; }
 
+	// Delete this object as soon as its last reference goes away, even
+	// while releases are deferred. For objects whose destructor has
+	// visible effects, like closing a file.
+	void ReleaseImmediately() { release_immediately = true; }
+
 	int RefCnt() const { return ref_cnt; }
 
 	// Helper class to temporarily suppress errors
@@ -158,6 +163,7 @@ private:
 
 	int ref_cnt = 1;
 	bool notify_plugins = false;
+	bool release_immediately = false;
 
 	// If non-zero, do not print runtime errors.  Useful for
 	// speculative evaluation.
@@ -173,6 +179,42 @@ inline void Error(const Obj* o, const char* msg)
 
 [[noreturn]] extern void bad_ref(int type);
 
+namespace detail
+	{
+
+// While non-zero, Unref() doesn't delete objects whose last reference
+// goes away, but buffers them for release_deferred() to delete later on,
+// batching up the destructor work. Like reference counts, this assumes
+// that only the main thread handles these objects.
+extern int defer_releases;
+
+// Buffers an object for release_deferred(). Deletes the buffered objects
+// right away if there are too many.
+extern void defer_release(Obj* o);
+
+// Deletes all objects buffered by defer_release(), including those
+// released by their destructors in turn.
+extern void release_deferred();
+
+// Defers releases within its scope, releasing any buffered objects at its
+// end unless it's nested into another one.
+class DeferReleases
+	{
+public:
+	DeferReleases() { ++defer_releases; }
+
+	~DeferReleases()
+		{
+		if ( --defer_releases == 0 )
+			release_deferred();
+		}
+
+	DeferReleases(const DeferReleases&) = delete;
+	DeferReleases& operator=(const DeferReleases&) = delete;
+	};
+
+	} // namespace detail
+
 inline void Ref(Obj* o)
 	{
 	if ( ++(o->ref_cnt) <= 1 )
@@ -187,7 +229,11 @@ inline void Unref(Obj* o)
 		{
 		if ( o->ref_cnt < 0 )
 			bad_ref(2);
-		delete o;
+
+		if ( detail::defer_releases && ! o->release_immediately )
+			detail::defer_release(o);
+		else
+			delete o;
 
 		// We could do the following if o were passed by reference.
 		// o = (Obj*) 0xcd;
@@ -21,6 +21,9 @@
 #include "zeek/Var.h"
 #include "zeek/probabilistic/BloomFilter.h"
 #include "zeek/probabilistic/CardinalityCounter.h"
+#include "zeek/probabilistic/CountMinSketch.h"
+#include "zeek/probabilistic/CuckooFilter.h"
+#include "zeek/probabilistic/QuantileSketch.h"
 
 namespace zeek
 	{
@@ -853,6 +856,223 @@ bool CardinalityVal::DoUnserialize(const broker::data& data)
 	return true;
 	}
 
+CountMinVal::CountMinVal() : OpaqueVal(countmin_type) { }
+
+CountMinVal::CountMinVal(std::unique_ptr<probabilistic::detail::CountMinSketch> arg_cms)
+	: OpaqueVal(countmin_type), cms(std::move(arg_cms))
+	{
+	}
+
+CountMinVal::~CountMinVal() = default;
+
+ValPtr CountMinVal::DoClone(CloneState* state)
+	{
+	auto cv = make_intrusive<CountMinVal>(
+		std::make_unique<probabilistic::detail::CountMinSketch>(*cms));
+
+	if ( type )
+		cv->Typify(type);
+
+	return state->NewClone(this, std::move(cv));
+	}
+
+bool CountMinVal::Typify(TypePtr arg_type)
+	{
+	if ( type )
+		return false;
+
+	type = std::move(arg_type);
+
+	auto tl = make_intrusive<TypeList>(type);
+	tl->Append(type);
+	hash = std::make_unique<detail::CompositeHash>(std::move(tl));
+
+	return true;
+	}
+
+void CountMinVal::Add(const Val* val, uint64_t n)
+	{
+	auto key = hash->MakeHashKey(*val, true);
+	cms->Add(key.get(), n);
+	}
+
+uint64_t CountMinVal::Estimate(const Val* val) const
+	{
+	auto key = hash->MakeHashKey(*val, true);
+	return cms->Estimate(key.get());
+	}
+
+IMPLEMENT_OPAQUE_VALUE(CountMinVal)
+
+broker::expected<broker::data> CountMinVal::DoSerialize() const
+	{
+	broker::vector d;
+
+	if ( type )
+		{
+		auto t = SerializeType(type);
+		if ( ! t )
+			return broker::ec::invalid_data;
+
+		d.emplace_back(std::move(*t));
+		}
+	else
+		d.emplace_back(broker::none());
+
+	auto cs = cms->Serialize();
+	if ( ! cs )
+		return broker::ec::invalid_data;
+
+	d.emplace_back(std::move(*cs));
+	return {std::move(d)};
+	}
+
+bool CountMinVal::DoUnserialize(const broker::data& data)
+	{
+	auto v = broker::get_if<broker::vector>(&data);
+
+	if ( ! (v && v->size() == 2) )
+		return false;
+
+	auto no_type = broker::get_if<broker::none>(&(*v)[0]);
+	if ( ! no_type )
+		{
+		auto t = UnserializeType((*v)[0]);
+
+		if ( ! (t && Typify(std::move(t))) )
+			return false;
+		}
+
+	cms = probabilistic::detail::CountMinSketch::Unserialize((*v)[1]);
+	return cms != nullptr;
+	}
+
+QuantileVal::QuantileVal() : OpaqueVal(quantile_type) { }
+
+QuantileVal::QuantileVal(std::unique_ptr<probabilistic::detail::QuantileSketch> arg_qs)
+	: OpaqueVal(quantile_type), qs(std::move(arg_qs))
+	{
+	}
+
+QuantileVal::~QuantileVal() = default;
+
+ValPtr QuantileVal::DoClone(CloneState* state)
+	{
+	return state->NewClone(
+		this,
+		make_intrusive<QuantileVal>(std::make_unique<probabilistic::detail::QuantileSketch>(*qs)));
+	}
+
+IMPLEMENT_OPAQUE_VALUE(QuantileVal)
+
+broker::expected<broker::data> QuantileVal::DoSerialize() const
+	{
+	return qs->Serialize();
+	}
+
+bool QuantileVal::DoUnserialize(const broker::data& data)
+	{
+	qs = probabilistic::detail::QuantileSketch::Unserialize(data);
+	return qs != nullptr;
+	}
+
+CuckooFilterVal::CuckooFilterVal() : OpaqueVal(cuckoofilter_type) { }
+
+CuckooFilterVal::CuckooFilterVal(std::unique_ptr<probabilistic::detail::CuckooFilter> arg_cf)
+	: OpaqueVal(cuckoofilter_type), cf(std::move(arg_cf))
+	{
+	}
+
+CuckooFilterVal::~CuckooFilterVal() = default;
+
+ValPtr CuckooFilterVal::DoClone(CloneState* state)
+	{
+	auto cv = make_intrusive<CuckooFilterVal>(
+		std::make_unique<probabilistic::detail::CuckooFilter>(*cf));
+
+	if ( type )
+		cv->Typify(type);
+
+	return state->NewClone(this, std::move(cv));
+	}
+
+bool CuckooFilterVal::Typify(TypePtr arg_type)
+	{
+	if ( type )
+		return false;
+
+	type = std::move(arg_type);
+
+	auto tl = make_intrusive<TypeList>(type);
+	tl->Append(type);
+	hash = std::make_unique<detail::CompositeHash>(std::move(tl));
+
+	return true;
+	}
+
+bool CuckooFilterVal::Add(const Val* val)
+	{
+	auto key = hash->MakeHashKey(*val, true);
+	return cf->Add(key.get());
+	}
+
+bool CuckooFilterVal::Lookup(const Val* val) const
+	{
+	auto key = hash->MakeHashKey(*val, true);
+	return cf->Lookup(key.get());
+	}
+
+bool CuckooFilterVal::Remove(const Val* val)
+	{
+	auto key = hash->MakeHashKey(*val, true);
+	return cf->Remove(key.get());
+	}
+
+IMPLEMENT_OPAQUE_VALUE(CuckooFilterVal)
+
+broker::expected<broker::data> CuckooFilterVal::DoSerialize() const
+	{
+	broker::vector d;
+
+	if ( type )
+		{
+		auto t = SerializeType(type);
+		if ( ! t )
+			return broker::ec::invalid_data;
+
+		d.emplace_back(std::move(*t));
+		}
+	else
+		d.emplace_back(broker::none());
+
+	auto cs = cf->Serialize();
+	if ( ! cs )
+		return broker::ec::invalid_data;
+
+	d.emplace_back(std::move(*cs));
+	return {std::move(d)};
+	}
+
+bool CuckooFilterVal::DoUnserialize(const broker::data& data)
+	{
+	auto v = broker::get_if<broker::vector>(&data);
+
+	if ( ! (v && v->size() == 2) )
+		return false;
+
+	auto no_type = broker::get_if<broker::none>(&(*v)[0]);
+	if ( ! no_type )
+		{
+		auto t = UnserializeType((*v)[0]);
+
+		if ( ! (t && Typify(std::move(t))) )
+			return false;
+		}
+
+	cf = probabilistic::detail::CuckooFilter::Unserialize((*v)[1]);
+	return cf != nullptr;
+	}
+
 ParaglobVal::ParaglobVal(std::unique_ptr<paraglob::Paraglob> p) : OpaqueVal(paraglob_type)
 	{
 	this->internal_paraglob = std::move(p);
@@ -30,6 +30,9 @@ class BloomFilter;
 namespace probabilistic::detail
 	{
 class CardinalityCounter;
+class CountMinSketch;
+class CuckooFilter;
+class QuantileSketch;
 	}
 
 class OpaqueVal;
@@ -376,6 +379,79 @@ private:
 	probabilistic::detail::CardinalityCounter* c;
 	};
 
+class CountMinVal : public OpaqueVal
+	{
+public:
+	explicit CountMinVal(std::unique_ptr<probabilistic::detail::CountMinSketch> cms);
+	~CountMinVal() override;
+
+	ValPtr DoClone(CloneState* state) override;
+
+	const TypePtr& Type() const { return type; }
+
+	bool Typify(TypePtr type);
+
+	void Add(const Val* val, uint64_t n);
+	uint64_t Estimate(const Val* val) const;
+
+	probabilistic::detail::CountMinSketch* Get() { return cms.get(); }
+
+protected:
+	CountMinVal();
+
+	DECLARE_OPAQUE_VALUE(CountMinVal)
+private:
+	TypePtr type;
+	std::unique_ptr<detail::CompositeHash> hash;
+	std::unique_ptr<probabilistic::detail::CountMinSketch> cms;
+	};
+
+class QuantileVal : public OpaqueVal
+	{
+public:
+	explicit QuantileVal(std::unique_ptr<probabilistic::detail::QuantileSketch> qs);
+	~QuantileVal() override;
+
+	ValPtr DoClone(CloneState* state) override;
+
+	probabilistic::detail::QuantileSketch* Get() { return qs.get(); }
+
+protected:
+	QuantileVal();
+
+	DECLARE_OPAQUE_VALUE(QuantileVal)
+private:
+	std::unique_ptr<probabilistic::detail::QuantileSketch> qs;
+	};
+
+class CuckooFilterVal : public OpaqueVal
+	{
+public:
+	explicit CuckooFilterVal(std::unique_ptr<probabilistic::detail::CuckooFilter> cf);
+	~CuckooFilterVal() override;
+
+	ValPtr DoClone(CloneState* state) override;
+
+	const TypePtr& Type() const { return type; }
+
+	bool Typify(TypePtr type);
+
+	bool Add(const Val* val);
+	bool Lookup(const Val* val) const;
+	bool Remove(const Val* val);
+
+	probabilistic::detail::CuckooFilter* Get() { return cf.get(); }
+
+protected:
+	CuckooFilterVal();
+
+	DECLARE_OPAQUE_VALUE(CuckooFilterVal)
+private:
+	TypePtr type;
+	std::unique_ptr<detail::CompositeHash> hash;
+	std::unique_ptr<probabilistic::detail::CuckooFilter> cf;
+	};
+
 class ParaglobVal : public OpaqueVal
 	{
 public:
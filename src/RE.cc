@@ -310,6 +310,27 @@ inline void RE_Match_State::AddMatches(const AcceptingSet& as, MatchPos position
 		accepted_matches.insert(am_idx(*it, position));
 	}
 
+RE_Match_State::~RE_Match_State()
+	{
+	Unref(current_state);
+	}
+
+void RE_Match_State::Clear()
+	{
+	current_pos = -1;
+	SetState(nullptr);
+	accepted_matches.clear();
+	}
+
+void RE_Match_State::SetState(DFA_State* state)
+	{
+	if ( state )
+		Ref(state);
+
+	Unref(current_state);
+	current_state = state;
+	}
+
 bool RE_Match_State::Match(const u_char* bv, int n, bool bol, bool eol, bool clear)
 	{
 	if ( current_pos == -1 )
@@ -320,7 +341,7 @@ bool RE_Match_State::Match(const u_char* bv, int n, bool bol, bool eol, bool cle
 
 		// Initialize state and copy the accepting states of the start
 		// state into the acceptance set.
-		current_state = dfa->StartState();
+		SetState(dfa->StartState());
 
 		const AcceptingSet* ac = current_state->Accept();
 
@@ -329,7 +350,7 @@ bool RE_Match_State::Match(const u_char* bv, int n, bool bol, bool eol, bool cle
 		}
 
 	else if ( clear )
-		current_state = dfa->StartState();
+		SetState(dfa->StartState());
 
 	if ( ! current_state )
 		return false;
@@ -338,6 +359,10 @@ bool RE_Match_State::Match(const u_char* bv, int n, bool bol, bool eol, bool cle
 
 	size_t old_matches = accepted_matches.size();
 
+	// The reference to current_state keeps it around until we're done,
+	// even if the DFA evicts it on the way.
+	DFA_State* state = current_state;
+
 	int ec;
 	int m = bol ? n + 1 : n;
 	int e = eol ? -1 : 0;
@@ -351,11 +376,11 @@ bool RE_Match_State::Match(const u_char* bv, int n, bool bol, bool eol, bool cle
 		else
 			ec = ecs[*(bv++)];
 
-		DFA_State* next_state = current_state->Xtion(ec, dfa);
+		DFA_State* next_state = state->Xtion(ec, dfa);
 
 		if ( ! next_state )
 			{
-			current_state = nullptr;
+			state = nullptr;
 			break;
 			}
 
@@ -366,9 +391,11 @@ bool RE_Match_State::Match(const u_char* bv, int n, bool bol, bool eol, bool cle
 
 		++current_pos;
 
-		current_state = next_state;
+		state = next_state;
 		}
 
+	SetState(state);
+
 	return accepted_matches.size() != old_matches;
 	}
 
@@ -163,6 +163,8 @@ public:
 		current_state = nullptr;
 		}
 
+	~RE_Match_State();
+
 	const AcceptingMatchSet& AcceptedMatches() const { return accepted_matches; }
 
 	// Returns the number of bytes feeded into the matcher so far
@@ -172,16 +174,15 @@ public:
 	// If clear is true, starts matching over.
 	bool Match(const u_char* bv, int n, bool bol, bool eol, bool clear);
 
-	void Clear()
-		{
-		current_pos = -1;
-		current_state = nullptr;
-		accepted_matches.clear();
-		}
+	void Clear();
 
 	void AddMatches(const AcceptingSet& as, MatchPos position);
 
 protected:
+	// Keeps a reference to the state, as the DFA may evict it from its
+	// cache.
+	void SetState(DFA_State* state);
+
 	DFA_Machine* dfa;
 	int* ecs;
 
@@ -2,6 +2,7 @@
 
 #include "zeek/zeek-config.h"
 
+#include "zeek/Conn.h"
 #include "zeek/Func.h"
 #include "zeek/ID.h"
 #include "zeek/Reporter.h"
@@ -194,6 +195,10 @@ bool RuleConditionEval::DoMatch(Rule* rule, RuleEndpointState* state, const u_ch
 	if ( id->GetType()->Tag() != TYPE_FUNC )
 		return id->GetVal()->AsBool();
 
+	// Matching happens in the middle of a packet, so the state's
+	// connection record needs bringing up to date first.
+	Connection::RefreshPacketVals();
+
 	// Call function with a signature_state value as argument.
 	Args args;
 	args.reserve(2);
@@ -69,6 +69,9 @@ RuleHdrTest::RuleHdrTest(Prot arg_prot, uint32_t arg_offset, uint32_t arg_size,
 	ruleset = new IntSet;
 	id = ++idcounter;
 	level = 0;
+
+	for ( auto& p : prefilters )
+		p = nullptr;
 	}
 
 RuleHdrTest::RuleHdrTest(Prot arg_prot, Comp arg_comp, vector<IPPrefix> arg_v)
@@ -86,6 +89,9 @@ RuleHdrTest::RuleHdrTest(Prot arg_prot, Comp arg_comp, vector<IPPrefix> arg_v)
 	ruleset = new IntSet;
 	id = ++idcounter;
 	level = 0;
+
+	for ( auto& p : prefilters )
+		p = nullptr;
 	}
 
 Val* RuleMatcher::BuildRuleStateValue(const Rule* rule, const RuleEndpointState* state) const
@@ -134,6 +140,9 @@ RuleHdrTest::RuleHdrTest(RuleHdrTest& h)
 	ruleset = new IntSet;
 	id = ++idcounter;
 	level = 0;
+
+	for ( auto& p : prefilters )
+		p = nullptr;
 	}
 
 RuleHdrTest::~RuleHdrTest()
@@ -149,6 +158,8 @@ RuleHdrTest::~RuleHdrTest()
 			delete pset->re;
 			delete pset;
 			}
+
+		delete prefilters[i];
 		}
 
 	delete ruleset;
@@ -209,6 +220,9 @@ RuleEndpointState::~RuleEndpointState()
 		delete matcher;
 		}
 
+	for ( auto prefilter : prefilters )
+		delete prefilter;
+
 	for ( auto text : matched_text )
 		delete text;
 	}
@@ -462,7 +476,7 @@ void RuleMatcher::BuildRegEx(RuleHdrTest* hdr_test, string_list* exprs, int_list
 		{
 		for ( int i = 0; i < Rule::TYPES; ++i )
 			if ( exprs[i].length() )
-				BuildPatternSets(&hdr_test->psets[i], exprs[i], ids[i]);
+				BuildPatternSets(&hdr_test->psets[i], PrefilterFor(hdr_test, i), exprs[i], ids[i]);
 		}
 
 	// Get the patterns on all of our children.
@@ -489,21 +503,70 @@ void RuleMatcher::BuildRegEx(RuleHdrTest* hdr_test, string_list* exprs, int_list
 		{
 		for ( int i = 0; i < Rule::TYPES; ++i )
 			if ( exprs[i].length() )
-				BuildPatternSets(&hdr_test->psets[i], exprs[i], ids[i]);
+				BuildPatternSets(&hdr_test->psets[i], PrefilterFor(hdr_test, i), exprs[i], ids[i]);
 		}
 
 	// If we're below the RE_level, the regexprs remains empty.
 	}
 
-void RuleMatcher::BuildPatternSets(RuleHdrTest::pattern_set_list* dst, const string_list& exprs,
-                                   const int_list& ids)
+void RuleMatcher::BuildPatternSets(RuleHdrTest::pattern_set_list* dst, RulePrefilter** prefilter,
+                                   const string_list& exprs, const int_list& ids)
 	{
 	assert(static_cast<size_t>(exprs.length()) == ids.size());
 
+	if ( ! prefilter )
+		{
+		BuildPatternGroups(dst, exprs, ids, nullptr, nullptr);
+		return;
+		}
+
+	// Patterns with a required literal go into groups of their own, so
+	// that their matchers can wait for one of the literals to show up.
+	string_list plain_exprs;
+	int_list plain_ids;
+	string_list literal_exprs;
+	int_list literal_ids;
+	std::vector<RequiredLiteral> literals;
+
+	loop_over_list(exprs, i)
+		{
+		RequiredLiteral lit;
+
+		if ( extract_required_literal(exprs[i], &lit) )
+			{
+			literal_exprs.push_back(exprs[i]);
+			literal_ids.push_back(ids[i]);
+			literals.push_back(std::move(lit));
+			}
+		else
+			{
+			plain_exprs.push_back(exprs[i]);
+			plain_ids.push_back(ids[i]);
+			}
+		}
+
+	DBG_LOG(DBG_RULES, "%d of %d patterns prefiltered", literal_exprs.length(), exprs.length());
+
+	if ( plain_exprs.length() )
+		BuildPatternGroups(dst, plain_exprs, plain_ids, nullptr, nullptr);
+
+	if ( literal_exprs.length() )
+		{
+		*prefilter = new RulePrefilter();
+		BuildPatternGroups(dst, literal_exprs, literal_ids, &literals, *prefilter);
+		}
+	}
+
+void RuleMatcher::BuildPatternGroups(RuleHdrTest::pattern_set_list* dst, const string_list& exprs,
+                                     const int_list& ids,
+                                     const std::vector<RequiredLiteral>* literals,
+                                     RulePrefilter* prefilter)
+	{
 	// We build groups of at most sig_max_group_size regexps.
 
 	string_list group_exprs;
 	int_list group_ids;
+	int group_start = 0;
 
 	for ( int i = 0; i < exprs.length() + 1 /* sic! */; i++ )
 		{
@@ -520,14 +583,32 @@ void RuleMatcher::BuildPatternSets(RuleHdrTest::pattern_set_list* dst, const str
 			set->re->CompileSet(group_exprs, group_ids);
 			set->patterns = group_exprs;
 			set->ids = group_ids;
+			set->prefiltered = (prefilter != nullptr);
+
+			if ( prefilter )
+				{
+				for ( int j = group_start; j < group_start + group_exprs.length(); ++j )
+					prefilter->Add((*literals)[j], dst->length());
+				}
+
 			dst->push_back(set);
 
+			group_start += group_exprs.length();
 			group_exprs.clear();
 			group_ids.clear();
 			}
 		}
 	}
 
+RulePrefilter** RuleMatcher::PrefilterFor(RuleHdrTest* hdr_test, int type)
+	{
+	// File magic matching always looks at just the beginning of files.
+	if ( ! sig_prefilter || type == Rule::FILE_MAGIC )
+		return nullptr;
+
+	return &hdr_test->prefilters[type];
+	}
+
 // Get a 8/16/32-bit value from the given position in the packet header
 static inline uint32_t getval(const u_char* data, int size)
 	{
@@ -825,14 +906,34 @@ RuleEndpointState* RuleMatcher::InitEndpoint(analyzer::Analyzer* analyzer, const
 			{
 			for ( int i = Rule::PAYLOAD; i < Rule::TYPES; ++i )
 				{
-				for ( const auto& set : hdr_test->psets[i] )
+				RuleEndpointState::Prefilter* prefilter = nullptr;
+
+				if ( hdr_test->prefilters[i] )
+					{
+					prefilter = new RuleEndpointState::Prefilter;
+					prefilter->literals = hdr_test->prefilters[i];
+					prefilter->type = (Rule::PatternType)i;
+					prefilter->matchers.resize(hdr_test->psets[i].length(), nullptr);
+					prefilter->dormant = 0;
+					state->prefilters.push_back(prefilter);
+					}
+
+				loop_over_list(hdr_test->psets[i], j)
 					{
+					const auto& set = hdr_test->psets[i][j];
 					assert(set->re);
 
 					auto* m = new RuleEndpointState::Matcher;
 					m->state = new RE_Match_State(set->re);
 					m->type = (Rule::PatternType)i;
+					m->dormant = set->prefiltered;
 					state->matchers.push_back(m);
+
+					if ( m->dormant )
+						{
+						prefilter->matchers[j] = m;
+						++prefilter->dormant;
+						}
 					}
 				}
 			}
@@ -898,6 +999,7 @@ RuleEndpointState* RuleMatcher::InitEndpoint(analyzer::Analyzer* analyzer, const
 	// Save some memory.
 	state->hdr_tests.resize(0);
 	state->matchers.resize(0);
+	state->prefilters.resize(0);
 
 	// Send BOL to payload matchers.
 	Match(state, Rule::PAYLOAD, (const u_char*)"", 0, true, false, false);
@@ -943,10 +1045,18 @@ void RuleMatcher::Match(RuleEndpointState* state, Rule::PatternType type, const
 			state->payload_size = 0;
 		}
 
+	// Wake up matchers whose literals show up.
+	for ( const auto& p : state->prefilters )
+		{
+		if ( p->type == type )
+			RunPrefilter(p, data, data_len, clear);
+		}
+
 	// Feed data into all relevant matchers.
 	for ( const auto& m : state->matchers )
 		{
-		if ( m->type == type && m->state->Match((const u_char*)data, data_len, bol, eol, clear) )
+		if ( m->type == type && ! m->dormant &&
+		     m->state->Match((const u_char*)data, data_len, bol, eol, clear) )
 			newmatch = true;
 		}
 
@@ -1024,6 +1134,57 @@ void RuleMatcher::Match(RuleEndpointState* state, Rule::PatternType type, const
 		}
 	}
 
+void RuleMatcher::RunPrefilter(RuleEndpointState::Prefilter* p, const u_char* data, int data_len,
+                               bool clear)
+	{
+	if ( clear )
+		p->tail.clear();
+
+	if ( ! p->dormant )
+		return;
+
+	const auto* tail = reinterpret_cast<const u_char*>(p->tail.data());
+	std::vector<int> groups;
+	p->literals->Scan(tail, p->tail.size(), data, data_len, &groups);
+
+	for ( int group : groups )
+		{
+		auto* m = p->matchers[group];
+
+		if ( ! m->dormant )
+			continue;
+
+		DBG_LOG(DBG_RULES, "Prefilter wakes up %s matcher %d", Rule::TypeToString(p->type), group);
+
+		// No match of the group's patterns starts before the tail or
+		// ends within it, so running the tail through the matcher
+		// brings it up to date.
+		m->dormant = false;
+		m->state->Match(tail, p->tail.size(), false, false, false);
+		--p->dormant;
+		}
+
+	if ( ! p->dormant )
+		{
+		p->tail.clear();
+		p->tail.shrink_to_fit();
+		return;
+		}
+
+	size_t window = p->literals->Window();
+	size_t len = data_len;
+
+	if ( len >= window )
+		p->tail.assign(reinterpret_cast<const char*>(data + len - window), window);
+	else
+		{
+		p->tail.append(reinterpret_cast<const char*>(data), len);
+
+		if ( p->tail.size() > window )
+			p->tail.erase(0, p->tail.size() - window);
+		}
+	}
+
 void RuleMatcher::FinishEndpoint(RuleEndpointState* state)
 	{
 	// Send EOL to payload matchers.
@@ -1174,6 +1335,22 @@ void RuleMatcher::ClearEndpointState(RuleEndpointState* state)
 
 	for ( const auto& matcher : state->matchers )
 		matcher->state->Clear();
+
+	// Starting over, the prefiltered matchers wait for their literals
+	// again.
+	for ( const auto& p : state->prefilters )
+		{
+		for ( const auto& m : p->matchers )
+			{
+			if ( m && ! m->dormant )
+				{
+				m->dormant = true;
+				++p->dormant;
+				}
+			}
+
+		p->tail.clear();
+		}
 	}
 
 void RuleMatcher::ClearFileMagicState(RuleFileMagicState* state) const
@@ -1207,8 +1384,9 @@ void RuleMatcher::PrintTreeDebug(RuleHdrTest* node)
 			{
 			RuleHdrTest::PatternSet* set = node->psets[i][j];
 
-			fprintf(stderr, "[%d patterns in %s group %d from %zu rules]\n", set->patterns.length(),
-			        Rule::TypeToString((Rule::PatternType)i), j, set->ids.size());
+			fprintf(stderr, "[%d patterns in %s group %d from %zu rules%s]\n",
+			        set->patterns.length(), Rule::TypeToString((Rule::PatternType)i), j,
+			        set->ids.size(), set->prefiltered ? ", prefiltered" : "");
 			}
 		}
 
@@ -11,6 +11,7 @@
 #include "zeek/CCL.h"
 #include "zeek/RE.h"
 #include "zeek/Rule.h"
+#include "zeek/RulePrefilter.h"
 #include "zeek/ScannedFile.h"
 #include "zeek/plugin/Manager.h"
 
@@ -150,11 +151,19 @@ private:
 		// All the patterns and their rule indices.
 		string_list patterns;
 		int_list ids; // (only needed for debugging)
+
+		// True if all the patterns have a required literal in the
+		// node's prefilter.
+		bool prefiltered = false;
 		};
 
 	using pattern_set_list = PList<PatternSet>;
 	pattern_set_list psets[Rule::TYPES];
 
+	// The required literals of prefiltered pattern sets, by type. Their
+	// groups are indices into psets.
+	RulePrefilter* prefilters[Rule::TYPES];
+
 	// List of rules belonging to this node.
 	Rule* pattern_rules; // rules w/ at least one pattern of any type
 	Rule* pure_rules; // rules containing no patterns at all
@@ -201,15 +210,30 @@ private:
 		{
 		RE_Match_State* state;
 		Rule::PatternType type;
+		bool dormant; // waiting for the prefilter to find a literal
 		};
 
 	using matcher_list = PList<Matcher>;
 
+	// Tracks the literals of one node's prefiltered pattern sets in
+	// the stream.
+	struct Prefilter
+		{
+		const RulePrefilter* literals;
+		Rule::PatternType type;
+		std::vector<Matcher*> matchers; // by pattern set, null if not prefiltered
+		int dormant; // number of matchers still dormant
+		std::string tail; // end of the data seen so far
+		};
+
+	using prefilter_list = PList<Prefilter>;
+
 	analyzer::Analyzer* analyzer;
 	RuleEndpointState* opposite;
 	analyzer::pia::PIA* pia;
 
 	matcher_list matchers;
+	prefilter_list prefilters;
 	rule_hdr_test_list hdr_tests;
 
 	// The follow tracks which rules for which all patterns have matched,
@@ -361,9 +385,24 @@ private:
 	// Traverse tree building the combined regular expressions.
 	void BuildRegEx(RuleHdrTest* hdr_test, string_list* exprs, int_list* ids);
 
-	// Build groups of regular epxressions.
-	void BuildPatternSets(RuleHdrTest::pattern_set_list* dst, const string_list& exprs,
-	                      const int_list& ids);
+	// Build groups of regular epxressions. If prefilter is given, patterns
+	// with a required literal get groups of their own, with the literals
+	// in a new prefilter.
+	void BuildPatternSets(RuleHdrTest::pattern_set_list* dst, RulePrefilter** prefilter,
+	                      const string_list& exprs, const int_list& ids);
+
+	// Returns where to put the prefilter for patterns of the given type
+	// on a node, or null if they don't get one.
+	RulePrefilter** PrefilterFor(RuleHdrTest* hdr_test, int type);
+
+	void BuildPatternGroups(RuleHdrTest::pattern_set_list* dst, const string_list& exprs,
+	                        const int_list& ids, const std::vector<RequiredLiteral>* literals,
+	                        RulePrefilter* prefilter);
+
+	// Scan data for the literals of dormant matchers and wake up those
+	// whose literals show up.
+	void RunPrefilter(RuleEndpointState::Prefilter* p, const u_char* data, int data_len,
+	                  bool clear);
 
 	// Check an arbitrary rule if it's satisfied right now.
 	// eos signals end of stream
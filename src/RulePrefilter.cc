@@ -0,0 +1,512 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/RulePrefilter.h"
+
+#include <algorithm>
+#include <strings.h>
+#include <cctype>
+#include <cstring>
+#include <limits>
+
+#include "zeek/util.h"
+
+namespace zeek::detail
+	{
+
+namespace
+	{
+
+constexpr size_t UNBOUNDED = std::numeric_limits<size_t>::max();
+
+size_t add_len(size_t a, size_t b)
+	{
+	return (a == UNBOUNDED || b == UNBOUNDED || a + b < a) ? UNBOUNDED : a + b;
+	}
+
+size_t mult_len(size_t a, size_t n)
+	{
+	if ( a == 0 || n == 0 )
+		return 0;
+
+	return (a == UNBOUNDED || n == UNBOUNDED || a > UNBOUNDED / n) ? UNBOUNDED : a * n;
+	}
+
+bool starts_with_nocase(const char* s, const char* prefix)
+	{
+	return strncasecmp(s, prefix, strlen(prefix)) == 0;
+	}
+
+// Follows the pattern syntax of re-scan.l and re-parse.y just far enough
+// to find required literals and the maximum lengths of subexpressions.
+// Anything it isn't sure about makes the pattern ineligible.
+class LiteralExtractor
+	{
+public:
+	explicit LiteralExtractor(const char* pattern) : s(pattern) { }
+
+	bool Extract(RequiredLiteral* lit);
+
+private:
+	// Parses alternatives up to a closing parenthesis and returns their
+	// maximum length.
+	bool Alternatives(size_t* max_len);
+
+	// Parses one singleton, without quantifiers. If it's a character or
+	// a quoted string, returns it in chars.
+	bool Singleton(size_t* max_len, std::string* chars, bool* is_literal);
+
+	// Parses quantifiers following a singleton and adjusts its maximum
+	// length. Returns true if there were any.
+	bool Quantifiers(size_t* max_len);
+
+	bool Char(int* c);
+	bool CCL();
+	bool Number(size_t* n);
+
+	// Keeps the given run of characters if it's the best literal so far.
+	void Consider(const std::string& run, size_t lead);
+
+	const char* s;
+	std::string best;
+	size_t best_lead = 0;
+	};
+
+bool LiteralExtractor::Extract(RequiredLiteral* lit)
+	{
+	// Case-insensitive signature patterns come wrapped into "(?i:...)".
+	bool nocase = starts_with_nocase(s, "(?i:");
+
+	if ( nocase )
+		s += 4;
+
+	// Only patterns that may match anywhere qualify.
+	if ( s[0] != '.' || s[1] != '*' )
+		return false;
+
+	s += 1;
+	size_t dummy = 1;
+	Quantifiers(&dummy);
+
+	std::string run;
+	size_t run_lead = 0;
+	size_t lead = 0;
+
+	while ( *s && *s != ')' && *s != '|' )
+		{
+		if ( *s == '$' )
+			{
+			++s;
+			break;
+			}
+
+		size_t len;
+		std::string chars;
+		bool is_literal;
+
+		if ( ! Singleton(&len, &chars, &is_literal) )
+			return false;
+
+		if ( Quantifiers(&len) )
+			is_literal = false;
+
+		if ( is_literal )
+			{
+			if ( run.empty() )
+				run_lead = lead;
+
+			run += chars;
+			}
+		else
+			{
+			Consider(run, run_lead);
+			run.clear();
+			}
+
+		lead = add_len(lead, len);
+		}
+
+	Consider(run, run_lead);
+
+	if ( nocase )
+		{
+		if ( *s != ')' )
+			return false;
+
+		++s;
+		}
+
+	if ( *s || best.empty() )
+		return false;
+
+	lit->text = best.substr(0, RulePrefilter::MAX_LITERAL);
+	lit->nocase = nocase;
+	lit->max_lead = best_lead;
+	return true;
+	}
+
+void LiteralExtractor::Consider(const std::string& run, size_t lead)
+	{
+	if ( run.size() < RulePrefilter::MIN_LITERAL || lead > RulePrefilter::MAX_LEAD )
+		return;
+
+	if ( run.size() > best.size() || (run.size() == best.size() && lead < best_lead) )
+		{
+		best = run;
+		best_lead = lead;
+		}
+	}
+
+bool LiteralExtractor::Alternatives(size_t* max_len)
+	{
+	size_t alternative = 0;
+	*max_len = 0;
+
+	while ( *s != ')' )
+		{
+		if ( ! *s )
+			return false;
+
+		if ( *s == '|' )
+			{
+			*max_len = std::max(*max_len, alternative);
+			alternative = 0;
+			++s;
+			continue;
+			}
+
+		size_t len;
+		std::string chars;
+		bool is_literal;
+
+		if ( ! Singleton(&len, &chars, &is_literal) )
+			return false;
+
+		Quantifiers(&len);
+		alternative = add_len(alternative, len);
+		}
+
+	*max_len = std::max(*max_len, alternative);
+	return true;
+	}
+
+bool LiteralExtractor::Singleton(size_t* max_len, std::string* chars, bool* is_literal)
+	{
+	*max_len = 1;
+	*is_literal = false;
+
+	switch ( *s )
+		{
+		case '(':
+			if ( s[1] == '?' )
+				{
+				if ( ! starts_with_nocase(s, "(?i:") )
+					return false;
+
+				s += 4;
+				}
+			else
+				++s;
+
+			if ( ! Alternatives(max_len) )
+				return false;
+
+			++s;
+			return true;
+
+		case '.':
+			++s;
+			return true;
+
+		case '[':
+			return CCL();
+
+		case '"':
+			++s;
+
+			while ( *s != '"' )
+				{
+				int c;
+
+				if ( ! *s || *s == '\n' || ! Char(&c) )
+					return false;
+
+				chars->push_back(static_cast<char>(c));
+				}
+
+			++s;
+			*max_len = chars->size();
+			*is_literal = ! chars->empty();
+			return true;
+
+		case '\0':
+		case '\n':
+		case '^':
+		case '$':
+		case '{':
+		case '}':
+		case '|':
+		case ')':
+		case '*':
+		case '+':
+		case '?':
+			return false;
+
+		default:
+			{
+			int c;
+
+			if ( ! Char(&c) )
+				return false;
+
+			chars->push_back(static_cast<char>(c));
+			*is_literal = true;
+			return true;
+			}
+		}
+	}
+
+bool LiteralExtractor::Quantifiers(size_t* max_len)
+	{
+	bool quantified = false;
+
+	while ( true )
+		{
+		if ( *s == '*' || *s == '+' )
+			*max_len = UNBOUNDED;
+
+		else if ( *s == '{' && isdigit(s[1]) )
+			{
+			const char* start = s;
+			size_t lower, upper;
+
+			++s;
+
+			if ( ! Number(&lower) )
+				{
+				s = start;
+				return quantified;
+				}
+
+			upper = lower;
+
+			if ( *s == ',' )
+				{
+				++s;
+
+				if ( *s == '}' )
+					upper = UNBOUNDED;
+				else if ( ! Number(&upper) )
+					{
+					s = start;
+					return quantified;
+					}
+				}
+
+			if ( *s != '}' )
+				{
+				s = start;
+				return quantified;
+				}
+
+			*max_len = mult_len(*max_len, upper);
+			}
+
+		else if ( *s != '?' )
+			return quantified;
+
+		++s;
+		quantified = true;
+		}
+	}
+
+bool LiteralExtractor::Number(size_t* n)
+	{
+	if ( ! isdigit(*s) )
+		return false;
+
+	*n = 0;
+
+	while ( isdigit(*s) )
+		{
+		*n = add_len(mult_len(*n, 10), *s - '0');
+		++s;
+		}
+
+	return true;
+	}
+
+bool LiteralExtractor::Char(int* c)
+	{
+	if ( *s != '\\' )
+		{
+		*c = static_cast<u_char>(*s++);
+		return true;
+		}
+
+	const char* e = s + 1;
+
+	if ( ! *e || *e == '\n' )
+		return false;
+
+	if ( *e == 'x' && ! (isxdigit(e[1]) && isxdigit(e[2])) )
+		return false;
+
+	if ( *e >= '0' && *e <= '7' )
+		{
+		// The scanner takes all octal digits but only uses three.
+		size_t n = 0;
+
+		while ( e[n] >= '0' && e[n] <= '7' )
+			++n;
+
+		if ( n > 3 )
+			return false;
+		}
+
+	*c = util::detail::expand_escape(e);
+	s = e;
+	return true;
+	}
+
+bool LiteralExtractor::CCL()
+	{
+	++s;
+
+	if ( *s == '^' )
+		++s;
+
+	bool first = true;
+
+	while ( first || *s != ']' )
+		{
+		if ( ! *s || *s == '\n' )
+			return false;
+
+		if ( s[0] == '[' && s[1] == ':' )
+			{
+			const char* end = strstr(s, ":]");
+
+			if ( ! end )
+				return false;
+
+			s = end + 2;
+			}
+
+		else if ( *s == '\\' )
+			{
+			if ( ! s[1] || s[1] == '\n' )
+				return false;
+
+			s += 2;
+			}
+
+		else
+			++s;
+
+		first = false;
+		}
+
+	++s;
+	return true;
+	}
+
+	} // namespace
+
+bool extract_required_literal(const char* pattern, RequiredLiteral* lit)
+	{
+	return LiteralExtractor(pattern).Extract(lit);
+	}
+
+RulePrefilter::RulePrefilter() : filter((1 << FILTER_BITS) / 64) { }
+
+void RulePrefilter::Add(const RequiredLiteral& lit, int group)
+	{
+	const auto* text = reinterpret_cast<const u_char*>(lit.text.data());
+	uint32_t key = (Fold(text[0]) << 16) | (Fold(text[1]) << 8) | Fold(text[2]);
+	uint32_t h = Hash(key);
+
+	filter[h / 64] |= uint64_t(1) << (h % 64);
+	literals[key].push_back({lit.text, lit.nocase, group});
+
+	max_literal = std::max(max_literal, lit.text.size());
+	window = std::max(window, lit.max_lead + lit.text.size() - 1);
+	}
+
+void RulePrefilter::Verify(const u_char* data, size_t len, size_t pos, uint32_t key,
+                           std::vector<int>* groups) const
+	{
+	auto it = literals.find(key);
+
+	if ( it == literals.end() )
+		return;
+
+	for ( const auto& l : it->second )
+		{
+		size_t n = l.text.size();
+
+		if ( len - pos < n )
+			continue;
+
+		const auto* text = reinterpret_cast<const u_char*>(l.text.data());
+		bool found;
+
+		if ( l.nocase )
+			{
+			size_t i = 0;
+
+			while ( i < n && Fold(data[pos + i]) == Fold(text[i]) )
+				++i;
+
+			found = (i == n);
+			}
+		else
+			found = memcmp(data + pos, text, n) == 0;
+
+		if ( found )
+			groups->push_back(l.group);
+		}
+	}
+
+void RulePrefilter::Scan(const u_char* tail, size_t tail_len, const u_char* data, size_t len,
+                         std::vector<int>* groups) const
+	{
+	if ( literals.empty() )
+		return;
+
+	// Literals that start in the tail but don't fit into it.
+	if ( tail_len && len )
+		{
+		size_t before = std::min(tail_len, max_literal - 1);
+		size_t after = std::min(len, max_literal - 1);
+
+		u_char boundary[2 * MAX_LITERAL];
+		memcpy(boundary, tail + tail_len - before, before);
+		memcpy(boundary + before, data, after);
+
+		for ( size_t i = 0; i < before && i + MIN_LITERAL <= before + after; ++i )
+			{
+			uint32_t key = (Fold(boundary[i]) << 16) | (Fold(boundary[i + 1]) << 8) |
+			               Fold(boundary[i + 2]);
+			uint32_t h = Hash(key);
+
+			if ( filter[h / 64] & (uint64_t(1) << (h % 64)) )
+				Verify(boundary, before + after, i, key, groups);
+			}
+		}
+
+	if ( len < MIN_LITERAL )
+		return;
+
+	uint32_t key = (Fold(data[0]) << 8) | Fold(data[1]);
+
+	for ( size_t i = 0; i + MIN_LITERAL <= len; ++i )
+		{
+		key = ((key << 8) | Fold(data[i + 2])) & 0xffffff;
+		uint32_t h = Hash(key);
+
+		if ( filter[h / 64] & (uint64_t(1) << (h % 64)) )
+			Verify(data, len, i, key, groups);
+		}
+	}
+
+	} // namespace zeek::detail
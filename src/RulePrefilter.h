@@ -0,0 +1,91 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <sys/types.h> // for u_char
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace zeek::detail
+	{
+
+// A literal string that every match of a signature pattern contains.
+struct RequiredLiteral
+	{
+	std::string text;
+	bool nocase = false;
+
+	// Upper bound on how much of a match can precede the literal.
+	size_t max_lead = 0;
+	};
+
+// Looks for a literal that every match of the given signature pattern
+// contains. Only patterns of the form /.*R/, which may start matching
+// anywhere in the data, qualify, and only literals that R can't put too
+// far into a match. Returns false if there's no such literal.
+extern bool extract_required_literal(const char* pattern, RequiredLiteral* lit);
+
+// Finds the required literals of a number of pattern groups in a stream
+// of data, so that the regular expressions of a group only need to see the
+// stream once one of the group's literals shows up.
+//
+// Each position of the data is checked against a bitmap of hashed,
+// case-folded three-byte literal prefixes first, and only the few that
+// pass that are compared with the literals themselves.
+class RulePrefilter
+	{
+public:
+	RulePrefilter();
+
+	// Adds a literal that unlocks the given group.
+	void Add(const RequiredLiteral& lit, int group);
+
+	// Returns how many bytes at the end of the data seen so far need to
+	// be passed to the next Scan() call. A group's regular expressions
+	// start matching there once the group is unlocked, which catches all
+	// matches containing the literal.
+	size_t Window() const { return window; }
+
+	// Scans data, preceded by the tail of the previous data, and appends
+	// to groups those that have a literal in there. Groups may show up
+	// more than once.
+	void Scan(const u_char* tail, size_t tail_len, const u_char* data, size_t len,
+	          std::vector<int>* groups) const;
+
+	// The minimum and maximum length of literals used for prefiltering.
+	static constexpr size_t MIN_LITERAL = 3;
+	static constexpr size_t MAX_LITERAL = 32;
+
+	// The largest lead of literals used for prefiltering.
+	static constexpr size_t MAX_LEAD = 256;
+
+private:
+	struct Literal
+		{
+		std::string text;
+		bool nocase;
+		int group;
+		};
+
+	static uint32_t Fold(u_char c)
+		{
+		return static_cast<unsigned>(c - 'A') < 26 ? c | 0x20 : c;
+		}
+
+	static uint32_t Hash(uint32_t key) { return (key * 0x9e3779b1) >> (32 - FILTER_BITS); }
+
+	// Checks the literals with the given prefix at position pos.
+	void Verify(const u_char* data, size_t len, size_t pos, uint32_t key,
+	            std::vector<int>* groups) const;
+
+	static constexpr int FILTER_BITS = 18;
+
+	std::vector<uint64_t> filter;
+	std::unordered_map<uint32_t, std::vector<Literal>> literals; // by folded prefix
+	size_t window = 0;
+	size_t max_literal = 0;
+	};
+
+	} // namespace zeek::detail
@@ -1,5 +1,8 @@
 #include "zeek/Stats.h"
 
+#include <netinet/in.h>
+#include <thread>
+
 #include "zeek/Conn.h"
 #include "zeek/DNS_Mgr.h"
 #include "zeek/Event.h"
@@ -10,11 +13,14 @@
 #include "zeek/RuleMatcher.h"
 #include "zeek/RunState.h"
 #include "zeek/Scope.h"
+#include "zeek/Stmt.h"
 #include "zeek/Trigger.h"
 #include "zeek/broker/Manager.h"
 #include "zeek/input.h"
+#include "zeek/iosource/Packet.h"
 #include "zeek/packet_analysis/protocol/tcp/TCP.h"
 #include "zeek/session/Manager.h"
+#include "zeek/telemetry/Manager.h"
 #include "zeek/threading/Manager.h"
 
 uint64_t zeek::detail::killed_by_inactivity = 0;
@@ -382,6 +388,210 @@ void SampleLogger::SegmentProfile(const char* /* name */, const Location* /* loc
 		                  make_intrusive<IntervalVal>(dtime, Seconds), val_mgr->Int(dmem));
 	}
 
+HandlerProfiler::HandlerProfiler(uint64_t arg_sample_rate)
+	{
+	sample_rate = arg_sample_rate > 0 ? arg_sample_rate : 1;
+	}
+
+HandlerProfiler::BodyStats* HandlerProfiler::Lookup(const Func* func, const Stmt* body)
+	{
+	auto [it, inserted] = body_stats.try_emplace(body);
+
+	if ( inserted )
+		{
+		auto loc = body->GetLocationInfo();
+		it->second.name = func->Name();
+		it->second.location = util::fmt("%s:%d", loc->filename ? loc->filename : "<unknown>",
+		                                loc->first_line);
+		}
+
+	return &it->second;
+	}
+
+void HandlerProfiler::Sample::Init(HandlerProfiler* profiler, const Func* func, const Stmt* body)
+	{
+	auto s = profiler->Lookup(func, body);
+
+	if ( s->calls++ % profiler->sample_rate != 0 )
+		return;
+
+	stats = s;
+	start = std::chrono::steady_clock::now();
+	}
+
+void HandlerProfiler::Sample::Report()
+	{
+	std::chrono::duration<double> dt = std::chrono::steady_clock::now() - start;
+	++stats->sampled_calls;
+	stats->sampled_time += dt.count();
+	}
+
+VectorValPtr HandlerProfiler::Snapshot()
+	{
+	static auto profile_vec_type = id::find_type<VectorType>("HandlerProfileVec");
+	static auto profile_type = id::find_type<RecordType>("HandlerProfile");
+
+	auto calls_family = telemetry_mgr->CounterFamily(
+		"zeek", "handler-calls", {"name", "location"},
+		"Number of invocations of script handler bodies", "1", true);
+	auto time_family = telemetry_mgr->CounterFamily<double>(
+		"zeek", "handler-time", {"name", "location"},
+		"Estimated time spent in script handler bodies", "seconds", true);
+
+	auto rval = make_intrusive<VectorVal>(profile_vec_type);
+
+	for ( auto& [body, s] : body_stats )
+		{
+		if ( s.calls == 0 )
+			continue;
+
+		double time = s.sampled_calls ? s.sampled_time * s.calls / s.sampled_calls : 0.0;
+
+		auto r = make_intrusive<RecordVal>(profile_type);
+		r->Assign(0, s.name);
+		r->Assign(1, s.location);
+		r->Assign(2, s.calls);
+		r->Assign(3, s.sampled_calls);
+		r->AssignInterval(4, time);
+		rval->Append(std::move(r));
+
+		const telemetry::LabelView labels[] = {{"name", s.name}, {"location", s.location}};
+		calls_family.GetOrAdd(labels).Inc(s.calls);
+		time_family.GetOrAdd(labels).Inc(time);
+
+		s.calls = s.sampled_calls = 0;
+		s.sampled_time = 0.0;
+		}
+
+	return rval;
+	}
+
+PacketStageProfiler::PacketStageProfiler(uint64_t arg_sample_rate) : sample_rate(arg_sample_rate)
+	{
+	histograms.resize(NUM_STAGES * NUM_PROTOCOLS);
+
+#if defined(__x86_64__) || defined(__i386__)
+	// Calibrates the time stamp counter against the steady clock.
+	auto start_time = std::chrono::steady_clock::now();
+	auto start_ticks = Now();
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	auto ticks = Now() - start_ticks;
+	std::chrono::duration<double> dt = std::chrono::steady_clock::now() - start_time;
+	seconds_per_tick = ticks ? dt.count() / ticks : 0.0;
+#else
+	seconds_per_tick = 1e-9;
+#endif
+	}
+
+PacketStageProfiler::~PacketStageProfiler() = default;
+
+void PacketStageProfiler::BeginPacket()
+	{
+	if ( sampling )
+		{
+		in_packet = false;
+		Finish();
+		}
+
+	// Polls that turn up no packet don't count, so that the sampled
+	// packet is the next one actually dispatched.
+	sampling = packets % sample_rate == 0;
+
+	if ( ! sampling )
+		return;
+
+	in_packet = true;
+	protocol = OTHER;
+
+	for ( int i = 0; i < NUM_STAGES; ++i )
+		{
+		ticks[i] = 0;
+		seen[i] = false;
+		}
+	}
+
+void PacketStageProfiler::SetProtocol(const Packet* pkt)
+	{
+	if ( ! sampling )
+		return;
+
+	switch ( pkt->l3_proto )
+		{
+		case L3_IPV4:
+		case L3_IPV6:
+			if ( ! pkt->ip_hdr )
+				protocol = OTHER_IP;
+
+			else
+				switch ( pkt->ip_hdr->NextProto() )
+					{
+					case IPPROTO_TCP:
+						protocol = TCP;
+						break;
+					case IPPROTO_UDP:
+						protocol = UDP;
+						break;
+					case IPPROTO_ICMP:
+					case IPPROTO_ICMPV6:
+						protocol = ICMP;
+						break;
+					default:
+						protocol = OTHER_IP;
+						break;
+					}
+
+			break;
+
+		case L3_ARP:
+			protocol = ARP;
+			break;
+
+		default:
+			protocol = OTHER;
+			break;
+		}
+	}
+
+void PacketStageProfiler::Finish()
+	{
+	if ( ! sampling || in_packet )
+		return;
+
+	static const char* stage_names[NUM_STAGES] = {
+		"capture",           "dispatch",       "session-lookup",
+		"analyzer-delivery", "event-queueing", "event-drain",
+	};
+
+	static const char* protocol_names[NUM_PROTOCOLS] = {
+		"tcp", "udp", "icmp", "ip", "arp", "other",
+	};
+
+	static const double bounds[] = {1e-6, 5e-6, 1e-5, 5e-5, 1e-4, 5e-4, 1e-3, 1e-2, 1e-1};
+
+	sampling = false;
+
+	if ( ! telemetry_mgr )
+		return;
+
+	for ( int i = 0; i < NUM_STAGES; ++i )
+		{
+		if ( ! seen[i] )
+			continue;
+
+		auto& h = histograms[i * NUM_PROTOCOLS + protocol];
+
+		if ( ! h )
+			{
+			h = telemetry_mgr->ShardedHistogramInstance<double>(
+				"zeek", "packet-stage-latency",
+				{{"stage", stage_names[i]}, {"protocol", protocol_names[protocol]}}, bounds,
+				"Time spent on sampled packets per stage of the packet path", "seconds");
+			}
+
+		h->Observe(ticks[i] * seconds_per_tick);
+		}
+	}
+
 void SegmentProfiler::Init()
 	{
 	getrusage(RUSAGE_SELF, &initial_rusage);
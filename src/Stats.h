@@ -8,18 +8,38 @@
 #include <sys/resource.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "zeek/IntrusivePtr.h"
 
 namespace zeek
 	{
 
+namespace telemetry
+	{
+template <class ValueType> class ShardedHistogram;
+	}
+
 class File;
 class Func;
+class Packet;
 class TableVal;
+class VectorVal;
+using VectorValPtr = IntrusivePtr<VectorVal>;
 
 namespace detail
 	{
 
 class Location;
+class Stmt;
 
 // Object called by SegmentProfiler when it is done and reports its
 // cumulative CPU/memory statistics.
@@ -106,9 +126,181 @@ protected:
 	TableVal* load_samples;
 	};
 
+// Attributes invocation counts and wall-clock time to the individual
+// bodies of script-level event handlers, hooks and functions.  Every
+// invocation is counted, but only one out of every "sample_rate"
+// invocations of a body gets timed, and its total time is extrapolated
+// from those.  Times include any functions that the body calls.
+class HandlerProfiler
+	{
+public:
+	struct BodyStats
+		{
+		std::string name;
+		std::string location;
+		uint64_t calls = 0;
+		uint64_t sampled_calls = 0;
+		double sampled_time = 0.0;
+		};
+
+	explicit HandlerProfiler(uint64_t sample_rate);
+
+	// Times a body's execution across its lifetime, if sampled.
+	class Sample
+		{
+	public:
+		Sample(HandlerProfiler* profiler, const Func* func, const Stmt* body)
+			{
+			if ( profiler )
+				Init(profiler, func, body);
+			}
+
+		~Sample()
+			{
+			if ( stats )
+				Report();
+			}
+
+	private:
+		void Init(HandlerProfiler* profiler, const Func* func, const Stmt* body);
+		void Report();
+
+		BodyStats* stats = nullptr;
+		std::chrono::steady_clock::time_point start;
+		};
+
+	// Returns a vector of HandlerProfile records covering all bodies
+	// invoked since the previous call, and starts a new interval.  The
+	// interval's counts are also added to the corresponding telemetry
+	// counters.
+	VectorValPtr Snapshot();
+
+private:
+	BodyStats* Lookup(const Func* func, const Stmt* body);
+
+	uint64_t sample_rate;
+	std::unordered_map<const Stmt*, BodyStats> body_stats;
+	};
+
+// Attributes the time spent on packets to the stages of the packet path,
+// per top-level protocol, to tell where time goes when packets get lost.
+// Only one out of every "sample_rate" packets gets timed, using the CPU's
+// time stamp counter where available.  A stage's time for a packet is the
+// total of all its invocations for that packet, including any stages
+// nested within, and includes draining the events that the packet queued.
+// Each sampled packet adds one observation per stage it went through to
+// the "packet-stage-latency" telemetry histograms.
+class PacketStageProfiler
+	{
+public:
+	enum Stage
+		{
+		CAPTURE, // reading the packet from its source
+		DISPATCH, // packet analysis as a whole
+		SESSION_LOOKUP, // looking up the packet's connection
+		ANALYZER_DELIVERY, // passing the packet to the connection's analyzers
+		EVENT_QUEUEING, // queueing events
+		EVENT_DRAIN, // processing the event queue after the packet
+		NUM_STAGES
+		};
+
+	explicit PacketStageProfiler(uint64_t sample_rate);
+	~PacketStageProfiler();
+
+	// Called before capturing the next packet, deciding whether to time
+	// it.  Reports the previous packet if sampled and still pending.
+	void BeginPacket();
+
+	// Called if capturing didn't produce a packet after all.
+	void CancelPacket() { sampling = false; }
+
+	// Notes the packet's top-level protocol once analysis is done.
+	void SetProtocol(const Packet* pkt);
+
+	// Called once a packet has been dispatched.  Its time gets reported
+	// after the event queue drains.
+	void EndPacket()
+		{
+		in_packet = false;
+		++packets;
+		}
+
+	// Reports the last packet if sampled and no longer dispatching.
+	void Finish();
+
+	// Times a stage across its lifetime, if the current packet is sampled.
+	// Only the outermost of nested samples of a stage counts, such as for
+	// the inner packet of a tunnel, as it covers the inner ones already.
+	class Sample
+		{
+	public:
+		Sample(PacketStageProfiler* profiler, Stage stage) : stage(stage)
+			{
+			if ( profiler && profiler->sampling && ! profiler->active[stage] )
+				{
+				this->profiler = profiler;
+				profiler->active[stage] = true;
+				start = Now();
+				}
+			}
+
+		~Sample()
+			{
+			if ( profiler )
+				{
+				profiler->ticks[stage] += Now() - start;
+				profiler->seen[stage] = true;
+				profiler->active[stage] = false;
+				}
+			}
+
+	private:
+		PacketStageProfiler* profiler = nullptr;
+		Stage stage;
+		uint64_t start = 0;
+		};
+
+private:
+	enum Protocol
+		{
+		TCP,
+		UDP,
+		ICMP,
+		OTHER_IP,
+		ARP,
+		OTHER,
+		NUM_PROTOCOLS
+		};
+
+	static uint64_t Now()
+		{
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		auto t = std::chrono::steady_clock::now().time_since_epoch();
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(t).count();
+#endif
+		}
+
+	uint64_t sample_rate;
+	uint64_t packets = 0; // dispatched ones
+	bool sampling = false;
+	bool in_packet = false;
+	Protocol protocol = OTHER;
+	uint64_t ticks[NUM_STAGES];
+	bool seen[NUM_STAGES];
+	bool active[NUM_STAGES] = {}; // stages with a Sample in progress
+	double seconds_per_tick;
+
+	// Created on first use, indexed by stage and protocol.
+	std::vector<std::unique_ptr<telemetry::ShardedHistogram<double>>> histograms;
+	};
+
 extern ProfileLogger* profiling_logger;
 extern ProfileLogger* segment_logger;
 extern SampleLogger* sample_logger;
+extern HandlerProfiler* handler_profiler;
+extern PacketStageProfiler* packet_stage_profiler;
 
 // Connection statistics.
 extern uint64_t killed_by_inactivity;
@@ -1313,7 +1313,11 @@ ValPtr ForStmt::DoExec(Frame* f, Val* v, StmtFlowType& flow)
 	if ( v->GetType()->Tag() == TYPE_TABLE )
 		{
 		TableVal* tv = v->AsTableVal();
-		const PDict<TableEntryVal>* loop_vals = tv->AsTable();
+
+		// Keeps the entries around even if the body modifies the
+		// table and so unshares its storage.
+		TableVal::LoopEntries loop_entries(*tv);
+		const PDict<TableEntryVal>* loop_vals = loop_entries.Get();
 
 		if ( ! loop_vals->Length() )
 			return nullptr;
@@ -1340,12 +1344,13 @@ ValPtr ForStmt::DoExec(Frame* f, Val* v, StmtFlowType& flow)
 
 	else if ( v->GetType()->Tag() == TYPE_VECTOR )
 		{
-		VectorVal* vv = v->AsVectorVal();
-		const auto& raw_vv = *vv->RawVec();
+		const VectorVal* vv = v->AsVectorVal();
 
 		for ( auto i = 0u; i < vv->Size(); ++i )
 			{
-			if ( ! raw_vv[i] )
+			// Fetched anew each time, as the body can modify
+			// the vector and so unshare its storage.
+			if ( ! vv->ConstRawVec()[i] )
 				continue;
 
 			// Set the loop variable to the current index, and make
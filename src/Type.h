@@ -1048,6 +1048,9 @@ extern zeek::OpaqueTypePtr entropy_type;
 extern zeek::OpaqueTypePtr cardinality_type;
 extern zeek::OpaqueTypePtr topk_type;
 extern zeek::OpaqueTypePtr bloomfilter_type;
+extern zeek::OpaqueTypePtr countmin_type;
+extern zeek::OpaqueTypePtr quantile_type;
+extern zeek::OpaqueTypePtr cuckoofilter_type;
 extern zeek::OpaqueTypePtr x509_opaque_type;
 extern zeek::OpaqueTypePtr ocsp_resp_opaque_type;
 extern zeek::OpaqueTypePtr paraglob_type;
@@ -36,6 +36,7 @@
 #include "zeek/broker/Data.h"
 #include "zeek/broker/Manager.h"
 #include "zeek/broker/Store.h"
+#include "zeek/telemetry/Manager.h"
 #include "zeek/threading/formatters/JSON.h"
 
 using namespace std;
@@ -43,6 +44,51 @@ using namespace std;
 namespace zeek
 	{
 
+namespace detail
+	{
+
+uint64_t val_allocations[NUM_TYPES];
+
+// How often, in seconds, update_val_metrics() brings the metrics up to
+// date, rather than on every call.
+static constexpr double VAL_METRICS_INTERVAL = 1.0;
+
+void update_val_metrics()
+	{
+	static std::vector<telemetry::IntCounter> metrics;
+	static uint64_t reported[NUM_TYPES];
+	static double next_update = 0.0;
+
+	if ( ! telemetry_mgr )
+		return;
+
+	double now = util::current_time();
+
+	if ( now < next_update )
+		return;
+
+	next_update = now + VAL_METRICS_INTERVAL;
+
+	if ( metrics.empty() )
+		{
+		auto family = telemetry_mgr->CounterFamily(
+			"zeek", "val-allocations", {"type"},
+			"Number of script values allocated, by type", "1", true);
+
+		for ( int i = 0; i < NUM_TYPES; ++i )
+			metrics.emplace_back(family.GetOrAdd({{"type", type_name(static_cast<TypeTag>(i))}}));
+		}
+
+	for ( int i = 0; i < NUM_TYPES; ++i )
+		if ( val_allocations[i] != reported[i] )
+			{
+			metrics[i].Inc(val_allocations[i] - reported[i]);
+			reported[i] = val_allocations[i];
+			}
+	}
+
+	} // namespace detail
+
 Val::~Val()
 	{
 #ifdef DEBUG
@@ -1123,6 +1169,9 @@ FileVal::FileVal(FilePtr f) : Val(make_intrusive<FileType>(base_type(TYPE_STRING
 	{
 	file_val = std::move(f);
 	assert(file_val->GetType()->Tag() == TYPE_STRING);
+
+	// Holds the file open; see File::Init().
+	ReleaseImmediately();
 	}
 
 ValPtr FileVal::SizeVal() const
@@ -1445,17 +1494,123 @@ TableVal::~TableVal()
 		detail::timer_mgr->Cancel(timer);
 
 	delete table_hash;
-	delete table_val;
+	ReleaseEntries(table_val, shared_cnt);
 	delete subnets;
 	delete expire_iterator;
 	}
 
+void TableVal::ReleaseEntries(PDict<TableEntryVal>* tbl, int* shared_cnt)
+	{
+	if ( shared_cnt )
+		{
+		if ( --*shared_cnt > 0 )
+			// Other tables or loops still use the entries.
+			return;
+
+		delete shared_cnt;
+		}
+
+	delete tbl;
+	}
+
+bool TableVal::CanShareEntries() const
+	{
+	// The prefix table points directly at the entries, and expiration
+	// updates their access times in place.
+	if ( subnets || expire_time || expire_func )
+		return false;
+
+	// Loops that started before the table got shared don't hold
+	// on to its entries, so sharing them could pull them out from
+	// under such a loop once the loop body modifies the table.
+	if ( table_val->IsIterating() )
+		return false;
+
+	if ( table_type->IsSet() )
+		return true;
+
+	switch ( table_type->Yield()->InternalType() )
+		{
+		case TYPE_INTERNAL_INT:
+		case TYPE_INTERNAL_UNSIGNED:
+		case TYPE_INTERNAL_DOUBLE:
+		case TYPE_INTERNAL_STRING:
+		case TYPE_INTERNAL_ADDR:
+		case TYPE_INTERNAL_SUBNET:
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
+void TableVal::Unshare()
+	{
+	if ( --*shared_cnt == 0 )
+		// We're the last user, so we get to keep them.
+		delete shared_cnt;
+
+	else
+		{
+		auto tbl = new PDict<TableEntryVal>;
+		tbl->SetDeleteFunc(table_entry_val_delete_func);
+
+		for ( const auto& tble : *table_val )
+			{
+			auto key = tble.GetHashKey();
+			auto* val = tble.GetValue<TableEntryVal*>();
+			tbl->Insert(key.get(), new TableEntryVal(*val));
+			}
+
+		table_val = tbl;
+		}
+
+	shared_cnt = nullptr;
+	}
+
+TableVal::LoopEntries::LoopEntries(const TableVal& tv) : tbl(tv.table_val), shared_cnt(tv.shared_cnt)
+	{
+	if ( shared_cnt )
+		++*shared_cnt;
+	}
+
+TableVal::LoopEntries::LoopEntries(const LoopEntries& other)
+	: tbl(other.tbl), shared_cnt(other.shared_cnt)
+	{
+	if ( shared_cnt )
+		++*shared_cnt;
+	}
+
+TableVal::LoopEntries::~LoopEntries()
+	{
+	if ( shared_cnt )
+		ReleaseEntries(tbl, shared_cnt);
+	}
+
+TableVal::LoopEntries& TableVal::LoopEntries::operator=(const LoopEntries& other)
+	{
+	if ( this == &other )
+		return *this;
+
+	if ( other.shared_cnt )
+		++*other.shared_cnt;
+
+	if ( shared_cnt )
+		ReleaseEntries(tbl, shared_cnt);
+
+	tbl = other.tbl;
+	shared_cnt = other.shared_cnt;
+
+	return *this;
+	}
+
 void TableVal::RemoveAll()
 	{
 	delete expire_iterator;
 	expire_iterator = nullptr;
 	// Here we take the brute force approach.
-	delete table_val;
+	ReleaseEntries(table_val, shared_cnt);
+	shared_cnt = nullptr;
 	table_val = new PDict<TableEntryVal>;
 	table_val->SetDeleteFunc(table_entry_val_delete_func);
 	}
@@ -1484,6 +1639,10 @@ int TableVal::RecursiveSize() const
 
 void TableVal::SetAttrs(detail::AttributesPtr a)
 	{
+	// The attributes may enable expiration, which updates entries
+	// in place.
+	MakeUnique();
+
 	attrs = std::move(a);
 
 	if ( ! attrs )
@@ -1568,6 +1727,8 @@ bool TableVal::Assign(ValPtr index, std::unique_ptr<detail::HashKey> k, ValPtr n
 	if ( (is_set && new_val) || (! is_set && ! new_val) )
 		InternalWarning("bad set/table in TableVal::Assign");
 
+	MakeUnique();
+
 	TableEntryVal* new_entry_val = new TableEntryVal(std::move(new_val));
 	detail::HashKey k_copy(k->Key(), k->Size(), k->Hash());
 	TableEntryVal* old_entry_val = table_val->Insert(k.get(), new_entry_val, iterators_invalidated);
@@ -2010,6 +2171,8 @@ TableValPtr TableVal::LookupSubnetValues(const SubNetVal* search)
 
 bool TableVal::UpdateTimestamp(Val* index)
 	{
+	MakeUnique();
+
 	TableEntryVal* v;
 
 	if ( subnets )
@@ -2116,11 +2279,6 @@ void TableVal::SendToStore(const Val* index, const TableEntryVal* new_entry_val,
 
 	try
 		{
-		auto handle = broker_mgr->LookupStore(broker_store);
-
-		if ( ! handle )
-			return;
-
 		// For simple indexes, we either get passed the raw index_val - or a ListVal with exactly
 		// one element. We unoll this in the second case. For complex indexes, we just pass the
 		// ListVal.
@@ -2138,6 +2296,11 @@ void TableVal::SendToStore(const Val* index, const TableEntryVal* new_entry_val,
 			return;
 			}
 
+		auto handle = broker_mgr->LookupTableStore(broker_store, *broker_index);
+
+		if ( ! handle )
+			return;
+
 		switch ( tpe )
 			{
 			case ELEMENT_NEW:
@@ -2168,7 +2331,7 @@ void TableVal::SendToStore(const Val* index, const TableEntryVal* new_entry_val,
 					}
 
 				if ( table_type->IsSet() )
-					handle->store.put(std::move(*broker_index), broker::data(), expiry);
+					handle->Write(std::move(*broker_index), broker::data(), expiry);
 				else
 					{
 					if ( ! new_entry_val )
@@ -2186,13 +2349,13 @@ void TableVal::SendToStore(const Val* index, const TableEntryVal* new_entry_val,
 						return;
 						}
 
-					handle->store.put(std::move(*broker_index), std::move(*broker_val), expiry);
+					handle->Write(std::move(*broker_index), std::move(*broker_val), expiry);
 					}
 				break;
 				}
 
 			case ELEMENT_REMOVED:
-				handle->store.erase(std::move(*broker_index));
+				handle->Write(std::move(*broker_index), std::nullopt);
 				break;
 
 			case ELEMENT_EXPIRED:
@@ -2213,6 +2376,8 @@ ValPtr TableVal::Remove(const Val& index, bool broker_forward, bool* iterators_i
 	{
 	auto k = MakeHashKey(index);
 
+	MakeUnique();
+
 	TableEntryVal* v = k ? table_val->RemoveEntry(k.get(), iterators_invalidated) : nullptr;
 	ValPtr va;
 
@@ -2241,6 +2406,8 @@ ValPtr TableVal::Remove(const Val& index, bool broker_forward, bool* iterators_i
 
 ValPtr TableVal::Remove(const detail::HashKey& k, bool* iterators_invalidated)
 	{
+	MakeUnique();
+
 	TableEntryVal* v = table_val->RemoveEntry(k, iterators_invalidated);
 	ValPtr va;
 
@@ -2715,18 +2882,34 @@ ValPtr TableVal::DoClone(CloneState* state)
 	auto tv = make_intrusive<TableVal>(table_type);
 	state->NewClone(this, tv);
 
-	const PDict<TableEntryVal>* tbl = AsTable();
-	for ( const auto& tble : *table_val )
+	if ( CanShareEntries() )
 		{
-		auto key = tble.GetHashKey();
-		auto* val = tble.GetValue<TableEntryVal*>();
-		TableEntryVal* nval = val->Clone(state);
-		tv->table_val->Insert(key.get(), nval);
+		// The entries are immutable, so the clone can use ours
+		// until either of us modifies them.
+		if ( ! shared_cnt )
+			shared_cnt = new int(1);
+
+		++*shared_cnt;
 
-		if ( subnets )
+		delete tv->table_val;
+		tv->table_val = table_val;
+		tv->shared_cnt = shared_cnt;
+		}
+
+	else
+		{
+		for ( const auto& tble : *table_val )
 			{
-			auto idx = RecreateIndex(*key);
-			tv->subnets->Insert(idx.get(), nval);
+			auto key = tble.GetHashKey();
+			auto* val = tble.GetValue<TableEntryVal*>();
+			TableEntryVal* nval = val->Clone(state);
+			tv->table_val->Insert(key.get(), nval);
+
+			if ( subnets )
+				{
+				auto idx = RecreateIndex(*key);
+				tv->subnets->Insert(idx.get(), nval);
+				}
 			}
 		}
 
@@ -3184,6 +3367,15 @@ VectorVal::VectorVal(VectorTypePtr t, std::vector<std::optional<ZVal>>* vals) :
 
 VectorVal::~VectorVal()
 	{
+	if ( shared_cnt )
+		{
+		if ( --*shared_cnt > 0 )
+			// Other vectors still own the elements.
+			return;
+
+		delete shared_cnt;
+		}
+
 	if ( yield_types )
 		{
 		int n = yield_types->size();
@@ -3206,6 +3398,45 @@ VectorVal::~VectorVal()
 	delete vector_val;
 	}
 
+bool VectorVal::CanShareElements() const
+	{
+	if ( any_yield || yield_types )
+		return false;
+
+	switch ( yield_type->InternalType() )
+		{
+		case TYPE_INTERNAL_INT:
+		case TYPE_INTERNAL_UNSIGNED:
+		case TYPE_INTERNAL_DOUBLE:
+		case TYPE_INTERNAL_STRING:
+		case TYPE_INTERNAL_ADDR:
+		case TYPE_INTERNAL_SUBNET:
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
+void VectorVal::Unshare()
+	{
+	if ( --*shared_cnt == 0 )
+		// We're the last user, so we get to keep it.
+		delete shared_cnt;
+
+	else
+		{
+		vector_val = new vector<std::optional<ZVal>>(*vector_val);
+
+		if ( managed_yield )
+			for ( auto& elem : *vector_val )
+				if ( elem )
+					Ref(elem->ManagedVal());
+		}
+
+	shared_cnt = nullptr;
+	}
+
 ValPtr VectorVal::SizeVal() const
 	{
 	return val_mgr->Count(uint32_t(vector_val->size()));
@@ -3257,6 +3488,8 @@ bool VectorVal::Assign(unsigned int index, ValPtr element)
 	if ( ! CheckElementType(element) )
 		return false;
 
+	MakeUnique();
+
 	unsigned int n = vector_val->size();
 
 	if ( index >= n )
@@ -3310,6 +3543,8 @@ bool VectorVal::Insert(unsigned int index, ValPtr element)
 	if ( ! CheckElementType(element) )
 		return false;
 
+	MakeUnique();
+
 	vector<std::optional<ZVal>>::iterator it;
 	vector<TypePtr>::iterator types_it;
 
@@ -3364,6 +3599,8 @@ bool VectorVal::Remove(unsigned int index)
 	if ( index >= vector_val->size() )
 		return false;
 
+	MakeUnique();
+
 	auto it = std::next(vector_val->begin(), index);
 
 	if ( yield_types )
@@ -3507,6 +3744,8 @@ void VectorVal::Sort(Func* cmp_func)
 	if ( yield_types )
 		reporter->RuntimeError(GetLocationInfo(), "cannot sort a vector-of-any");
 
+	MakeUnique();
+
 	sort_type = yield_type;
 
 	bool (*sort_func)(const std::optional<ZVal>&, const std::optional<ZVal>&);
@@ -3642,6 +3881,8 @@ bool VectorVal::Concretize(const TypePtr& t)
 
 unsigned int VectorVal::Resize(unsigned int new_num_elements)
 	{
+	MakeUnique();
+
 	unsigned int oldsize = vector_val->size();
 	vector_val->reserve(new_num_elements);
 	vector_val->resize(new_num_elements);
@@ -3666,14 +3907,90 @@ unsigned int VectorVal::ResizeAtLeast(unsigned int new_num_elements)
 
 void VectorVal::Reserve(unsigned int num_elements)
 	{
+	MakeUnique();
+
 	vector_val->reserve(num_elements);
 
 	if ( yield_types )
 		yield_types->reserve(num_elements);
 	}
 
+// Folds the elements of the vector-of-numeric "vv" into "result" using
+// "f", accessing them through "field".  The first element seeds the
+// fold if "result" is not already seeded.  Returns true if there was
+// at least one element.
+template <typename T, typename F>
+static bool fold_numeric(const VectorVal* vv, T ZVal::*field, ZVal& result, bool seeded, F f)
+	{
+	bool have_result = false;
+
+	for ( const auto& e : vv->ConstRawVec() )
+		if ( e )
+			{
+			if ( seeded || have_result )
+				result.*field = f(result.*field, (*e).*field);
+			else
+				result.*field = (*e).*field;
+
+			have_result = true;
+			}
+
+	return have_result;
+	}
+
+template <typename F>
+static bool fold_numeric(const VectorVal* vv, ZVal& result, bool seeded, F f)
+	{
+	switch ( vv->GetType()->Yield()->InternalType() )
+		{
+		case TYPE_INTERNAL_INT:
+			return fold_numeric(vv, &ZVal::int_val, result, seeded, f);
+
+		case TYPE_INTERNAL_UNSIGNED:
+			return fold_numeric(vv, &ZVal::uint_val, result, seeded, f);
+
+		case TYPE_INTERNAL_DOUBLE:
+			return fold_numeric(vv, &ZVal::double_val, result, seeded, f);
+
+		default:
+			reporter->InternalError("non-numeric vector in VectorVal numeric reduction");
+		}
+	}
+
+ZVal VectorVal::NumericSum() const
+	{
+	ZVal sum(GetType()->Yield());
+	fold_numeric(this, sum, true, [](auto a, auto b) { return a + b; });
+	return sum;
+	}
+
+bool VectorVal::NumericMin(ZVal& result) const
+	{
+	return fold_numeric(this, result, false, [](auto a, auto b) { return b < a ? b : a; });
+	}
+
+bool VectorVal::NumericMax(ZVal& result) const
+	{
+	return fold_numeric(this, result, false, [](auto a, auto b) { return b > a ? b : a; });
+	}
+
 ValPtr VectorVal::DoClone(CloneState* state)
 	{
+	if ( CanShareElements() )
+		{
+		// The elements are immutable, so the clone can use our
+		// storage until either of us modifies it.
+		if ( ! shared_cnt )
+			shared_cnt = new int(1);
+
+		++*shared_cnt;
+
+		auto vv = make_intrusive<VectorVal>(GetType<VectorType>(), vector_val);
+		vv->shared_cnt = shared_cnt;
+		state->NewClone(this, vv);
+		return vv;
+		}
+
 	auto vv = make_intrusive<VectorVal>(GetType<VectorType>());
 	vv->Reserve(vector_val->size());
 	state->NewClone(this, vv);
@@ -49,6 +49,15 @@ class HashKey;
 
 class ZBody;
 
+// The number of values allocated for each type tag, which mostly tells
+// apart the Val subclasses too. Plain counters, as values only get
+// allocated on the main thread.
+extern uint64_t val_allocations[NUM_TYPES];
+
+// Brings the val-allocations metrics up to date with the counters, at
+// most once a second.
+extern void update_val_metrics();
+
 	} // namespace detail
 
 namespace run_state
@@ -240,7 +249,10 @@ protected:
 	static ValPtr MakeInt(bro_int_t i);
 	static ValPtr MakeCount(bro_uint_t u);
 
-	explicit Val(TypePtr t) noexcept : type(std::move(t)) { }
+	explicit Val(TypePtr t) noexcept : type(std::move(t))
+		{
+		++detail::val_allocations[type->Tag()];
+		}
 
 	// For internal use by the Val::Clone() methods.
 	struct CloneState
@@ -924,6 +936,29 @@ public:
 
 	const PDict<TableEntryVal>* Get() const { return table_val; }
 
+	/**
+	 * Holds on to a table's entries while a loop iterates over them.
+	 * A loop body modifying a table whose entries are shared with
+	 * copies of it leaves the table with entries of its own, so the
+	 * loop keeps its share of the ones it is iterating over alive
+	 * until it's done.
+	 */
+	class LoopEntries
+		{
+	public:
+		explicit LoopEntries(const TableVal& tv);
+		LoopEntries(const LoopEntries& other);
+		~LoopEntries();
+
+		LoopEntries& operator=(const LoopEntries& other);
+
+		const PDict<TableEntryVal>* Get() const { return tbl; }
+
+	private:
+		PDict<TableEntryVal>* tbl;
+		int* shared_cnt;
+		};
+
 	// Returns the size of the table.
 	int Size() const;
 	int RecursiveSize() const;
@@ -991,6 +1026,11 @@ public:
 	 */
 	void EnableChangeNotifications() { in_change_func = false; }
 
+	/**
+	 * @return true if the table has an &on_change function.
+	 */
+	bool HasChangeNotifications() const { return change_func != nullptr; }
+
 protected:
 	void Init(TableTypePtr t);
 
@@ -1055,7 +1095,32 @@ protected:
 	static ParseTimeTableStates parse_time_table_states;
 
 private:
+	// Whether clones of this table can share its entries until one
+	// of them gets modified.  True for sets and for tables holding
+	// immutable values, as long as nothing besides the dictionary
+	// refers to the entries and they don't expire.
+	bool CanShareEntries() const;
+
+	// Ensures that table_val is not shared with any other table.
+	// Needs to be called before modifying the entries in any way.
+	void MakeUnique()
+		{
+		if ( shared_cnt )
+			Unshare();
+		}
+
+	void Unshare();
+
+	// Gives up one share of the given entries, deleting them if it
+	// was the last one.
+	static void ReleaseEntries(PDict<TableEntryVal>* tbl, int* shared_cnt);
+
 	PDict<TableEntryVal>* table_val;
+
+	// If non-nil, table_val is shared copy-on-write with clones of
+	// this table (and loops over them), and this points to the number
+	// of its users.
+	int* shared_cnt = nullptr;
 	};
 
 // This would be way easier with is_convertible_v, but sadly that won't
@@ -1620,9 +1685,33 @@ public:
 		}
 	const String* StringAt(unsigned int index) const { return StringValAt(index)->AsString(); }
 
-	// Only intended for low-level access by compiled code.
+	/**
+	 * Reductions over the elements of a vector of a numeric type (int,
+	 * count, double, time, interval, ...).  The result has the vector's
+	 * yield type, so for example summing a vector of count overflows
+	 * just as adding counts in script-land does.  Holes are skipped.
+	 * The caller must ensure that the vector's yield type is numeric.
+	 * @param result  For the minimum/maximum, set to the result unless
+	 * the vector has no elements.
+	 * @return  For the sum, the sum, which is zero if the vector has
+	 * no elements.  For the minimum/maximum, false if the vector has
+	 * no elements, true otherwise.
+	 */
+	ZVal NumericSum() const;
+	bool NumericMin(ZVal& result) const;
+	bool NumericMax(ZVal& result) const;
+
+	// Only intended for low-level access by compiled code.  The
+	// non-const version assumes the caller may modify the elements,
+	// and so unshares them first; ConstRawVec() is for read-only
+	// access and leaves shared storage in place.
 	const auto& RawVec() const { return vector_val; }
-	auto& RawVec() { return vector_val; }
+	const std::vector<std::optional<ZVal>>& ConstRawVec() const { return *vector_val; }
+	auto& RawVec()
+		{
+		MakeUnique();
+		return vector_val;
+		}
 
 protected:
 	/**
@@ -1652,8 +1741,26 @@ private:
 	// Add the given number of "holes" to the end of a vector.
 	void AddHoles(int nholes);
 
+	// Whether clones of this vector can share its elements until one
+	// of them gets modified.  True for vectors holding immutable values.
+	bool CanShareElements() const;
+
+	// Ensures that vector_val is not shared with any other vector.
+	// Needs to be called before modifying the elements in any way.
+	void MakeUnique()
+		{
+		if ( shared_cnt )
+			Unshare();
+		}
+
+	void Unshare();
+
 	std::vector<std::optional<ZVal>>* vector_val;
 
+	// If non-nil, vector_val is shared copy-on-write with clones of
+	// this vector, and this points to the number of vectors sharing it.
+	int* shared_cnt = nullptr;
+
 	// For homogeneous vectors (the usual case), the type of the
 	// elements.  Will be TYPE_VOID for empty vectors created using
 	// "vector()".
@@ -130,6 +130,7 @@ public:
 	void SubmitAllHeaders(analyzer::mime::MIME_HeaderList& /* hlist */) override;
 	void SubmitData(int len, const char* buf) override;
 	bool RequestBuffer(int* plen, char** pbuf) override;
+	bool AcceptsUnbufferedData() const override { return true; }
 	void SubmitAllData();
 	void SubmitEvent(int event_type, const char* detail) override;
 
@@ -1214,6 +1214,16 @@ void MIME_Entity::DataOctets(int len, const char* data)
 		if ( data_buf_offset < 0 && ! GetDataBuffer() )
 			return;
 
+		if ( data_buf_offset == 0 && len >= data_buf_length && message->AcceptsUnbufferedData() )
+			{
+			// Nothing buffered and a full chunk available: pass it on
+			// straight from the caller's data rather than copying it.
+			SubmitData(data_buf_length, data);
+			data += data_buf_length;
+			len -= data_buf_length;
+			continue;
+			}
+
 		int n = std::min(data_buf_length - data_buf_offset, len);
 		memcpy(data_buf_data + data_buf_offset, data, n);
 		data += n;
@@ -232,6 +232,11 @@ public:
 	virtual bool RequestBuffer(int* plen, char** pbuf) = 0;
 	virtual void SubmitEvent(int event_type, const char* detail) = 0;
 
+	// Returns true if SubmitData() may be passed data that doesn't live
+	// in the buffer handed out by RequestBuffer(), letting entities skip
+	// copying full chunks into it.
+	virtual bool AcceptsUnbufferedData() const { return false; }
+
 protected:
 	analyzer::Analyzer* analyzer;
 
@@ -1,8 +1,11 @@
 #include "zeek/analyzer/protocol/tcp/ContentLine.h"
 
+#include <algorithm>
+
 #include "zeek/Reporter.h"
 #include "zeek/analyzer/protocol/tcp/TCP.h"
 #include "zeek/analyzer/protocol/tcp/events.bif.h"
+#include "zeek/util.h"
 
 namespace zeek::analyzer::tcp
 	{
@@ -229,6 +232,30 @@ int ContentLine_Analyzer::DoDeliverOnce(int len, const u_char* data)
 
 	for ( ; len > 0; --len, ++data )
 		{
+		if ( last_char != '\r' && offset < max_line_length )
+			{
+			// Copy the run of bytes up to the next CR, LF or NUL in one
+			// go; those are the only ones the switch below treats
+			// specially. A preceding CR needs the per-byte weird check.
+			int avail = std::min(len, max_line_length - offset);
+			int n = util::find_line_delimiter(data, data + avail) - data;
+
+			if ( n > 0 )
+				{
+				if ( offset + n > buf_len )
+					InitBuffer(std::max(buf_len * 2, offset + n));
+
+				memcpy(buf + offset, data, n);
+				offset += n;
+				data += n;
+				len -= n;
+				last_char = data[-1];
+
+				if ( len == 0 )
+					break;
+				}
+			}
+
 		if ( offset >= buf_len )
 			InitBuffer(buf_len * 2);
 
@@ -0,0 +1,958 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/broker/CompactEvents.h"
+
+#include <cstring>
+
+#include "zeek/3rdparty/doctest.h"
+#include "zeek/Desc.h"
+#include "zeek/Expr.h"
+#include "zeek/IPAddr.h"
+#include "zeek/Type.h"
+#include "zeek/Val.h"
+#include "zeek/ZeekString.h"
+#include "zeek/module_util.h"
+
+namespace zeek::Broker::detail
+	{
+
+namespace
+	{
+
+void write_count(std::string* buf, uint64_t n)
+	{
+	while ( n >= 0x80 )
+		{
+		buf->push_back(static_cast<char>((n & 0x7f) | 0x80));
+		n >>= 7;
+		}
+
+	buf->push_back(static_cast<char>(n));
+	}
+
+void write_int(std::string* buf, int64_t n)
+	{
+	write_count(buf, (static_cast<uint64_t>(n) << 1) ^ static_cast<uint64_t>(n >> 63));
+	}
+
+void write_double(std::string* buf, double d)
+	{
+	uint64_t bits;
+	memcpy(&bits, &d, sizeof(bits));
+
+	for ( int i = 0; i < 8; ++i )
+		buf->push_back(static_cast<char>(bits >> (8 * i)));
+	}
+
+void write_bytes(std::string* buf, const void* bytes, size_t len)
+	{
+	write_count(buf, len);
+	buf->append(static_cast<const char*>(bytes), len);
+	}
+
+void write_addr(std::string* buf, const IPAddr& a)
+	{
+	const uint32_t* bytes;
+	int words = a.GetBytes(&bytes);
+	buf->push_back(static_cast<char>(words));
+	buf->append(reinterpret_cast<const char*>(bytes), words * sizeof(uint32_t));
+	}
+
+// Writes a value according to its declared type. Values with types not
+// known in advance, like "any", aren't supported.
+bool write_val(std::string* buf, const Val* v, const Type* t)
+	{
+	switch ( t->Tag() )
+		{
+		case TYPE_BOOL:
+			buf->push_back(v->AsBool() ? 1 : 0);
+			return true;
+
+		case TYPE_INT:
+			write_int(buf, v->AsInt());
+			return true;
+
+		case TYPE_COUNT:
+			write_count(buf, v->AsCount());
+			return true;
+
+		case TYPE_DOUBLE:
+			write_double(buf, v->AsDouble());
+			return true;
+
+		case TYPE_TIME:
+			write_double(buf, v->AsTime());
+			return true;
+
+		case TYPE_INTERVAL:
+			write_double(buf, v->AsInterval());
+			return true;
+
+		case TYPE_STRING:
+			{
+			auto s = v->AsString();
+			write_bytes(buf, s->Bytes(), s->Len());
+			return true;
+			}
+
+		case TYPE_ADDR:
+			write_addr(buf, v->AsAddr());
+			return true;
+
+		case TYPE_SUBNET:
+			{
+			const auto& s = v->AsSubNet();
+			write_addr(buf, s.Prefix());
+			buf->push_back(static_cast<char>(s.Length()));
+			return true;
+			}
+
+		case TYPE_PORT:
+			{
+			auto p = v->AsPortVal();
+			write_count(buf, p->Port());
+			buf->push_back(static_cast<char>(p->PortType()));
+			return true;
+			}
+
+		case TYPE_ENUM:
+			{
+			// By name, like Broker data does, since enum values may differ
+			// between nodes.
+			auto name = t->AsEnumType()->Lookup(v->AsEnum());
+
+			if ( ! name )
+				return false;
+
+			write_bytes(buf, name, strlen(name));
+			return true;
+			}
+
+		case TYPE_RECORD:
+			{
+			auto rt = t->AsRecordType();
+			auto rec = v->AsRecordVal();
+			auto num_fields = rt->NumFields();
+			write_count(buf, num_fields);
+
+			for ( int i = 0; i < num_fields; ++i )
+				{
+				auto field = rec->GetFieldOrDefault(i);
+				buf->push_back(field ? 1 : 0);
+
+				if ( field && ! write_val(buf, field.get(), rt->GetFieldType(i).get()) )
+					return false;
+				}
+
+			return true;
+			}
+
+		case TYPE_VECTOR:
+			{
+			const auto& yield = t->AsVectorType()->Yield();
+			auto vec = v->AsVectorVal();
+			write_count(buf, vec->Size());
+
+			for ( auto i = 0u; i < vec->Size(); ++i )
+				{
+				auto item = vec->ValAt(i);
+				buf->push_back(item ? 1 : 0);
+
+				if ( item && ! write_val(buf, item.get(), yield.get()) )
+					return false;
+				}
+
+			return true;
+			}
+
+		case TYPE_TABLE:
+			{
+			auto tt = t->AsTableType();
+			const auto& index_types = tt->GetIndexTypes();
+			const auto& yield = tt->Yield();
+			auto tv = v->AsTableVal();
+			write_count(buf, tv->Size());
+
+			for ( const auto& te : *v->AsTable() )
+				{
+				auto hk = te.GetHashKey();
+				auto index = tv->RecreateIndex(*hk);
+
+				if ( static_cast<size_t>(index->Length()) != index_types.size() )
+					return false;
+
+				for ( size_t i = 0; i < index_types.size(); ++i )
+					if ( ! write_val(buf, index->Idx(i).get(), index_types[i].get()) )
+						return false;
+
+				if ( yield )
+					{
+					auto entry = te.GetValue<TableEntryVal*>();
+
+					if ( ! write_val(buf, entry->GetVal().get(), yield.get()) )
+						return false;
+					}
+				}
+
+			return true;
+			}
+
+		default:
+			return false;
+		}
+	}
+
+class Decoder
+	{
+public:
+	explicit Decoder(std::string_view data) : p(data.data()), end(data.data() + data.size()) { }
+
+	bool AtEnd() const { return p == end; }
+
+	bool ReadByte(uint8_t* b)
+		{
+		if ( p == end )
+			return false;
+
+		*b = static_cast<uint8_t>(*p++);
+		return true;
+		}
+
+	bool ReadCount(uint64_t* n)
+		{
+		*n = 0;
+
+		for ( int shift = 0; shift < 64; shift += 7 )
+			{
+			uint8_t b;
+
+			if ( ! ReadByte(&b) )
+				return false;
+
+			*n |= static_cast<uint64_t>(b & 0x7f) << shift;
+
+			if ( ! (b & 0x80) )
+				return true;
+			}
+
+		return false;
+		}
+
+	bool ReadInt(int64_t* n)
+		{
+		uint64_t u;
+
+		if ( ! ReadCount(&u) )
+			return false;
+
+		*n = static_cast<int64_t>((u >> 1) ^ (~(u & 1) + 1));
+		return true;
+		}
+
+	bool ReadDouble(double* d)
+		{
+		if ( end - p < 8 )
+			return false;
+
+		uint64_t bits = 0;
+
+		for ( int i = 0; i < 8; ++i )
+			bits |= static_cast<uint64_t>(static_cast<uint8_t>(p[i])) << (8 * i);
+
+		memcpy(d, &bits, sizeof(bits));
+		p += 8;
+		return true;
+		}
+
+	bool ReadBytes(std::string_view* s)
+		{
+		uint64_t len;
+
+		if ( ! ReadCount(&len) || len > static_cast<uint64_t>(end - p) )
+			return false;
+
+		*s = {p, len};
+		p += len;
+		return true;
+		}
+
+	bool ReadAddr(IPAddr* a)
+		{
+		uint8_t words;
+
+		if ( ! ReadByte(&words) || (words != 1 && words != 4) ||
+		     static_cast<size_t>(end - p) < words * sizeof(uint32_t) )
+			return false;
+
+		uint32_t bytes[4];
+		memcpy(bytes, p, words * sizeof(uint32_t));
+		p += words * sizeof(uint32_t);
+		*a = IPAddr(words == 1 ? IPv4 : IPv6, bytes, IPAddr::Network);
+		return true;
+		}
+
+	bool ReadLength(uint32_t* n)
+		{
+		if ( end - p < 4 )
+			return false;
+
+		*n = 0;
+
+		for ( int i = 0; i < 4; ++i )
+			*n |= static_cast<uint32_t>(static_cast<uint8_t>(p[i])) << (8 * i);
+
+		p += 4;
+		return true;
+		}
+
+	ValPtr ReadVal(Type* t);
+
+private:
+	const char* p;
+	const char* end;
+	};
+
+ValPtr Decoder::ReadVal(Type* t)
+	{
+	switch ( t->Tag() )
+		{
+		case TYPE_BOOL:
+			{
+			uint8_t b;
+
+			if ( ! ReadByte(&b) )
+				return nullptr;
+
+			return val_mgr->Bool(b);
+			}
+
+		case TYPE_INT:
+			{
+			int64_t n;
+
+			if ( ! ReadInt(&n) )
+				return nullptr;
+
+			return val_mgr->Int(n);
+			}
+
+		case TYPE_COUNT:
+			{
+			uint64_t n;
+
+			if ( ! ReadCount(&n) )
+				return nullptr;
+
+			return val_mgr->Count(n);
+			}
+
+		case TYPE_DOUBLE:
+		case TYPE_TIME:
+		case TYPE_INTERVAL:
+			{
+			double d;
+
+			if ( ! ReadDouble(&d) )
+				return nullptr;
+
+			if ( t->Tag() == TYPE_TIME )
+				return make_intrusive<TimeVal>(d);
+
+			if ( t->Tag() == TYPE_INTERVAL )
+				return make_intrusive<IntervalVal>(d);
+
+			return make_intrusive<DoubleVal>(d);
+			}
+
+		case TYPE_STRING:
+			{
+			std::string_view s;
+
+			if ( ! ReadBytes(&s) )
+				return nullptr;
+
+			return make_intrusive<StringVal>(s.size(), s.data());
+			}
+
+		case TYPE_ADDR:
+			{
+			IPAddr a;
+
+			if ( ! ReadAddr(&a) )
+				return nullptr;
+
+			return make_intrusive<AddrVal>(a);
+			}
+
+		case TYPE_SUBNET:
+			{
+			IPAddr a;
+			uint8_t len;
+
+			if ( ! ReadAddr(&a) || ! ReadByte(&len) )
+				return nullptr;
+
+			if ( len > (a.GetFamily() == IPv4 ? 32 : 128) )
+				return nullptr;
+
+			return make_intrusive<SubNetVal>(IPPrefix(a, len));
+			}
+
+		case TYPE_PORT:
+			{
+			uint64_t port;
+			uint8_t proto;
+
+			if ( ! ReadCount(&port) || ! ReadByte(&proto) || port > 0xffff ||
+			     proto > TRANSPORT_ICMP )
+				return nullptr;
+
+			return val_mgr->Port(port, static_cast<TransportProto>(proto));
+			}
+
+		case TYPE_ENUM:
+			{
+			std::string_view s;
+
+			if ( ! ReadBytes(&s) )
+				return nullptr;
+
+			auto etype = t->AsEnumType();
+			auto i = etype->Lookup(zeek::detail::GLOBAL_MODULE_NAME, std::string(s).c_str());
+
+			if ( i == -1 )
+				return nullptr;
+
+			return etype->GetEnumVal(i);
+			}
+
+		case TYPE_RECORD:
+			{
+			auto rt = t->AsRecordType();
+			uint64_t num_fields;
+
+			if ( ! ReadCount(&num_fields) ||
+			     num_fields != static_cast<uint64_t>(rt->NumFields()) )
+				return nullptr;
+
+			auto rval = make_intrusive<RecordVal>(IntrusivePtr{NewRef{}, rt});
+
+			for ( int i = 0; i < rt->NumFields(); ++i )
+				{
+				uint8_t present;
+
+				if ( ! ReadByte(&present) )
+					return nullptr;
+
+				if ( ! present )
+					{
+					rval->Remove(i);
+					continue;
+					}
+
+				auto field = ReadVal(rt->GetFieldType(i).get());
+
+				if ( ! field )
+					return nullptr;
+
+				rval->Assign(i, std::move(field));
+				}
+
+			return rval;
+			}
+
+		case TYPE_VECTOR:
+			{
+			auto vt = t->AsVectorType();
+			uint64_t size;
+
+			// Each element takes at least a byte.
+			if ( ! ReadCount(&size) || size > static_cast<uint64_t>(end - p) )
+				return nullptr;
+
+			auto rval = make_intrusive<VectorVal>(IntrusivePtr{NewRef{}, vt});
+
+			for ( uint64_t i = 0; i < size; ++i )
+				{
+				uint8_t present;
+
+				if ( ! ReadByte(&present) )
+					return nullptr;
+
+				if ( ! present )
+					continue;
+
+				auto item = ReadVal(vt->Yield().get());
+
+				if ( ! item )
+					return nullptr;
+
+				rval->Assign(i, std::move(item));
+				}
+
+			return rval;
+			}
+
+		case TYPE_TABLE:
+			{
+			auto tt = t->AsTableType();
+			const auto& index_types = tt->GetIndexTypes();
+			const auto& yield = tt->Yield();
+			uint64_t size;
+
+			if ( ! ReadCount(&size) || size > static_cast<uint64_t>(end - p) )
+				return nullptr;
+
+			auto rval = make_intrusive<TableVal>(IntrusivePtr{NewRef{}, tt});
+
+			for ( uint64_t i = 0; i < size; ++i )
+				{
+				auto index = make_intrusive<ListVal>(TYPE_ANY);
+
+				for ( const auto& it : index_types )
+					{
+					auto index_val = ReadVal(it.get());
+
+					if ( ! index_val )
+						return nullptr;
+
+					index->Append(std::move(index_val));
+					}
+
+				ValPtr value;
+
+				if ( yield )
+					{
+					value = ReadVal(yield.get());
+
+					if ( ! value )
+						return nullptr;
+					}
+
+				rval->Assign(std::move(index), std::move(value));
+				}
+
+			return rval;
+			}
+
+		default:
+			return nullptr;
+		}
+	}
+
+	} // namespace
+
+bool CompactEventWriter::Append(std::string_view name, const std::vector<TypePtr>& types,
+                                const Args& args)
+	{
+	if ( types.size() != args.size() )
+		return false;
+
+	auto start = buf.size();
+	write_bytes(&buf, name.data(), name.size());
+
+	// The arguments' length has a fixed size, so that it can be filled in
+	// once they're encoded.
+	auto len_start = buf.size();
+	buf.append(4, '\0');
+	write_count(&buf, args.size());
+
+	for ( size_t i = 0; i < args.size(); ++i )
+		{
+		if ( ! write_val(&buf, args[i].get(), types[i].get()) )
+			{
+			buf.resize(start);
+			return false;
+			}
+		}
+
+	auto len = buf.size() - len_start - 4;
+
+	if ( len > UINT32_MAX )
+		{
+		buf.resize(start);
+		return false;
+		}
+
+	for ( int i = 0; i < 4; ++i )
+		buf[len_start + i] = static_cast<char>(len >> (8 * i));
+
+	++count;
+	return true;
+	}
+
+std::string CompactEventWriter::Take()
+	{
+	std::string rval;
+	rval.reserve(buf.capacity());
+	rval.swap(buf);
+	count = 0;
+	return rval;
+	}
+
+bool CompactEventReader::Next()
+	{
+	if ( data.empty() )
+		return false;
+
+	Decoder d(data);
+	std::string_view n;
+	uint32_t len;
+
+	if ( ! d.ReadBytes(&n) || ! d.ReadLength(&len) ||
+	     len > data.size() - (n.data() + n.size() + 4 - data.data()) )
+		{
+		failed = true;
+		data = {};
+		return false;
+		}
+
+	name = n;
+	body = {n.data() + n.size() + 4, len};
+	data.remove_prefix(body.data() + body.size() - data.data());
+	return true;
+	}
+
+std::optional<Args> CompactEventReader::DecodeArgs(const std::vector<TypePtr>& types) const
+	{
+	Decoder d(body);
+	uint64_t num_args;
+
+	if ( ! d.ReadCount(&num_args) || num_args != types.size() )
+		return std::nullopt;
+
+	Args rval;
+	rval.reserve(num_args);
+
+	for ( const auto& t : types )
+		{
+		auto v = d.ReadVal(t.get());
+
+		if ( ! v )
+			return std::nullopt;
+
+		rval.emplace_back(std::move(v));
+		}
+
+	if ( ! d.AtEnd() )
+		return std::nullopt;
+
+	return rval;
+	}
+
+	} // namespace zeek::Broker::detail
+
+TEST_SUITE_BEGIN("CompactEvents");
+
+namespace
+	{
+
+using namespace zeek;
+using namespace zeek::Broker::detail;
+
+std::string describe(const ValPtr& v)
+	{
+	ODesc d;
+	v->Describe(&d);
+	return d.Description();
+	}
+
+std::string encode(std::string_view name, const std::vector<TypePtr>& types, const Args& args)
+	{
+	CompactEventWriter w;
+	REQUIRE(w.Append(name, types, args));
+	CHECK_EQ(w.Count(), 1);
+	return w.Take();
+	}
+
+std::optional<Args> decode(std::string_view data, const std::vector<TypePtr>& types)
+	{
+	CompactEventReader r(data);
+
+	if ( ! r.Next() )
+		return std::nullopt;
+
+	return r.DecodeArgs(types);
+	}
+
+	} // namespace
+
+TEST_CASE("compact events atomic round-trip")
+	{
+	std::vector<TypePtr> types = {
+		base_type(TYPE_BOOL),   base_type(TYPE_INT),    base_type(TYPE_INT),
+		base_type(TYPE_COUNT),  base_type(TYPE_DOUBLE), base_type(TYPE_TIME),
+		base_type(TYPE_INTERVAL), base_type(TYPE_STRING), base_type(TYPE_ADDR),
+		base_type(TYPE_ADDR),   base_type(TYPE_SUBNET), base_type(TYPE_PORT),
+	};
+
+	Args args = {
+		val_mgr->True(),
+		val_mgr->Int(-42),
+		val_mgr->Int(INT64_MIN),
+		val_mgr->Count(UINT64_MAX),
+		make_intrusive<DoubleVal>(-0.125),
+		make_intrusive<TimeVal>(1600000000.5),
+		make_intrusive<IntervalVal>(2.5),
+		make_intrusive<StringVal>(3, "a\0b"),
+		make_intrusive<AddrVal>("192.168.1.1"),
+		make_intrusive<AddrVal>("2001:db8::1"),
+		make_intrusive<SubNetVal>(IPPrefix(IPAddr("10.0.0.0"), 8)),
+		val_mgr->Port(53, TRANSPORT_UDP),
+	};
+
+	auto data = encode("test", types, args);
+	CompactEventReader r(data);
+	REQUIRE(r.Next());
+	CHECK_EQ(r.Name(), "test");
+
+	auto decoded = r.DecodeArgs(types);
+	REQUIRE(decoded);
+	REQUIRE_EQ(decoded->size(), args.size());
+
+	for ( size_t i = 0; i < args.size(); ++i )
+		{
+		CHECK_EQ((*decoded)[i]->GetType()->Tag(), types[i]->Tag());
+		CHECK_EQ(describe((*decoded)[i]), describe(args[i]));
+		}
+
+	CHECK_EQ((*decoded)[2]->AsInt(), INT64_MIN);
+	CHECK_EQ((*decoded)[3]->AsCount(), UINT64_MAX);
+	CHECK_EQ((*decoded)[7]->AsString()->Len(), 3);
+
+	CHECK_FALSE(r.Next());
+	CHECK_FALSE(r.Failed());
+	}
+
+TEST_CASE("compact events enum round-trip")
+	{
+	auto et = make_intrusive<EnumType>("CompactEventsTest::color");
+	et->AddName("CompactEventsTest", "RED", true);
+	et->AddName("CompactEventsTest", "GREEN", true);
+
+	std::vector<TypePtr> types = {et};
+	Args args = {et->GetEnumVal(et->Lookup("CompactEventsTest", "GREEN"))};
+
+	auto decoded = decode(encode("test", types, args), types);
+	REQUIRE(decoded);
+	CHECK_EQ((*decoded)[0]->AsEnum(), args[0]->AsEnum());
+
+	// Enums travel by name, so unknown names don't decode.
+	auto other = make_intrusive<EnumType>("CompactEventsTest::other");
+	other->AddName("CompactEventsTest", "BLUE", true);
+	CHECK_FALSE(decode(encode("test", types, args), {other}));
+	}
+
+TEST_CASE("compact events container round-trip")
+	{
+	auto decls = new type_decl_list();
+	decls->push_back(new TypeDecl(util::copy_string("a"), base_type(TYPE_COUNT)));
+	decls->push_back(new TypeDecl(util::copy_string("b"), base_type(TYPE_STRING)));
+	auto rt = make_intrusive<RecordType>(decls);
+
+	auto vt = make_intrusive<VectorType>(base_type(TYPE_COUNT));
+
+	auto index = make_intrusive<TypeList>();
+	index->AppendEvenIfNotPure(base_type(TYPE_COUNT));
+	index->AppendEvenIfNotPure(base_type(TYPE_STRING));
+	auto tt = make_intrusive<TableType>(std::move(index), base_type(TYPE_ADDR));
+
+	auto set_index = make_intrusive<TypeList>(base_type(TYPE_PORT));
+	set_index->Append(base_type(TYPE_PORT));
+	auto st = make_intrusive<SetType>(std::move(set_index), nullptr);
+
+	// Leaves the record's second field unset.
+	auto rec = make_intrusive<RecordVal>(rt);
+	rec->Assign(0, val_mgr->Count(7));
+
+	// Leaves a hole at the vector's second index.
+	auto vec = make_intrusive<VectorVal>(vt);
+	vec->Assign(0, val_mgr->Count(1));
+	vec->Assign(2, val_mgr->Count(3));
+
+	auto make_index = [](bro_uint_t n, const char* s)
+		{
+		auto rval = make_intrusive<ListVal>(TYPE_ANY);
+		rval->Append(val_mgr->Count(n));
+		rval->Append(make_intrusive<StringVal>(s));
+		return rval;
+		};
+
+	auto tbl = make_intrusive<TableVal>(tt);
+	tbl->Assign(make_index(1, "one"), make_intrusive<AddrVal>("1.1.1.1"));
+	tbl->Assign(make_index(2, "two"), make_intrusive<AddrVal>("2.2.2.2"));
+
+	auto set = make_intrusive<TableVal>(st);
+	set->Assign(val_mgr->Port(80, TRANSPORT_TCP), nullptr);
+	set->Assign(val_mgr->Port(53, TRANSPORT_UDP), nullptr);
+
+	std::vector<TypePtr> types = {rt, vt, tt, st};
+	Args args = {rec, vec, tbl, set};
+
+	auto decoded = decode(encode("test", types, args), types);
+	REQUIRE(decoded);
+
+	auto drec = (*decoded)[0]->AsRecordVal();
+	CHECK_EQ(drec->GetField(0)->AsCount(), 7);
+	CHECK_FALSE(drec->HasField(1));
+
+	auto dvec = (*decoded)[1]->AsVectorVal();
+	REQUIRE_EQ(dvec->Size(), 3);
+	CHECK_EQ(dvec->ValAt(0)->AsCount(), 1);
+	CHECK_FALSE(dvec->ValAt(1));
+	CHECK_EQ(dvec->ValAt(2)->AsCount(), 3);
+
+	auto dtbl = cast_intrusive<TableVal>((*decoded)[2]);
+	CHECK_EQ(dtbl->Size(), 2);
+	CHECK_EQ(describe(dtbl->FindOrDefault(make_index(1, "one"))), "1.1.1.1");
+	CHECK_EQ(describe(dtbl->FindOrDefault(make_index(2, "two"))), "2.2.2.2");
+	CHECK_FALSE(dtbl->FindOrDefault(make_index(3, "three")));
+
+	auto dset = cast_intrusive<TableVal>((*decoded)[3]);
+	CHECK_EQ(dset->Size(), 2);
+	CHECK(dset->FindOrDefault(val_mgr->Port(80, TRANSPORT_TCP)));
+	CHECK(dset->FindOrDefault(val_mgr->Port(53, TRANSPORT_UDP)));
+	}
+
+TEST_CASE("compact events multiple events and unsupported types")
+	{
+	std::vector<TypePtr> count_types = {base_type(TYPE_COUNT)};
+	std::vector<TypePtr> string_types = {base_type(TYPE_STRING)};
+
+	CompactEventWriter w;
+	CHECK(w.Append("first", count_types, {val_mgr->Count(1)}));
+	CHECK(w.Append("second", string_types, {make_intrusive<StringVal>("two")}));
+
+	// Arguments without a fixed type leave the buffer as it was.
+	CHECK_FALSE(w.Append("third", {base_type(TYPE_ANY)}, {val_mgr->Count(3)}));
+	CHECK_FALSE(w.Append("fourth", count_types, {}));
+	CHECK_EQ(w.Count(), 2);
+
+	auto data = w.Take();
+	CHECK_EQ(w.Count(), 0);
+
+	CompactEventReader r(data);
+	REQUIRE(r.Next());
+	CHECK_EQ(r.Name(), "first");
+
+	// Skips over the first event's arguments without decoding them.
+	REQUIRE(r.Next());
+	CHECK_EQ(r.Name(), "second");
+
+	// Arguments that don't match the receiver's declaration don't decode.
+	CHECK_FALSE(r.DecodeArgs(count_types));
+	CHECK_FALSE(r.DecodeArgs({}));
+	auto args = r.DecodeArgs(string_types);
+	REQUIRE(args);
+	CHECK_EQ(describe((*args)[0]), "two");
+
+	CHECK_FALSE(r.Next());
+	CHECK_FALSE(r.Failed());
+	}
+
+TEST_CASE("compact events truncated input")
+	{
+	auto vt = make_intrusive<VectorType>(base_type(TYPE_STRING));
+	auto vec = make_intrusive<VectorVal>(vt);
+	vec->Assign(0, make_intrusive<StringVal>("abc"));
+	vec->Assign(1, make_intrusive<StringVal>("defgh"));
+
+	std::vector<TypePtr> types = {base_type(TYPE_ADDR), vt, base_type(TYPE_DOUBLE)};
+	Args args = {make_intrusive<AddrVal>("2001:db8::1"), vec, make_intrusive<DoubleVal>(1.5)};
+	auto data = encode("test", types, args);
+
+	// Every prefix of the encoding is either rejected as a whole or fails
+	// to decode, without reading past its end.
+	for ( size_t len = 0; len < data.size(); ++len )
+		{
+		std::string truncated(data, 0, len);
+		CompactEventReader r(truncated);
+
+		if ( r.Next() )
+			CHECK_FALSE(r.DecodeArgs(types));
+		else
+			CHECK_EQ(r.Failed(), len > 0);
+		}
+
+	// Same for prefixes of the arguments with their length adjusted, which
+	// runs into the end while decoding them.
+	const size_t header_len = 1 + 4 + 4;
+
+	for ( size_t len = 0; len < data.size() - header_len; ++len )
+		{
+		std::string truncated(data, 0, header_len + len);
+
+		for ( int i = 0; i < 4; ++i )
+			truncated[5 + i] = static_cast<char>(len >> (8 * i));
+
+		CHECK_FALSE(decode(truncated, types));
+		}
+
+	CHECK(decode(data, types));
+	}
+
+TEST_CASE("compact events malformed input")
+	{
+	std::vector<TypePtr> count_types = {base_type(TYPE_COUNT)};
+	auto data = encode("test", count_types, {val_mgr->Count(1)});
+
+	SUBCASE("argument length beyond the end")
+		{
+		// The name is "test", prefixed with its length.
+		data[5] = static_cast<char>(0xff);
+		CompactEventReader r(data);
+		CHECK_FALSE(r.Next());
+		CHECK(r.Failed());
+		}
+
+	SUBCASE("name length beyond the end")
+		{
+		data[0] = 0x7f;
+		CompactEventReader r(data);
+		CHECK_FALSE(r.Next());
+		CHECK(r.Failed());
+		}
+
+	SUBCASE("trailing bytes in arguments")
+		{
+		auto padded = encode("test", count_types, {val_mgr->Count(1)});
+		padded[5] += 1;
+		padded.push_back('\0');
+		CHECK_FALSE(decode(padded, count_types));
+		}
+
+	SUBCASE("overlong count")
+		{
+		std::string bad = "\x04test";
+		std::string body = "\x01" + std::string(10, '\xff') + "\x01";
+		bad.push_back(static_cast<char>(body.size()));
+		bad.append(3, '\0');
+		bad += body;
+		CHECK_FALSE(decode(bad, count_types));
+		}
+
+	SUBCASE("invalid values")
+		{
+		auto check_invalid = [](const TypePtr& t, std::string value)
+			{
+			std::string bad = "\x04test";
+			std::string body = "\x01" + value;
+			bad.push_back(static_cast<char>(body.size()));
+			bad.append(3, '\0');
+			bad += body;
+			CHECK_FALSE(decode(bad, {t}));
+			};
+
+		// Address with neither 1 nor 4 words.
+		check_invalid(base_type(TYPE_ADDR), std::string("\x02") + std::string(8, '\0'));
+		// IPv4 subnet with a prefix longer than 32 bits.
+		check_invalid(base_type(TYPE_SUBNET), std::string("\x01\x0a\0\0\0\x21", 6));
+		// Port number beyond 16 bits, and an unknown protocol.
+		check_invalid(base_type(TYPE_PORT), "\x80\x80\x04\x01");
+		check_invalid(base_type(TYPE_PORT), std::string("\x35\x07"));
+		// Vector claiming more elements than there are bytes.
+		check_invalid(make_intrusive<VectorType>(base_type(TYPE_COUNT)), "\x7f\x01\x01");
+		}
+	}
+
+TEST_SUITE_END();
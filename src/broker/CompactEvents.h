@@ -0,0 +1,106 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "zeek/IntrusivePtr.h"
+#include "zeek/ZeekArgs.h"
+
+namespace zeek
+	{
+
+class Type;
+using TypePtr = IntrusivePtr<Type>;
+
+namespace Broker::detail
+	{
+
+/**
+ * The name of the event message carrying compactly encoded events. Its
+ * only argument is a string with the encoded events.
+ */
+constexpr const char* COMPACT_EVENTS_NAME = "Broker::__compact_events";
+
+/**
+ * Encodes events into a compact binary format, writing their arguments
+ * directly into a buffer rather than converting them to Broker data first.
+ * The encoding leaves out type information, so the receiver decodes the
+ * arguments according to its declaration of the event.
+ *
+ * Each event is encoded as its name, followed by the length of its
+ * encoded arguments, so that receivers can skip events they don't handle.
+ */
+class CompactEventWriter
+	{
+public:
+	/**
+	 * Appends an event to the buffer.
+	 * @param name the event's name.
+	 * @param types the event's parameter types.
+	 * @param args the event's arguments, matching *types*.
+	 * @return false if the arguments include a type that the encoding
+	 * doesn't support, in which case the buffer remains unchanged.
+	 */
+	bool Append(std::string_view name, const std::vector<TypePtr>& types, const Args& args);
+
+	/**
+	 * @return the number of events in the buffer.
+	 */
+	size_t Count() const { return count; }
+
+	/**
+	 * Hands out the encoded events and resets the buffer, which keeps
+	 * its capacity for the next batch of events.
+	 */
+	std::string Take();
+
+private:
+	std::string buf;
+	size_t count = 0;
+	};
+
+/**
+ * Decodes events written by CompactEventWriter, one at a time.
+ */
+class CompactEventReader
+	{
+public:
+	explicit CompactEventReader(std::string_view data) : data(data) { }
+
+	/**
+	 * Moves to the next event.
+	 * @return false at the end of the data or if it's malformed, see
+	 * Failed().
+	 */
+	bool Next();
+
+	/**
+	 * @return the name of the current event.
+	 */
+	std::string_view Name() const { return name; }
+
+	/**
+	 * Decodes the arguments of the current event.
+	 * @param types the event's parameter types.
+	 * @return the arguments, or nothing if they don't match the types.
+	 */
+	std::optional<Args> DecodeArgs(const std::vector<TypePtr>& types) const;
+
+	/**
+	 * @return true if Next() stopped because of malformed data.
+	 */
+	bool Failed() const { return failed; }
+
+private:
+	std::string_view data;
+	std::string_view name;
+	std::string_view body;
+	bool failed = false;
+	};
+
+	} // namespace Broker::detail
+	} // namespace zeek
@@ -10,6 +10,7 @@
 #include "zeek/DebugLogger.h"
 #include "zeek/Desc.h"
 #include "zeek/Func.h"
+#include "zeek/Hash.h"
 #include "zeek/IntrusivePtr.h"
 #include "zeek/Reporter.h"
 #include "zeek/RunState.h"
@@ -241,6 +242,8 @@ Manager::Manager(bool arg_use_real_time)
 	use_real_time = arg_use_real_time;
 	peer_count = 0;
 	log_batch_size = 0;
+	event_batch_size = 0;
+	compact_event_encoding = false;
 	log_topic_func = nullptr;
 	log_id_type = nullptr;
 	writer_id_type = nullptr;
@@ -253,6 +256,8 @@ void Manager::InitPostScript()
 	DBG_LOG(DBG_BROKER, "Initializing");
 
 	log_batch_size = get_option("Broker::log_batch_size")->AsCount();
+	event_batch_size = get_option("Broker::event_batch_size")->AsCount();
+	compact_event_encoding = get_option("Broker::compact_event_encoding")->AsBool();
 	default_log_topic_prefix =
 		get_option("Broker::default_log_topic_prefix")->AsString()->CheckString();
 	log_topic_func = get_option("Broker::log_topic")->AsFunc();
@@ -261,6 +266,13 @@ void Manager::InitPostScript()
 	zeek_table_manager = get_option("Broker::table_store_master")->AsBool();
 	zeek_table_db_directory =
 		get_option("Broker::table_store_db_directory")->AsString()->CheckString();
+	table_store_shards = get_option("Broker::table_store_shards")->AsCount();
+
+	if ( table_store_shards == 0 )
+		table_store_shards = 1;
+
+	coalesce_table_store_writes =
+		get_option("Broker::table_store_coalescing_interval")->AsInterval() > 0;
 
 	detail::opaque_of_data_type = make_intrusive<OpaqueType>("Broker::Data");
 	detail::opaque_of_set_iterator = make_intrusive<OpaqueType>("Broker::SetIterator");
@@ -427,8 +439,26 @@ void Manager::InitializeBrokerStoreForwarding()
 			auto e = static_cast<BifEnum::Broker::BackendType>(
 				attr->GetExpr()->Eval(nullptr)->AsEnum());
 			auto storename = std::string("___sync_store_") + global.first;
-			id->GetVal()->AsTableVal()->SetBrokerStore(storename);
-			AddForwardedStore(storename, cast_intrusive<TableVal>(id->GetVal()));
+			auto table = cast_intrusive<TableVal>(id->GetVal());
+			table->SetBrokerStore(storename);
+
+			// A table split into shards has a store per shard, all of which
+			// forward to the table.
+			std::vector<std::string> shards;
+
+			if ( table_store_shards > 1 )
+				for ( size_t i = 0; i < table_store_shards; ++i )
+					shards.emplace_back(util::fmt("%s_shard%zu", storename.c_str(), i));
+			else
+				shards.emplace_back(storename);
+
+			for ( const auto& shard : shards )
+				AddForwardedStore(shard, table);
+
+			auto backend = detail::to_backend_type(e);
+			table_store_backends.emplace(storename, backend);
+			auto& shard_names = table_store_shard_names[storename];
+			shard_names = std::move(shards);
 
 			// We only create masters here. For clones, we do all the work of setting up
 			// the forwarding - but we do not try to initialize the clone. We can only initialize
@@ -438,23 +468,29 @@ void Manager::InitializeBrokerStoreForwarding()
 			if ( ! zeek_table_manager )
 				continue;
 
-			auto backend = detail::to_backend_type(e);
-			auto suffix = ".store";
-
-			switch ( backend )
-				{
-				case broker::backend::sqlite:
-					suffix = ".sqlite";
-					break;
-				default:
-					break;
-				}
+			for ( const auto& shard : shard_names )
+				MakeTableStoreMaster(shard, backend);
+			}
+		}
+	}
 
-			auto path = zeek_table_db_directory + "/" + storename + suffix;
+detail::StoreHandleVal* Manager::MakeTableStoreMaster(const std::string& name,
+                                                      broker::backend backend)
+	{
+	auto suffix = ".store";
 
-			MakeMaster(storename, backend, broker::backend_options{{"path", path}});
-			}
+	switch ( backend )
+		{
+		case broker::backend::sqlite:
+			suffix = ".sqlite";
+			break;
+		default:
+			break;
 		}
+
+	auto path = zeek_table_db_directory + "/" + name + suffix;
+
+	return MakeMaster(name, backend, broker::backend_options{{"path", path}});
 	}
 
 void Manager::Terminate()
@@ -609,8 +645,51 @@ bool Manager::PublishEvent(string topic, std::string name, broker::vector args)
 
 	DBG_LOG(DBG_BROKER, "Publishing event: %s", RenderEvent(topic, name, args).c_str());
 	broker::zeek::Event ev(std::move(name), std::move(args));
-	bstate->endpoint.publish(move(topic), ev.move_data());
-	++statistics.num_events_outgoing;
+
+	if ( ! event_batch_size )
+		{
+		bstate->endpoint.publish(move(topic), ev.move_data());
+		++statistics.num_events_outgoing;
+		return true;
+		}
+
+	auto& eb = event_buffers[topic];
+	eb.SealCompact();
+	eb.msgs.emplace_back(ev.move_data());
+	++eb.message_count;
+
+	if ( eb.message_count >= event_batch_size )
+		statistics.num_events_outgoing += eb.Flush(bstate->endpoint, topic);
+
+	return true;
+	}
+
+bool Manager::PublishCompactEvent(const std::string& topic, std::string_view name,
+                                  const std::vector<TypePtr>& types, const Args& args)
+	{
+	if ( ! compact_event_encoding )
+		return false;
+
+	if ( bstate->endpoint.is_shutdown() )
+		return true;
+
+	if ( peer_count == 0 )
+		return true;
+
+	auto& eb = event_buffers[topic];
+
+	if ( ! eb.compact.Append(name, types, args) )
+		return false;
+
+	DBG_LOG(DBG_BROKER, "Publishing compact event: %s %s", topic.c_str(),
+	        std::string(name).c_str());
+	++eb.message_count;
+
+	// Without batching, this flushes right away but still reuses the
+	// topic's encoding buffer.
+	if ( eb.message_count >= event_batch_size )
+		statistics.num_events_outgoing += eb.Flush(bstate->endpoint, topic);
+
 	return true;
 	}
 
@@ -669,6 +748,10 @@ bool Manager::PublishIdentifier(std::string topic, std::string id)
 		return false;
 		}
 
+	// Keeps the update in order with events buffered for the same topic.
+	if ( auto it = event_buffers.find(topic); it != event_buffers.end() )
+		statistics.num_events_outgoing += it->second.Flush(bstate->endpoint, topic);
+
 	broker::zeek::IdentifierUpdate msg(move(id), move(*data));
 	DBG_LOG(DBG_BROKER, "Publishing id-update: %s", RenderMessage(topic, msg.as_data()).c_str());
 	bstate->endpoint.publish(move(topic), msg.move_data());
@@ -722,6 +805,9 @@ bool Manager::PublishLogCreate(EnumVal* stream, EnumVal* writer,
 
 	DBG_LOG(DBG_BROKER, "Publishing log creation: %s", RenderMessage(topic, msg.as_data()).c_str());
 
+	// Buffered events were published first, so they go out first.
+	FlushEventBuffers();
+
 	if ( peer.node != NoPeer.node )
 		// Direct message.
 		bstate->endpoint.publish(peer, move(topic), msg.move_data());
@@ -815,7 +901,10 @@ bool Manager::PublishLogWrite(EnumVal* stream, EnumVal* writer, string path, int
 	pending_batch.emplace_back(msg.move_data());
 
 	if ( lb.message_count >= log_batch_size )
+		{
+		FlushEventBuffers();
 		statistics.num_logs_outgoing += lb.Flush(bstate->endpoint, log_batch_size);
+		}
 
 	return true;
 	}
@@ -850,6 +939,10 @@ size_t Manager::FlushLogBuffers()
 	DBG_LOG(DBG_BROKER, "Flushing all log buffers");
 	auto rval = 0u;
 
+	// Events published before the log writes need to arrive before them,
+	// too.
+	FlushEventBuffers();
+
 	for ( auto& lb : log_buffers )
 		rval += lb.Flush(bstate->endpoint, log_batch_size);
 
@@ -857,6 +950,64 @@ size_t Manager::FlushLogBuffers()
 	return rval;
 	}
 
+void Manager::EventBuffer::SealCompact()
+	{
+	if ( ! compact.Count() )
+		return;
+
+	broker::zeek::Event ev(detail::COMPACT_EVENTS_NAME, broker::vector{compact.Take()});
+	msgs.emplace_back(ev.move_data());
+	}
+
+size_t Manager::EventBuffer::Flush(broker::endpoint& endpoint, const std::string& topic)
+	{
+	if ( endpoint.is_shutdown() )
+		return 0;
+
+	if ( ! message_count )
+		return 0;
+
+	SealCompact();
+
+	if ( msgs.size() == 1 )
+		endpoint.publish(topic, std::move(msgs[0]));
+	else
+		{
+		broker::zeek::Batch msg(std::move(msgs));
+		endpoint.publish(topic, msg.move_data());
+		}
+
+	msgs.clear();
+	auto rval = message_count;
+	message_count = 0;
+	return rval;
+	}
+
+size_t Manager::FlushEventBuffers()
+	{
+	auto rval = 0u;
+
+	for ( auto& [topic, eb] : event_buffers )
+		rval += eb.Flush(bstate->endpoint, topic);
+
+	if ( rval )
+		DBG_LOG(DBG_BROKER, "Flushed %zu buffered events", static_cast<size_t>(rval));
+
+	statistics.num_events_outgoing += rval;
+	return rval;
+	}
+
+size_t Manager::FlushStoreWrites()
+	{
+	DBG_LOG(DBG_BROKER, "Flushing coalesced store writes");
+	size_t rval = 0;
+
+	for ( auto& [name, handle] : data_stores )
+		rval += handle->FlushWrites();
+
+	return rval;
+	}
+
 void Manager::Error(const char* format, ...)
 	{
 	va_list args;
@@ -1106,6 +1257,7 @@ void Manager::Process()
 	auto messages = bstate->subscriber.poll();
 
 	bool had_input = ! messages.empty();
+	std::vector<broker::data> store_events;
 
 	for ( auto& message : messages )
 		{
@@ -1141,7 +1293,7 @@ void Manager::Process()
 
 		if ( broker::is_prefix(topic, broker::topic::store_events_str) )
 			{
-			ProcessStoreEvent(broker::move_data(message));
+			store_events.emplace_back(broker::move_data(message));
 			continue;
 			}
 
@@ -1162,6 +1314,12 @@ void Manager::Process()
 			}
 		}
 
+	// Event handlers only run once the event queue drains, so applying
+	// store changes after dispatching the other messages doesn't change what
+	// they see.
+	if ( ! store_events.empty() )
+		ProcessStoreEvents(std::move(store_events));
+
 	for ( auto& s : data_stores )
 		{
 		auto num_available = s.second->proxy.mailbox().size();
@@ -1249,6 +1407,62 @@ void Manager::ProcessStoreEventInsertUpdate(const TableValPtr& table, const std:
 	table->Assign(zeek_key, zeek_value, false);
 	}
 
+void Manager::ProcessStoreEvents(std::vector<broker::data> msgs)
+	{
+	// Of several changes to the same key, only the last one matters for the
+	// table, so the others don't need converting and applying. Tables with
+	// &on_change get all of them, so that the notifications don't change.
+	std::vector<bool> skip(msgs.size());
+
+	if ( msgs.size() > 1 )
+		{
+		// Indexed by store ID and then by key.
+		std::unordered_map<std::string, std::unordered_map<broker::data, size_t>> latest;
+
+		for ( size_t i = 0; i < msgs.size(); ++i )
+			{
+			const std::string* store_id;
+			const broker::data* key;
+
+			if ( auto insert = broker::store_event::insert::make(msgs[i]) )
+				{
+				store_id = &insert.store_id();
+				key = &insert.key();
+				}
+			else if ( auto update = broker::store_event::update::make(msgs[i]) )
+				{
+				store_id = &update.store_id();
+				key = &update.key();
+				}
+			else if ( auto erase = broker::store_event::erase::make(msgs[i]) )
+				{
+				store_id = &erase.store_id();
+				key = &erase.key();
+				}
+			else
+				continue;
+
+			auto handle = LookupStore(*store_id);
+
+			if ( ! handle || ! handle->forward_to ||
+			     handle->forward_to->HasChangeNotifications() )
+				continue;
+
+			auto [it, inserted] = latest[*store_id].emplace(*key, i);
+
+			if ( ! inserted )
+				{
+				skip[it->second] = true;
+				it->second = i;
+				}
+			}
+		}
+
+	for ( size_t i = 0; i < msgs.size(); ++i )
+		if ( ! skip[i] )
+			ProcessStoreEvent(std::move(msgs[i]));
+	}
+
 void Manager::ProcessStoreEvent(broker::data msg)
 	{
 	if ( auto insert = broker::store_event::insert::make(msg) )
@@ -1352,6 +1566,12 @@ void Manager::ProcessEvent(const broker::topic& topic, broker::zeek::Event ev)
 	auto name = std::move(ev.name());
 	auto args = std::move(ev.args());
 
+	if ( name == detail::COMPACT_EVENTS_NAME )
+		{
+		ProcessCompactEvents(topic, std::move(args));
+		return;
+		}
+
 	DBG_LOG(DBG_BROKER, "Process event: %s %s", name.data(), RenderMessage(args).data());
 	++statistics.num_events_incoming;
 	auto handler = event_registry->Lookup(name);
@@ -1359,16 +1579,8 @@ void Manager::ProcessEvent(const broker::topic& topic, broker::zeek::Event ev)
 	if ( ! handler )
 		return;
 
-	auto& topic_string = topic.string();
-
-	for ( const auto& p : forwarded_prefixes )
+	if ( IsForwarded(topic.string()) )
 		{
-		if ( p.size() > topic_string.size() )
-			continue;
-
-		if ( strncmp(p.data(), topic_string.data(), p.size()) != 0 )
-			continue;
-
 		DBG_LOG(DBG_BROKER, "Skip processing of forwarded event: %s %s", name.data(),
 		        RenderMessage(args).data());
 		return;
@@ -1419,6 +1631,64 @@ void Manager::ProcessEvent(const broker::topic& topic, broker::zeek::Event ev)
 		event_mgr.Enqueue(handler, std::move(vl), util::detail::SOURCE_BROKER);
 	}
 
+void Manager::ProcessCompactEvents(const broker::topic& topic, broker::vector args)
+	{
+	auto data = args.size() == 1 ? get_if<std::string>(&args[0]) : nullptr;
+
+	if ( ! data )
+		{
+		reporter->Warning("received invalid compact broker events: %s",
+		                  RenderMessage(args).data());
+		return;
+		}
+
+	if ( IsForwarded(topic.string()) )
+		{
+		DBG_LOG(DBG_BROKER, "Skip processing of forwarded compact events");
+		return;
+		}
+
+	detail::CompactEventReader reader(*data);
+
+	while ( reader.Next() )
+		{
+		++statistics.num_events_incoming;
+		auto handler = event_registry->Lookup(reader.Name());
+
+		if ( ! handler )
+			continue;
+
+		DBG_LOG(DBG_BROKER, "Process compact event: %s", handler->Name());
+		const auto& arg_types = handler->GetType(false)->ParamList()->GetTypes();
+		auto vl = reader.DecodeArgs(arg_types);
+
+		if ( ! vl )
+			{
+			reporter->Warning("failed to decode compact remote event '%s'", handler->Name());
+			continue;
+			}
+
+		event_mgr.Enqueue(handler, std::move(*vl), util::detail::SOURCE_BROKER);
+		}
+
+	if ( reader.Failed() )
+		reporter->Warning("received malformed compact broker events");
+	}
+
+bool Manager::IsForwarded(const std::string& topic) const
+	{
+	for ( const auto& p : forwarded_prefixes )
+		{
+		if ( p.size() > topic.size() )
+			continue;
+
+		if ( strncmp(p.data(), topic.data(), p.size()) == 0 )
+			return true;
+		}
+
+	return false;
+	}
+
 bool Manager::ProcessLogCreate(broker::zeek::LogCreate lc)
 	{
 	DBG_LOG(DBG_BROKER, "Received log-create: %s", RenderMessage(lc.as_data()).c_str());
@@ -1932,6 +2202,55 @@ detail::StoreHandleVal* Manager::LookupStore(const string& name)
 	return i == data_stores.end() ? nullptr : i->second;
 	}
 
+detail::StoreHandleVal* Manager::LookupTableStore(const string& name, const broker::data& key)
+	{
+	if ( table_store_shards <= 1 )
+		return LookupStore(name);
+
+	auto i = table_store_shard_names.find(name);
+
+	// Tables with &broker_store don't get split.
+	if ( i == table_store_shard_names.end() )
+		return LookupStore(name);
+
+	// All nodes need to agree on the shard, so this uses the hash that's
+	// stable across the cluster, over the key's rendering, which doesn't
+	// depend on how Broker or the standard library hash it.
+	const auto& shards = i->second;
+	auto rendered = broker::to_string(key);
+	auto hash = zeek::detail::KeyedHash::StaticHash64(rendered.data(), rendered.size());
+	return LookupStore(shards[hash % shards.size()]);
+	}
+
+std::vector<std::string> Manager::TableStoreShards(const string& name) const
+	{
+	auto i = table_store_shard_names.find(name);
+
+	if ( i == table_store_shard_names.end() )
+		return {name};
+
+	return i->second;
+	}
+
+std::vector<std::string> Manager::MakeTableStoreMasters(size_t owner, size_t num_owners)
+	{
+	std::vector<std::string> rval;
+
+	if ( num_owners == 0 || owner >= num_owners )
+		return rval;
+
+	for ( const auto& [name, shards] : table_store_shard_names )
+		{
+		auto backend = table_store_backends.at(name);
+
+		for ( size_t i = owner; i < shards.size(); i += num_owners )
+			if ( MakeTableStoreMaster(shards[i], backend) )
+				rval.emplace_back(shards[i]);
+		}
+
+	return rval;
+	}
+
 bool Manager::CloseStore(const string& name)
 	{
 	DBG_LOG(DBG_BROKER, "Closing data store %s", name.c_str());
@@ -1954,6 +2273,7 @@ bool Manager::CloseStore(const string& name)
 			++i;
 			}
 
+	s->second->FlushWrites();
 	s->second->have_store = false;
 	s->second->store_pid = {};
 	s->second->proxy = {};
@@ -2012,6 +2332,7 @@ void Manager::PrepareForwarding(const std::string& name)
 		return;
 
 	handle->forward_to = forwarded_stores.at(name);
+	handle->coalesce_writes = coalesce_table_store_writes;
 	DBG_LOG(DBG_BROKER, "Resolved table forward for data store %s", name.c_str());
 	}
 
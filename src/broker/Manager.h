@@ -15,9 +15,12 @@
 #include <broker/zeek.hh>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 #include "zeek/IntrusivePtr.h"
+#include "zeek/ZeekArgs.h"
+#include "zeek/broker/CompactEvents.h"
 #include "zeek/iosource/IOSource.h"
 #include "zeek/logging/WriterBackend.h"
 
@@ -185,6 +188,27 @@ public:
 	 */
 	bool PublishEvent(std::string topic, RecordVal* ev);
 
+	/**
+	 * Send an event to any interested peers in the compact encoding
+	 * enabled by Broker::compact_event_encoding, which writes the event's
+	 * arguments directly into a buffer instead of converting them to
+	 * Broker data first.
+	 * @param topic a topic string associated with the message.
+	 * @param name the name of the event
+	 * @param types the event's parameter types
+	 * @param args the event's arguments
+	 * @return false if compact encoding is disabled or doesn't support the
+	 * types of the arguments, in which case the event needs to get sent
+	 * with PublishEvent() instead.
+	 */
+	bool PublishCompactEvent(const std::string& topic, std::string_view name,
+	                         const std::vector<TypePtr>& types, const Args& args);
+
+	/**
+	 * @return true if Broker::compact_event_encoding is enabled.
+	 */
+	bool UsesCompactEventEncoding() const { return compact_event_encoding; }
+
 	/**
 	 * Send a message to create a log stream to any interested peers.
 	 * The log stream may or may not already exist on the receiving side.
@@ -313,6 +337,32 @@ public:
 	 */
 	detail::StoreHandleVal* LookupStore(const std::string& name);
 
+	/**
+	 * Lookup the data store that a key of a Broker store backed Zeek table
+	 * goes into. That's the table's store, unless Broker::table_store_shards
+	 * splits it into several ones, in which case the key's hash picks one.
+	 * @param name the name of the table's store.
+	 * @param key the key.
+	 * @return a pointer to the store handle if it exists else nullptr.
+	 */
+	detail::StoreHandleVal* LookupTableStore(const std::string& name, const broker::data& key);
+
+	/**
+	 * @param name the name of a Broker store backed Zeek table's store.
+	 * @return the names of the stores that the table is split into, or
+	 * just *name* if it's not split.
+	 */
+	std::vector<std::string> TableStoreShards(const std::string& name) const;
+
+	/**
+	 * Create the masters for a share of the stores backing Zeek tables,
+	 * so that several nodes can split up the shards of all tables.
+	 * @param owner the index of this node among those sharing the masters.
+	 * @param num_owners the number of nodes sharing the masters.
+	 * @return the names of the stores for which this node is the master now.
+	 */
+	std::vector<std::string> MakeTableStoreMasters(size_t owner, size_t num_owners);
+
 	/**
 	 * Register a Zeek table that is associated with a Broker store that is backing it. This
 	 * causes all changes that happen to the Broker store in the future to be applied to theZzeek
@@ -341,11 +391,27 @@ public:
 	                     detail::StoreQueryCallback* cb);
 
 	/**
-	 * Send all pending log write messages.
+	 * Send all pending log write messages, after any pending event
+	 * messages.
 	 * @return the number of messages sent.
 	 */
 	size_t FlushLogBuffers();
 
+	/**
+	 * Send all pending event messages. This happens before log and data
+	 * store messages go out, so that these don't overtake events published
+	 * before them.
+	 * @return the number of events sent.
+	 */
+	size_t FlushEventBuffers();
+
+	/**
+	 * Send all changes of Broker store backed Zeek tables that are held
+	 * back for coalescing.
+	 * @return the number of changes sent.
+	 */
+	size_t FlushStoreWrites();
+
 	/**
 	 * Flushes all pending data store queries and also clears all contents.
 	 */
@@ -400,11 +466,16 @@ private:
 	void DispatchMessage(const broker::topic& topic, broker::data msg);
 	// Process events used for Broker store backed zeek tables
 	void ProcessStoreEvent(broker::data msg);
+	// Process a batch of such events, skipping those that later ones override.
+	void ProcessStoreEvents(std::vector<broker::data> msgs);
 	// Common functionality for processing insert and update events.
 	void ProcessStoreEventInsertUpdate(const TableValPtr& table, const std::string& store_id,
 	                                   const broker::data& key, const broker::data& data,
 	                                   const broker::data& old_value, bool insert);
 	void ProcessEvent(const broker::topic& topic, broker::zeek::Event ev);
+	void ProcessCompactEvents(const broker::topic& topic, broker::vector args);
+	// Check if events with the given topic are only forwarded to peers.
+	bool IsForwarded(const std::string& topic) const;
 	bool ProcessLogCreate(broker::zeek::LogCreate lc);
 	bool ProcessLogWrite(broker::zeek::LogWrite lw);
 	bool ProcessIdentifierUpdate(broker::zeek::IdentifierUpdate iu);
@@ -414,6 +485,9 @@ private:
 	void FlushPendingQueries();
 	// Initializes the masters for Broker backed Zeek tables when using the &backend attribute
 	void InitializeBrokerStoreForwarding();
+	// Creates the master for a store backing a Zeek table.
+	detail::StoreHandleVal* MakeTableStoreMaster(const std::string& name,
+	                                             broker::backend backend);
 	// Check if a Broker store is associated to a table on the Zeek side.
 	void PrepareForwarding(const std::string& name);
 	// Send the content of a Broker store to the backing table. This is typically used
@@ -436,6 +510,18 @@ private:
 		size_t Flush(broker::endpoint& endpoint, size_t batch_size);
 		};
 
+	struct EventBuffer
+		{
+		broker::vector msgs;
+		detail::CompactEventWriter compact;
+		size_t message_count = 0;
+
+		// Moves pending compactly encoded events into msgs as a single
+		// message, which keeps them in order with regular ones.
+		void SealCompact();
+		size_t Flush(broker::endpoint& endpoint, const std::string& topic);
+		};
+
 	// Data stores
 	using query_id = std::pair<broker::request_id, detail::StoreHandleVal*>;
 
@@ -451,6 +537,7 @@ private:
 		};
 
 	std::vector<LogBuffer> log_buffers; // Indexed by stream ID enum.
+	std::unordered_map<std::string, EventBuffer> event_buffers; // Indexed by topic.
 	std::string default_log_topic_prefix;
 	std::shared_ptr<BrokerState> bstate;
 	std::unordered_map<std::string, detail::StoreHandleVal*> data_stores;
@@ -465,12 +552,19 @@ private:
 	int peer_count;
 
 	size_t log_batch_size;
+	size_t event_batch_size;
+	bool compact_event_encoding;
 	Func* log_topic_func;
 	VectorTypePtr vector_of_data_type;
 	EnumType* log_id_type;
 	EnumType* writer_id_type;
 	bool zeek_table_manager = false;
 	std::string zeek_table_db_directory;
+	size_t table_store_shards = 1;
+	bool coalesce_table_store_writes = false;
+	// Indexed by the name of a table's store.
+	std::unordered_map<std::string, std::vector<std::string>> table_store_shard_names;
+	std::unordered_map<std::string, broker::backend> table_store_backends;
 
 	static int script_scope;
 	};
@@ -36,6 +36,45 @@ void StoreHandleVal::ValDescribe(ODesc* d) const
 	d->Add("}");
 	}
 
+void StoreHandleVal::Write(broker::data key, std::optional<broker::data> value,
+                           std::optional<broker::timespan> expiry)
+	{
+	if ( coalesce_writes )
+		{
+		pending_writes.insert_or_assign(std::move(key), PendingWrite{std::move(value), expiry});
+		return;
+		}
+
+	// Keeps the write in order with events published before it.
+	broker_mgr->FlushEventBuffers();
+
+	if ( value )
+		store.put(std::move(key), std::move(*value), expiry);
+	else
+		store.erase(std::move(key));
+	}
+
+size_t StoreHandleVal::FlushWrites()
+	{
+	auto rval = pending_writes.size();
+
+	if ( rval )
+		broker_mgr->FlushEventBuffers();
+
+	// Expiries start once the store sees the write, which may be up to the
+	// coalescing interval after the change.
+	for ( auto& [key, w] : pending_writes )
+		{
+		if ( w.value )
+			store.put(key, std::move(*w.value), w.expiry);
+		else
+			store.erase(key);
+		}
+
+	pending_writes.clear();
+	return rval;
+	}
+
 IMPLEMENT_OPAQUE_VALUE(StoreHandleVal)
 
 broker::expected<broker::data> StoreHandleVal::DoSerialize() const
@@ -4,6 +4,8 @@
 #include <broker/backend_options.hh>
 #include <broker/store.hh>
 #include <broker/store_event.hh>
+#include <optional>
+#include <unordered_map>
 
 #include "zeek/OpaqueVal.h"
 #include "zeek/Trigger.h"
@@ -120,17 +122,45 @@ public:
 
 	void ValDescribe(ODesc* d) const override;
 
+	/**
+	 * Sends a change of the Broker store backed table to the store. If
+	 * writes get coalesced, only the latest change per key gets sent, once
+	 * FlushWrites() gets called.
+	 * @param key the key that changed.
+	 * @param value the key's new value, or nothing if the key got removed.
+	 * @param expiry the expiry of the new value.
+	 */
+	void Write(broker::data key, std::optional<broker::data> value,
+	           std::optional<broker::timespan> expiry = {});
+
+	/**
+	 * Sends all changes held back for coalescing to the store.
+	 * @return the number of changes sent.
+	 */
+	size_t FlushWrites();
+
 	broker::store store;
 	broker::store::proxy proxy;
 	broker::publisher_id store_pid;
 	// Zeek table that events are forwarded to.
 	TableValPtr forward_to;
 	bool have_store = false;
+	// Whether Write() holds on to changes until FlushWrites().
+	bool coalesce_writes = false;
 
 protected:
 	IntrusivePtr<Val> DoClone(CloneState* state) override { return {NewRef{}, this}; }
 
 	DECLARE_OPAQUE_VALUE(StoreHandleVal)
+
+private:
+	struct PendingWrite
+		{
+		std::optional<broker::data> value; // Unset for removals.
+		std::optional<broker::timespan> expiry;
+		};
+
+	std::unordered_map<broker::data, PendingWrite> pending_writes;
 	};
 
 // Helper function to construct a broker backend type from script land.
@@ -4,6 +4,7 @@
 
 #include <utility>
 
+#include "zeek/Conn.h"
 #include "zeek/Event.h"
 #include "zeek/Reporter.h"
 #include "zeek/RuleMatcher.h"
@@ -11,6 +12,7 @@
 #include "zeek/Val.h"
 #include "zeek/analyzer/Analyzer.h"
 #include "zeek/analyzer/Manager.h"
+#include "zeek/digest.h"
 #include "zeek/file_analysis/Analyzer.h"
 #include "zeek/file_analysis/FileReassembler.h"
 #include "zeek/file_analysis/FileTimer.h"
@@ -82,7 +84,7 @@ File::File(const std::string& file_id, const std::string& source_name, Connectio
            zeek::Tag tag, bool is_orig)
 	: id(file_id), val(nullptr), file_reassembler(nullptr), stream_offset(0),
 	  reassembly_max_buffer(0), did_metadata_inference(false), reassembly_enabled(false),
-	  postpone_timeout(false), done(false), analyzers(this)
+	  postpone_timeout(false), done(false), analyzers(this), content_digest(nullptr)
 	{
 	StaticInit();
 
@@ -108,6 +110,9 @@ File::~File()
 
 	for ( auto a : done_analyzers )
 		delete a;
+
+	if ( content_digest )
+		EVP_MD_CTX_free(content_digest);
 	}
 
 void File::UpdateLastActivityTime()
@@ -265,6 +270,30 @@ bool File::RemoveAnalyzer(zeek::Tag tag, RecordValPtr args)
 	return done ? false : analyzers.QueueRemove(tag, std::move(args));
 	}
 
+bool File::RemoveAnalyzers(zeek::Tag tag)
+	{
+	if ( done )
+		return false;
+
+	bool found = false;
+
+	for ( const auto& entry : analyzers )
+		{
+		auto* a = entry.GetValue<file_analysis::Analyzer*>();
+
+		if ( a->Tag() != tag )
+			continue;
+
+		DBG_LOG(DBG_FILE_ANALYSIS, "[%s] Queuing remove of %s analyzer", id.c_str(),
+		        file_mgr->GetComponentName(tag).c_str());
+
+		analyzers.QueueRemove(a->Tag(), a->GetArgs());
+		found = true;
+		}
+
+	return found;
+	}
+
 void File::EnableReassembly()
 	{
 	reassembly_enabled = true;
@@ -337,6 +366,105 @@ void File::InferMetadata()
 	FileEvent(file_sniff, {val, std::move(meta)});
 	}
 
+void File::LookupDuplicate(uint64_t size)
+	{
+	uint64_t bof_size = LookupFieldDefaultCount(bof_buffer_size_idx);
+	uint64_t total = LookupFieldDefaultCount(total_bytes_idx);
+
+	// The key covers the first bof_size bytes, which the BOF buffer holds
+	// in full unless the file is smaller.
+	if ( size == 0 || (total && total != size) || bof_buffer.size < std::min(bof_size, size) ||
+	     LookupFieldDefaultCount(missing_bytes_idx) != 0 )
+		return;
+
+	auto* ctx = zeek::detail::hash_init(zeek::detail::Hash_SHA256);
+	uint64_t remaining = bof_size;
+
+	for ( const auto* chunk : bof_buffer.chunks )
+		{
+		uint64_t n = std::min(remaining, static_cast<uint64_t>(chunk->Len()));
+		zeek::detail::hash_update(ctx, chunk->Bytes(), n);
+		remaining -= n;
+
+		if ( remaining == 0 )
+			break;
+		}
+
+	u_char digest[SHA256_DIGEST_LENGTH];
+	zeek::detail::hash_final(ctx, digest);
+
+	duplicate_key = util::fmt("%" PRIu64 "/%" PRIu64 "/", size, bof_size);
+	duplicate_key.append(reinterpret_cast<const char*>(digest), sizeof(digest));
+
+	auto orig = file_mgr->LookupCompletedFile(duplicate_key);
+
+	if ( ! orig || orig->file_id == id )
+		return;
+
+	// Only files that look like a repeat pay for a digest of their full
+	// contents. The BOF buffer holds everything seen so far.
+	content_digest = zeek::detail::hash_init(zeek::detail::Hash_SHA256);
+
+	for ( const auto* chunk : bof_buffer.chunks )
+		zeek::detail::hash_update(content_digest, chunk->Bytes(), chunk->Len());
+
+	// The earlier file's digest is only known if it repeated another file
+	// itself; otherwise, this file's digest gets remembered for the next.
+	if ( orig->digest.empty() || ! FileEventAvailable(file_duplicate) )
+		return;
+
+	duplicate_of = orig->file_id;
+	expected_digest = orig->digest;
+
+	DBG_LOG(DBG_FILE_ANALYSIS, "[%s] Possible duplicate of %s", id.c_str(), duplicate_of.c_str());
+
+	// Apply analyzers added on file_sniff, so that handlers can remove
+	// them, and apply the removals before any more data goes out.
+	analyzers.DrainModifications();
+	FileEvent(file_duplicate, {val, make_intrusive<StringVal>(duplicate_of)});
+	analyzers.DrainModifications();
+	}
+
+void File::CheckDuplicate()
+	{
+	std::string digest;
+
+	if ( content_digest )
+		{
+		u_char buf[SHA256_DIGEST_LENGTH];
+		zeek::detail::hash_final(content_digest, buf);
+		content_digest = nullptr;
+		digest.assign(reinterpret_cast<const char*>(buf), sizeof(buf));
+		}
+
+	uint64_t size = LookupFieldDefaultCount(seen_bytes_idx);
+	uint64_t total = LookupFieldDefaultCount(total_bytes_idx);
+
+	// Only files seen completely and without gaps count. A gap also drops
+	// the digest.
+	bool complete = size > 0 && (! total || total == size) &&
+	                LookupFieldDefaultCount(missing_bytes_idx) == 0;
+
+	if ( ! duplicate_of.empty() )
+		{
+		bool verified = complete && digest == expected_digest;
+
+		DBG_LOG(DBG_FILE_ANALYSIS, "[%s] Duplicate of %s %s", id.c_str(), duplicate_of.c_str(),
+		        verified ? "verified" : "not verified");
+
+		if ( FileEventAvailable(file_duplicate_verified) )
+			FileEvent(file_duplicate_verified,
+			          {val, make_intrusive<StringVal>(duplicate_of), val_mgr->Bool(verified)});
+
+		// A file posing as a repeat doesn't replace the earlier one.
+		if ( ! verified )
+			return;
+		}
+
+	if ( complete )
+		file_mgr->AddCompletedFile(duplicate_key, id, digest);
+	}
+
 bool File::BufferBOF(const u_char* data, uint64_t len)
 	{
 	if ( bof_buffer.full )
@@ -363,6 +491,11 @@ bool File::BufferBOF(const u_char* data, uint64_t len)
 
 void File::DeliverStream(const u_char* data, uint64_t len)
 	{
+	// Only started once the BOF buffer is full, which covers all data
+	// seen until then.
+	if ( content_digest )
+		zeek::detail::hash_update(content_digest, data, len);
+
 	bool bof_was_full = bof_buffer.full;
 	// Buffer enough data for the BOF buffer
 	BufferBOF(data, len);
@@ -371,6 +504,9 @@ void File::DeliverStream(const u_char* data, uint64_t len)
 	     LookupFieldDefaultCount(missing_bytes_idx) == 0 )
 		InferMetadata();
 
+	if ( ! bof_was_full && bof_buffer.full && file_mgr->DuplicateDetectionEnabled() )
+		LookupDuplicate(LookupFieldDefaultCount(total_bytes_idx));
+
 	DBG_LOG(DBG_FILE_ANALYSIS, "[%s] %" PRIu64 " stream bytes in at offset %" PRIu64 "; %s [%s%s]",
 	        id.c_str(), len, stream_offset, IsComplete() ? "complete" : "incomplete",
 	        util::fmt_bytes((const char*)data, std::min((uint64_t)40, len)), len > 40 ? "..." : "");
@@ -532,9 +668,16 @@ void File::EndOfFile()
 		DBG_LOG(DBG_FILE_ANALYSIS, "[%s] File over but bof_buffer not full.", id.c_str());
 		bof_buffer.full = true;
 		DeliverStream((const u_char*)"", 0);
+
+		// Files smaller than the BOF buffer only get looked up now.
+		if ( file_mgr->DuplicateDetectionEnabled() )
+			LookupDuplicate(stream_offset);
 		}
 	analyzers.DrainModifications();
 
+	if ( ! duplicate_key.empty() )
+		CheckDuplicate();
+
 	done = true;
 
 	for ( const auto& entry : analyzers )
@@ -562,6 +705,13 @@ void File::Gap(uint64_t offset, uint64_t len)
 		return;
 		}
 
+	if ( content_digest )
+		{
+		// A file with gaps can't be confirmed as a repeat.
+		EVP_MD_CTX_free(content_digest);
+		content_digest = nullptr;
+		}
+
 	if ( ! bof_buffer.full )
 		{
 		DBG_LOG(DBG_FILE_ANALYSIS,
@@ -607,9 +757,10 @@ void File::FileEvent(EventHandlerPtr h, Args args)
 	event_mgr.Enqueue(h, std::move(args));
 
 	if ( h == file_new || h == file_over_new_connection || h == file_sniff || h == file_timeout ||
-	     h == file_extraction_limit )
+	     h == file_extraction_limit || h == file_duplicate )
 		{
 		// immediate feedback is required for these events.
+		Connection::RefreshPacketVals();
 		event_mgr.Drain();
 		analyzers.DrainModifications();
 		}
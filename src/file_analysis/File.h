@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include <openssl/evp.h>
 #include <list>
 #include <string>
 #include <utility>
@@ -129,6 +130,15 @@ public:
 	 */
 	bool RemoveAnalyzer(zeek::Tag tag, RecordValPtr args);
 
+	/**
+	 * Queues removal of all analyzers of a given type from the file,
+	 * regardless of their arguments.
+	 * @param tag the analyzer tag of the file analyzers to remove.
+	 * @return false if there was no analyzer of that type or the file is
+	 *         already done, else true.
+	 */
+	bool RemoveAnalyzers(zeek::Tag tag);
+
 	/**
 	 * Signal that this analyzer can be deleted once it's safe to do so.
 	 */
@@ -277,6 +287,24 @@ protected:
 	 */
 	void InferMetadata();
 
+	/**
+	 * Once the BOF buffer is complete, looks up recently completed files
+	 * with the same size and BOF buffer contents. On a match, starts a
+	 * digest of the full contents, and if the earlier file's digest is
+	 * known, raises \c file_duplicate right away so that analyzers can be
+	 * removed before they do their work.
+	 * @param size the size of the file.
+	 */
+	void LookupDuplicate(uint64_t size);
+
+	/**
+	 * Finalizes the digest of a possible repeat's contents and, if the
+	 * file was seen completely, compares it with that of the earlier file,
+	 * raising \c file_duplicate_verified. Remembers complete files for
+	 * recognizing later repeats.
+	 */
+	void CheckDuplicate();
+
 	/**
 	 * Enables reassembly on the file.
 	 */
@@ -349,6 +377,11 @@ protected:
 		String::CVec chunks;
 		} bof_buffer; /**< Beginning of file buffer. */
 
+	EVP_MD_CTX* content_digest; /**< Running digest of the contents of a possible repeat. */
+	std::string duplicate_key; /**< For duplicate detection, empty if not eligible. */
+	std::string duplicate_of; /**< The earlier file reported via file_duplicate. */
+	std::string expected_digest; /**< The earlier file's digest, to confirm a repeat. */
+
 	zeek::detail::WeirdStateMap weird_state;
 
 	static int id_idx;
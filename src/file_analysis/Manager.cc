@@ -303,6 +303,68 @@ bool Manager::RemoveAnalyzer(const string& file_id, const zeek::Tag& tag, Record
 	return file->RemoveAnalyzer(tag, std::move(args));
 	}
 
+bool Manager::RemoveAnalyzers(const string& file_id, const zeek::Tag& tag) const
+	{
+	File* file = LookupFile(file_id);
+
+	if ( ! file )
+		return false;
+
+	return file->RemoveAnalyzers(tag);
+	}
+
+void Manager::SetDuplicateCacheSize(size_t n)
+	{
+	max_duplicates = n;
+
+	while ( duplicates.size() > max_duplicates )
+		{
+		duplicate_index.erase(duplicates.back().first);
+		duplicates.pop_back();
+		}
+	}
+
+const Manager::CompletedFile* Manager::LookupCompletedFile(const string& key)
+	{
+	auto it = duplicate_index.find(key);
+
+	if ( it == duplicate_index.end() )
+		return nullptr;
+
+	duplicates.splice(duplicates.begin(), duplicates, it->second);
+	return &it->second->second;
+	}
+
+void Manager::AddCompletedFile(const string& key, const string& file_id, const string& digest)
+	{
+	if ( max_duplicates == 0 )
+		return;
+
+	auto it = duplicate_index.find(key);
+
+	if ( it != duplicate_index.end() )
+		{
+		auto& cf = it->second->second;
+
+		// Without a digest, the file can't be told apart from the
+		// earlier one, so keep that.
+		if ( ! digest.empty() )
+			cf = {file_id, digest};
+
+		duplicates.splice(duplicates.begin(), duplicates, it->second);
+		return;
+		}
+
+	duplicates.emplace_front(key, CompletedFile{file_id, digest});
+	duplicate_index.emplace(key, duplicates.begin());
+
+	if ( duplicates.size() > max_duplicates )
+		{
+		duplicate_index.erase(duplicates.back().first);
+		duplicates.pop_back();
+		}
+	}
+
 File* Manager::GetFile(const string& file_id, Connection* conn, const zeek::Tag& tag, bool is_orig,
                        bool update_conn, const char* source_name)
 	{
@@ -431,6 +493,7 @@ string Manager::GetFileID(const zeek::Tag& tag, Connection* c, bool is_orig)
 	const auto& tagval = tag.AsVal();
 
 	event_mgr.Enqueue(get_file_handle, tagval, c->GetVal(), val_mgr->Bool(is_orig));
+	Connection::RefreshPacketVals();
 	event_mgr.Drain(); // need file handle immediately so we don't have to buffer data
 	return current_file_id;
 	}
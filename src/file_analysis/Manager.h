@@ -2,9 +2,11 @@
 
 #pragma once
 
+#include <list>
 #include <map>
 #include <set>
 #include <string>
+#include <unordered_map>
 
 #include "zeek/RuleMatcher.h"
 #include "zeek/RunState.h"
@@ -309,6 +311,15 @@ public:
 	 */
 	bool RemoveAnalyzer(const std::string& file_id, const zeek::Tag& tag, RecordValPtr args) const;
 
+	/**
+	 * Queue removal of all analyzers of a given type for a file identifier,
+	 * regardless of the arguments they were added with.
+	 * @param file_id the file identifier/hash.
+	 * @param tag the analyzer tag of the file analyzers to remove.
+	 * @return true if any analyzer of that type was active, else false.
+	 */
+	bool RemoveAnalyzers(const std::string& file_id, const zeek::Tag& tag) const;
+
 	/**
 	 * Tells whether analysis for a file is active or ignored.
 	 * @param file_id the file identifier/hash.
@@ -355,6 +366,50 @@ public:
 
 	uint64_t CumulativeFiles() { return cumulative_files; }
 
+	/**
+	 * Sets the number of completed files remembered for detecting
+	 * duplicates (see the \c file_duplicate event). Zero, the default,
+	 * disables duplicate detection.
+	 * @param n the maximum number of remembered files.
+	 */
+	void SetDuplicateCacheSize(size_t n);
+
+	/**
+	 * @return whether duplicate detection is enabled.
+	 */
+	bool DuplicateDetectionEnabled() const { return max_duplicates > 0; }
+
+	/**
+	 * What duplicate detection remembers about a completed file.
+	 */
+	struct CompletedFile
+		{
+		std::string file_id; /**< The file identifier/hash. */
+		std::string digest; /**< SHA256 of the full contents, empty if unknown. */
+		};
+
+	/**
+	 * Looks up a recently completed file with the given key, which covers
+	 * the file's size and a digest of its BOF buffer.
+	 * @param key a key as computed by File.
+	 * @return the earlier file, or nullptr if there's none. The pointer is
+	 *         valid until the next change to the cache.
+	 */
+	const CompletedFile* LookupCompletedFile(const std::string& key);
+
+	/**
+	 * Remembers a completed file for duplicate detection, evicting the
+	 * least recently seen one if the cache is full. A file with the digest
+	 * of its full contents replaces an earlier one with the same key, so
+	 * that the most recent confirmed file is the one reported.
+	 * @param key a key as computed by File.
+	 * @param file_id the file identifier/hash.
+	 * @param digest the SHA256 of the file's full contents, or an empty
+	 *        string if it wasn't computed.
+	 */
+	void AddCompletedFile(const std::string& key, const std::string& file_id,
+	                      const std::string& digest);
+
 protected:
 	friend class detail::FileTimer;
 
@@ -436,6 +491,12 @@ private:
 
 	size_t cumulative_files;
 	size_t max_files;
+
+	// LRU of completed files for duplicate detection, most recent first.
+	using DuplicateList = std::list<std::pair<std::string, CompletedFile>>;
+	DuplicateList duplicates;
+	std::unordered_map<std::string, DuplicateList::iterator> duplicate_index;
+	size_t max_duplicates = 0;
 	};
 
 /**
@@ -7,6 +7,7 @@
 
 #include "zeek/Event.h"
 #include "zeek/file_analysis/Manager.h"
+#include "zeek/file_analysis/analyzer/extract/consts.bif.h"
 #include "zeek/util.h"
 
 namespace zeek::file_analysis::detail
@@ -28,6 +29,9 @@ Extract::Extract(RecordValPtr args, file_analysis::File* file, const std::string
 			util::zeek_strerror_r(errno, buf, sizeof(buf));
 			reporter->Warning("cannot set buffering mode for %s: %s", filename.data(), buf);
 			}
+
+		if ( BifConst::FileExtract::async_writes )
+			async_output = std::make_shared<ExtractWriter::Output>(file_stream, filename);
 		}
 	else
 		{
@@ -38,7 +42,13 @@ Extract::Extract(RecordValPtr args, file_analysis::File* file, const std::string
 
 Extract::~Extract()
 	{
-	if ( file_stream && fclose(file_stream) )
+	if ( ! file_stream )
+		return;
+
+	if ( auto writer = Writer() )
+		writer->Close(async_output);
+
+	else if ( fclose(file_stream) )
 		{
 		char buf[128];
 		util::zeek_strerror_r(errno, buf, sizeof(buf));
@@ -111,18 +121,10 @@ bool Extract::DeliverStream(const u_char* data, uint64_t len)
 		limit_exceeded = check_limit_exceeded(limit, depth, len, &towrite);
 		}
 
-	char buf[128];
-
 	if ( towrite > 0 )
 		{
-		if ( fwrite(data, towrite, 1, file_stream) != 1 )
-			{
-			util::zeek_strerror_r(errno, buf, sizeof(buf));
-			reporter->Error("failed to write to extracted file %s: %s", filename.data(), buf);
-			fclose(file_stream);
-			file_stream = nullptr;
+		if ( ! Write(data, towrite) )
 			return false;
-			}
 
 		depth += towrite;
 		}
@@ -131,10 +133,17 @@ bool Extract::DeliverStream(const u_char* data, uint64_t len)
 	// the extraction limit and the file analysis File still proceeding to
 	// do other analysis without destructing/closing this one until the very end,
 	// so flush anything currently buffered.
-	if ( limit_exceeded && fflush(file_stream) )
+	if ( limit_exceeded )
 		{
-		util::zeek_strerror_r(errno, buf, sizeof(buf));
-		reporter->Warning("cannot fflush extracted file %s: %s", filename.data(), buf);
+		if ( auto writer = Writer() )
+			writer->Flush(async_output);
+
+		else if ( fflush(file_stream) )
+			{
+			char buf[128];
+			util::zeek_strerror_r(errno, buf, sizeof(buf));
+			reporter->Warning("cannot fflush extracted file %s: %s", filename.data(), buf);
+			}
 		}
 
 	return (! limit_exceeded);
@@ -147,24 +156,81 @@ bool Extract::Undelivered(uint64_t offset, uint64_t len)
 
 	if ( depth == offset )
 		{
-		char* tmp = new char[len]();
+		if ( ! Write(nullptr, len) )
+			return false;
 
-		if ( fwrite(tmp, len, 1, file_stream) != 1 )
+		depth += len;
+		}
+
+	return true;
+	}
+
+bool Extract::Write(const u_char* data, uint64_t len)
+	{
+	if ( async_output )
+		{
+		// Failures surface with a delay, on the next write after the
+		// writer thread ran into them.
+		if ( int err = async_output->error )
 			{
-			char buf[128];
-			util::zeek_strerror_r(errno, buf, sizeof(buf));
-			reporter->Error("failed to write to extracted file %s: %s", filename.data(), buf);
-			fclose(file_stream);
-			file_stream = nullptr;
-			delete[] tmp;
+			WriteFailed(err);
 			return false;
 			}
 
+		if ( auto writer = Writer() )
+			{
+			writer->Write(async_output, data, len);
+			return true;
+			}
+		}
+
+	bool ok;
+
+	if ( data )
+		ok = fwrite(data, len, 1, file_stream) == 1;
+	else
+		{
+		char* tmp = new char[len]();
+		ok = fwrite(tmp, len, 1, file_stream) == 1;
 		delete[] tmp;
-		depth += len;
+		}
+
+	if ( ! ok )
+		{
+		WriteFailed(errno);
+		return false;
 		}
 
 	return true;
 	}
 
+void Extract::WriteFailed(int err)
+	{
+	char buf[128];
+	util::zeek_strerror_r(err, buf, sizeof(buf));
+	reporter->Error("failed to write to extracted file %s: %s", filename.data(), buf);
+
+	if ( auto writer = Writer() )
+		writer->Close(async_output);
+	else
+		fclose(file_stream);
+
+	file_stream = nullptr;
+	}
+
+ExtractWriter* Extract::Writer()
+	{
+	if ( ! async_output )
+		return nullptr;
+
+	if ( auto writer = ExtractWriter::Instance() )
+		return writer;
+
+	// There's no writer thread during shutdown.  The threading manager
+	// lets the writer drain its queue before stopping it, so whatever we
+	// queued earlier is on disk by now and we can continue synchronously.
+	async_output = nullptr;
+	return nullptr;
+	}
+
 	} // namespace zeek::file_analysis::detail
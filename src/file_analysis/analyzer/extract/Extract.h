@@ -8,6 +8,7 @@
 #include "zeek/Val.h"
 #include "zeek/file_analysis/Analyzer.h"
 #include "zeek/file_analysis/File.h"
+#include "zeek/file_analysis/analyzer/extract/ExtractWriter.h"
 #include "zeek/file_analysis/analyzer/extract/events.bif.h"
 
 namespace zeek::file_analysis::detail
@@ -70,8 +71,30 @@ protected:
 	        uint64_t arg_limit);
 
 private:
+	/**
+	 * Appends data to the extraction file, either directly or through the
+	 * writer thread. Closes the file if writing fails.
+	 * @param data the data, or null for writing \a len zero bytes.
+	 * @param len number of bytes to write.
+	 * @return false if writing failed, else true.
+	 */
+	bool Write(const u_char* data, uint64_t len);
+
+	/**
+	 * Reports a failure to write to the extraction file and closes it.
+	 */
+	void WriteFailed(int err);
+
+	/**
+	 * Returns the writer thread to hand the extraction file to, or null if
+	 * writing synchronously. Switches to synchronous writes once the writer
+	 * is no longer available during shutdown.
+	 */
+	ExtractWriter* Writer();
+
 	std::string filename;
 	FILE* file_stream;
+	ExtractWriter::OutputPtr async_output; // set if writing through the writer thread
 	uint64_t limit;
 	uint64_t depth;
 	};
@@ -0,0 +1,191 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/file_analysis/analyzer/extract/ExtractWriter.h"
+
+#include <cerrno>
+
+#include "zeek/RunState.h"
+#include "zeek/file_analysis/analyzer/extract/consts.bif.h"
+#include "zeek/telemetry/Manager.h"
+
+namespace zeek::file_analysis::detail
+	{
+
+ExtractWriter* ExtractWriter::instance = nullptr;
+
+ExtractWriter* ExtractWriter::Instance()
+	{
+	// Don't start a writer while shutting down: the threading manager
+	// may already be done with its threads and wouldn't stop a new one.
+	if ( ! instance && ! run_state::terminating )
+		{
+		instance = new ExtractWriter();
+		instance->Start();
+		}
+
+	return instance;
+	}
+
+ExtractWriter::ExtractWriter()
+	: max_pending_bytes(BifConst::FileExtract::async_max_pending),
+	  queue_depth(telemetry_mgr->GaugeSingleton("zeek", "extract-queue-depth",
+                                                "Extraction writes waiting for the writer thread")),
+	  queued_bytes(telemetry_mgr->GaugeSingleton("zeek", "extract-queued",
+                                                 "Extracted bytes waiting for the writer thread",
+                                                 "bytes")),
+	  stalls(telemetry_mgr->CounterSingleton(
+		  "zeek", "extract-stalls", "Times the main thread waited for the extraction writer")),
+	  write_errors(telemetry_mgr->CounterSingleton("zeek", "extract-write-errors",
+                                                   "Failed writes of extracted files"))
+	{
+	SetName("extract-writer");
+	}
+
+ExtractWriter::~ExtractWriter()
+	{
+	// The threading manager deletes us during shutdown; make sure any
+	// later extraction writes synchronously rather than using a dangling
+	// writer.
+	instance = nullptr;
+	}
+
+void ExtractWriter::Write(const OutputPtr& out, const u_char* data, uint64_t len)
+	{
+	Job job{Op::WRITE, out};
+
+	if ( data )
+		job.data.assign(reinterpret_cast<const char*>(data), len);
+	else
+		job.zeros = len;
+
+	Enqueue(std::move(job), len);
+	}
+
+void ExtractWriter::Flush(const OutputPtr& out)
+	{
+	Enqueue(Job{Op::FLUSH, out}, 0);
+	}
+
+void ExtractWriter::Close(const OutputPtr& out)
+	{
+	Enqueue(Job{Op::CLOSE, out}, 0);
+	}
+
+void ExtractWriter::Enqueue(Job job, uint64_t len)
+	{
+	std::unique_lock<std::mutex> guard(lock);
+
+	// Apply backpressure once the limit is reached, but always let a
+	// single job through so that chunks larger than it still progress.
+	if ( ! jobs.empty() && pending_bytes + len > max_pending_bytes )
+		{
+		stalls.Inc();
+		space_cond.wait(guard,
+		                [&]
+		                {
+							return jobs.empty() || pending_bytes + len <= max_pending_bytes ||
+			                       Killed();
+						});
+		}
+
+	jobs.push_back(std::move(job));
+	pending_bytes += len;
+	queue_depth.Inc();
+	queued_bytes.Inc(len);
+
+	guard.unlock();
+	work_cond.notify_one();
+	}
+
+void ExtractWriter::Run()
+	{
+	std::unique_lock<std::mutex> guard(lock);
+
+	while ( ! Killed() )
+		{
+		work_cond.wait(guard, [this] { return ! jobs.empty() || stopping || Killed(); });
+
+		if ( jobs.empty() )
+			{
+			if ( stopping )
+				break;
+
+			continue;
+			}
+
+		Job job = std::move(jobs.front());
+		jobs.pop_front();
+
+		guard.unlock();
+		Process(job);
+		guard.lock();
+
+		uint64_t len = job.op == Op::WRITE ? job.data.size() + job.zeros : 0;
+		pending_bytes -= len;
+		queue_depth.Dec();
+		queued_bytes.Dec(len);
+		space_cond.notify_all();
+		}
+	}
+
+void ExtractWriter::Process(Job& job)
+	{
+	Output* out = job.out.get();
+
+	if ( job.op == Op::CLOSE )
+		{
+		if ( fclose(out->stream) && ! out->error )
+			{
+			out->error = errno;
+			write_errors.Inc();
+			}
+
+		out->stream = nullptr;
+		return;
+		}
+
+	if ( out->error )
+		return;
+
+	if ( job.op == Op::FLUSH )
+		{
+		// A failing flush doesn't lose data, the analyzer only warned
+		// about it when writing synchronously.
+		fflush(out->stream);
+		return;
+		}
+
+	bool ok;
+
+	if ( job.zeros )
+		{
+		std::string zeros(job.zeros, '\0');
+		ok = fwrite(zeros.data(), zeros.size(), 1, out->stream) == 1;
+		}
+	else
+		ok = fwrite(job.data.data(), job.data.size(), 1, out->stream) == 1;
+
+	if ( ! ok )
+		{
+		out->error = errno ? errno : EIO;
+		write_errors.Inc();
+		}
+	}
+
+void ExtractWriter::OnSignalStop()
+	{
+	// Run() drains the queue before returning.
+	std::unique_lock<std::mutex> guard(lock);
+	stopping = true;
+	guard.unlock();
+
+	work_cond.notify_one();
+	}
+
+void ExtractWriter::OnKill()
+	{
+	work_cond.notify_one();
+	space_cond.notify_all();
+	}
+
+	} // namespace zeek::file_analysis::detail
@@ -0,0 +1,124 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "zeek/telemetry/Counter.h"
+#include "zeek/telemetry/Gauge.h"
+#include "zeek/threading/BasicThread.h"
+
+namespace zeek::file_analysis::detail
+	{
+
+/**
+ * A thread writing extracted file contents to disk on behalf of the
+ * Extract analyzers, so that slow disks don't stall the main thread.
+ *
+ * The amount of queued data is bounded by FileExtract::async_max_pending;
+ * once that's reached, queuing more blocks the main thread until the
+ * writer has caught up.
+ */
+class ExtractWriter final : public threading::BasicThread
+	{
+public:
+	/**
+	 * An extraction file handed over to the writer. The writer owns the
+	 * stream from then on, including closing it.
+	 */
+	struct Output
+		{
+		Output(FILE* arg_stream, std::string arg_filename)
+			: stream(arg_stream), filename(std::move(arg_filename))
+			{
+			}
+
+		FILE* stream;
+		std::string filename;
+
+		// Set by the writer if writing failed; the errno value of the
+		// failure. Further data for the output is dropped.
+		std::atomic<int> error = 0;
+		};
+
+	using OutputPtr = std::shared_ptr<Output>;
+
+	/**
+	 * Returns the writer, creating and starting its thread on first use.
+	 * Returns null once Zeek is terminating and there's no writer running,
+	 * as the threading manager may already have stopped its threads then;
+	 * callers must write synchronously instead. Must only be called from
+	 * the main thread.
+	 */
+	static ExtractWriter* Instance();
+
+	/**
+	 * Queues data for appending to an output.
+	 * @param out the output to write to.
+	 * @param data the data, or null for writing \a len zero bytes.
+	 * @param len the number of bytes to write.
+	 */
+	void Write(const OutputPtr& out, const u_char* data, uint64_t len);
+
+	/**
+	 * Queues flushing an output's buffered data to disk.
+	 */
+	void Flush(const OutputPtr& out);
+
+	/**
+	 * Queues closing an output once everything queued before has been
+	 * written.
+	 */
+	void Close(const OutputPtr& out);
+
+protected:
+	void Run() override;
+	void OnSignalStop() override;
+	void OnWaitForStop() override { }
+	void OnKill() override;
+
+private:
+	ExtractWriter();
+	~ExtractWriter() override;
+
+	enum class Op
+		{
+		WRITE,
+		FLUSH,
+		CLOSE,
+		};
+
+	struct Job
+		{
+		Op op;
+		OutputPtr out;
+		std::string data;
+		uint64_t zeros = 0;
+		};
+
+	void Enqueue(Job job, uint64_t len);
+	void Process(Job& job);
+
+	std::mutex lock;
+	std::condition_variable work_cond;
+	std::condition_variable space_cond;
+	std::deque<Job> jobs;
+	uint64_t pending_bytes = 0;
+	uint64_t max_pending_bytes;
+	bool stopping = false;
+
+	telemetry::IntGauge queue_depth;
+	telemetry::IntGauge queued_bytes;
+	telemetry::IntCounter stalls;
+	telemetry::IntCounter write_errors;
+
+	static ExtractWriter* instance;
+	};
+
+	} // namespace zeek::file_analysis::detail
@@ -2,6 +2,7 @@
 
 #include "zeek/file_analysis/analyzer/hash/Hash.h"
 
+#include <algorithm>
 #include <string>
 
 #include "zeek/Event.h"
@@ -11,28 +12,53 @@
 namespace zeek::file_analysis::detail
 	{
 
+// Data is fed to all digests slice by slice, so that each slice is still
+// in cache when the next digest reads it.
+static constexpr uint64_t hash_slice_size = 16 * 1024;
+
 Hash::Hash(RecordValPtr args, file_analysis::File* file, HashVal* hv, const char* arg_kind)
-	: file_analysis::Analyzer(file_mgr->GetComponentTag(util::to_upper(arg_kind).c_str()),
-                              std::move(args), file),
-	  hash(hv), fed(false), kind(arg_kind)
+	: Hash(std::move(args), file, util::to_upper(arg_kind).c_str(), {{hv, arg_kind}})
+	{
+	}
+
+Hash::Hash(RecordValPtr args, file_analysis::File* file, const char* name,
+           std::vector<std::pair<HashVal*, const char*>> arg_digests)
+	: file_analysis::Analyzer(file_mgr->GetComponentTag(name), std::move(args), file),
+	  digests(std::move(arg_digests)), fed(false)
 	{
-	hash->Init();
+	for ( auto& [hash, kind] : digests )
+		hash->Init();
 	}
 
 Hash::~Hash()
 	{
-	Unref(hash);
+	for ( auto& [hash, kind] : digests )
+		Unref(hash);
 	}
 
 bool Hash::DeliverStream(const u_char* data, uint64_t len)
 	{
-	if ( ! hash->IsValid() )
-		return false;
+	for ( auto& [hash, kind] : digests )
+		if ( ! hash->IsValid() )
+			return false;
 
 	if ( ! fed )
 		fed = len > 0;
 
-	hash->Feed(data, len);
+	if ( digests.size() == 1 )
+		{
+		digests[0].first->Feed(data, len);
+		return true;
+		}
+
+	for ( uint64_t off = 0; off < len; off += hash_slice_size )
+		{
+		uint64_t n = std::min(hash_slice_size, len - off);
+
+		for ( auto& [hash, kind] : digests )
+			hash->Feed(data + off, n);
+		}
+
 	return true;
 	}
 
@@ -49,13 +75,17 @@ bool Hash::Undelivered(uint64_t offset, uint64_t len)
 
 void Hash::Finalize()
 	{
-	if ( ! hash->IsValid() || ! fed )
+	if ( ! fed || ! file_hash )
 		return;
 
-	if ( ! file_hash )
-		return;
+	for ( auto& [hash, kind] : digests )
+		{
+		if ( ! hash->IsValid() )
+			continue;
 
-	event_mgr.Enqueue(file_hash, GetFile()->ToVal(), make_intrusive<StringVal>(kind), hash->Get());
+		event_mgr.Enqueue(file_hash, GetFile()->ToVal(), make_intrusive<StringVal>(kind),
+		                  hash->Get());
+		}
 	}
 
 	} // namespace zeek::file_analysis::detail
@@ -3,6 +3,8 @@
 #pragma once
 
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "zeek/OpaqueVal.h"
 #include "zeek/Val.h"
@@ -14,7 +16,9 @@ namespace zeek::file_analysis::detail
 	{
 
 /**
- * An analyzer to produce a hash of file contents.
+ * An analyzer to produce one or more hashes of file contents. When it
+ * computes several, each chunk of data is fed to all of them in a single
+ * pass.
  */
 class Hash : public file_analysis::Analyzer
 	{
@@ -58,15 +62,26 @@ protected:
 	Hash(RecordValPtr args, file_analysis::File* file, HashVal* hv, const char* kind);
 
 	/**
-	 * If some file contents have been seen, finalizes the hash of them and
-	 * raises the "file_hash" event with the results.
+	 * Constructor for an analyzer computing several digests at once.
+	 * @param args the \c AnalyzerArgs value which represents the analyzer.
+	 * @param file the file to which the analyzer will be attached.
+	 * @param name the name of the analyzer's component.
+	 * @param digests pairs of hash calculator objects and the human
+	 * readable names of their algorithms, in the order in which the
+	 * "file_hash" events will be raised. Takes ownership of the objects.
+	 */
+	Hash(RecordValPtr args, file_analysis::File* file, const char* name,
+	     std::vector<std::pair<HashVal*, const char*>> digests);
+
+	/**
+	 * If some file contents have been seen, finalizes the hashes of them and
+	 * raises a "file_hash" event for each with the results.
 	 */
 	void Finalize();
 
 private:
-	HashVal* hash;
+	std::vector<std::pair<HashVal*, const char*>> digests;
 	bool fed;
-	const char* kind;
 	};
 
 /**
@@ -159,4 +174,37 @@ protected:
 		}
 	};
 
+/**
+ * An analyzer to produce MD5, SHA1 and SHA256 hashes of file contents in a
+ * single pass over the data. It raises the same "file_hash" events as
+ * attaching the three individual analyzers would.
+ */
+class Hashes : public Hash
+	{
+public:
+	/**
+	 * Create a new instance of the combined hashing file analyzer.
+	 * @param args the \c AnalyzerArgs value which represents the analyzer.
+	 * @param file the file to which the analyzer will be attached.
+	 * @return the new analyzer instance or a null pointer if there's no
+	 *         handler for the "file_hash" event.
+	 */
+	static file_analysis::Analyzer* Instantiate(RecordValPtr args, file_analysis::File* file)
+		{
+		return file_hash ? new Hashes(std::move(args), file) : nullptr;
+		}
+
+protected:
+	/**
+	 * Constructor.
+	 * @param args the \c AnalyzerArgs value which represents the analyzer.
+	 * @param file the file to which the analyzer will be attached.
+	 */
+	Hashes(RecordValPtr args, file_analysis::File* file)
+		: Hash(std::move(args), file, "HASHES",
+	           {{new MD5Val(), "md5"}, {new SHA1Val(), "sha1"}, {new SHA256Val(), "sha256"}})
+		{
+		}
+	};
+
 	} // namespace zeek::file_analysis
@@ -19,6 +19,8 @@ public:
 			"SHA1", zeek::file_analysis::detail::SHA1::Instantiate));
 		AddComponent(new zeek::file_analysis::Component(
 			"SHA256", zeek::file_analysis::detail::SHA256::Instantiate));
+		AddComponent(new zeek::file_analysis::Component(
+			"HASHES", zeek::file_analysis::detail::Hashes::Instantiate));
 
 		zeek::plugin::Configuration config;
 		config.name = "Zeek::FileHash";
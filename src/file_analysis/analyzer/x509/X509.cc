@@ -10,7 +10,9 @@
 #include <openssl/opensslconf.h>
 #include <openssl/x509.h>
 #include <openssl/x509v3.h>
+#include <list>
 #include <string>
+#include <unordered_map>
 #if OPENSSL_VERSION_NUMBER >= 0x30000000L
 #include <openssl/core_names.h>
 #endif
@@ -20,10 +22,77 @@
 #include "zeek/file_analysis/Manager.h"
 #include "zeek/file_analysis/analyzer/x509/events.bif.h"
 #include "zeek/file_analysis/analyzer/x509/types.bif.h"
+#include "zeek/telemetry/Manager.h"
 
 namespace zeek::file_analysis::detail
 	{
 
+class X509::CertificateCache
+	{
+public:
+	CertificateCache()
+		: hits(telemetry_mgr->CounterSingleton("zeek", "x509-cache-hits",
+	                                           "Certificates found in the X509 cache")),
+		  misses(telemetry_mgr->CounterSingleton("zeek", "x509-cache-misses",
+	                                             "Certificates not found in the X509 cache")),
+		  evictions(telemetry_mgr->CounterSingleton("zeek", "x509-cache-evictions",
+	                                                "Certificates evicted from the X509 cache"))
+		{
+		}
+
+	const RecordedEvents* Lookup(const std::string& digest)
+		{
+		auto it = index.find(digest);
+
+		if ( it == index.end() )
+			{
+			misses.Inc();
+			return nullptr;
+			}
+
+		hits.Inc();
+		entries.splice(entries.begin(), entries, it->second);
+		return &it->second->second;
+		}
+
+	void Insert(const std::string& digest, RecordedEvents events)
+		{
+		if ( index.count(digest) )
+			return;
+
+		entries.emplace_front(digest, std::move(events));
+		index[digest] = entries.begin();
+		Trim();
+		}
+
+	void SetMaxSize(size_t n)
+		{
+		max_size = n;
+		Trim();
+		}
+
+private:
+	using Entries = std::list<std::pair<std::string, RecordedEvents>>;
+
+	void Trim()
+		{
+		while ( entries.size() > max_size )
+			{
+			index.erase(entries.back().first);
+			entries.pop_back();
+			evictions.Inc();
+			}
+		}
+
+	Entries entries; // most recently seen first
+	std::unordered_map<std::string, Entries::iterator> index;
+	size_t max_size = 0;
+
+	telemetry::IntCounter hits;
+	telemetry::IntCounter misses;
+	telemetry::IntCounter evictions;
+	};
+
 X509::X509(RecordValPtr args, file_analysis::File* file)
 	: X509Common::X509Common(file_mgr->GetComponentTag("X509"), std::move(args), file)
 	{
@@ -45,15 +114,35 @@ bool X509::Undelivered(uint64_t offset, uint64_t len)
 bool X509::EndOfFile()
 	{
 	const unsigned char* cert_char = reinterpret_cast<const unsigned char*>(cert_data.data());
-	if ( certificate_cache )
+	unsigned char cert_sha256[SHA256_DIGEST_LENGTH];
+	std::string cert_digest;
+
+	if ( native_cache || certificate_cache )
 		{
-		// first step - let's see if the certificate has been cached.
-		unsigned char buf[SHA256_DIGEST_LENGTH];
 		auto ctx = zeek::detail::hash_init(zeek::detail::Hash_SHA256);
 		zeek::detail::hash_update(ctx, cert_char, cert_data.size());
-		zeek::detail::hash_final(ctx, buf);
-		std::string cert_sha256 = zeek::detail::sha256_digest_print(buf);
-		auto index = make_intrusive<StringVal>(cert_sha256);
+		zeek::detail::hash_final(ctx, cert_sha256);
+		}
+
+	if ( native_cache )
+		{
+		cert_digest.assign(reinterpret_cast<const char*>(cert_sha256), sizeof(cert_sha256));
+
+		if ( const auto* events = native_cache->Lookup(cert_digest) )
+			{
+			// Seen recently; raise the same events as back then.
+			for ( const auto& [h, args] : *events )
+				EnqueueFileEvent(h, args);
+
+			return false;
+			}
+		}
+
+	if ( certificate_cache )
+		{
+		// first step - let's see if the certificate has been cached.
+		std::string cert_sha256_str = zeek::detail::sha256_digest_print(cert_sha256);
+		auto index = make_intrusive<StringVal>(cert_sha256_str);
 		const auto& entry = certificate_cache->Find(index);
 
 		if ( entry )
@@ -65,7 +154,7 @@ bool X509::EndOfFile()
 			// yup, let's call the callback.
 
 			cache_hit_callback->Invoke(GetFile()->ToVal(), entry,
-			                           make_intrusive<StringVal>(cert_sha256));
+			                           make_intrusive<StringVal>(cert_sha256_str));
 			return false;
 			}
 		}
@@ -84,10 +173,15 @@ bool X509::EndOfFile()
 	// parse basic information into record.
 	auto cert_record = ParseCertificate(cert_val, GetFile());
 
+	// Remember the events we raise, for replaying them from the cache.
+	RecordedEvents events;
+
+	if ( native_cache )
+		recorded_events = &events;
+
 	// and send the record on to scriptland
 	if ( x509_certificate )
-		event_mgr.Enqueue(x509_certificate, GetFile()->ToVal(), IntrusivePtr{NewRef{}, cert_val},
-		                  cert_record);
+		EnqueueFileEvent(x509_certificate, {IntrusivePtr{NewRef{}, cert_val}, cert_record});
 
 	// after parsing the certificate - parse the extensions...
 
@@ -108,6 +202,12 @@ bool X509::EndOfFile()
 
 	Unref(cert_val); // Same for cert_val
 
+	if ( native_cache )
+		{
+		recorded_events = nullptr;
+		native_cache->Insert(cert_digest, std::move(events));
+		}
+
 	return false;
 	}
 
@@ -292,6 +392,26 @@ void X509::FreeRootStore()
 		X509_STORE_free(e.second);
 	}
 
+void X509::SetNativeCacheSize(size_t n)
+	{
+	if ( n == 0 )
+		{
+		FreeNativeCache();
+		return;
+		}
+
+	if ( ! native_cache )
+		native_cache = new CertificateCache();
+
+	native_cache->SetMaxSize(n);
+	}
+
+void X509::FreeNativeCache()
+	{
+	delete native_cache;
+	native_cache = nullptr;
+	}
+
 void X509::ParseBasicConstraints(X509_EXTENSION* ex)
 	{
 	assert(OBJ_obj2nid(X509_EXTENSION_get_object(ex)) == NID_basic_constraints);
@@ -310,8 +430,7 @@ void X509::ParseBasicConstraints(X509_EXTENSION* ex)
 				pBasicConstraint->Assign(1,
 				                         static_cast<int32_t>(ASN1_INTEGER_get(constr->pathlen)));
 
-			event_mgr.Enqueue(x509_ext_basic_constraints, GetFile()->ToVal(),
-			                  std::move(pBasicConstraint));
+			EnqueueFileEvent(x509_ext_basic_constraints, {std::move(pBasicConstraint)});
 			}
 
 		BASIC_CONSTRAINTS_free(constr);
@@ -452,7 +571,7 @@ void X509::ParseSAN(X509_EXTENSION* ext)
 
 	sanExt->Assign(4, otherfields);
 
-	event_mgr.Enqueue(x509_ext_subject_alternative_name, GetFile()->ToVal(), std::move(sanExt));
+	EnqueueFileEvent(x509_ext_subject_alternative_name, {std::move(sanExt)});
 	GENERAL_NAMES_free(altname);
 	}
 
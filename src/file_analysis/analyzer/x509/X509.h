@@ -128,6 +128,21 @@ public:
 		cache_hit_callback = std::move(func);
 		}
 
+	/**
+	 * Sets the maximum number of certificates kept in the analyzer's native
+	 * cache, which is keyed by the SHA256 of their DER encoding. For a
+	 * certificate found in it, the analyzer skips parsing and the
+	 * script-level cache, and instead replays the events raised for its
+	 * first copy. The least recently seen certificates are evicted first.
+	 * Zero disables the cache.
+	 */
+	static void SetNativeCacheSize(size_t n);
+
+	/**
+	 * Empties and disables the native certificate cache.
+	 */
+	static void FreeNativeCache();
+
 protected:
 	X509(RecordValPtr args, file_analysis::File* file);
 
@@ -145,6 +160,9 @@ private:
 	inline static std::map<Val*, X509_STORE*> x509_stores = std::map<Val*, X509_STORE*>();
 	inline static TableValPtr certificate_cache = nullptr;
 	inline static FuncPtr cache_hit_callback = nullptr;
+
+	class CertificateCache;
+	inline static CertificateCache* native_cache = nullptr;
 	};
 
 /**
@@ -294,14 +294,23 @@ void X509Common::ParseExtension(X509_EXTENSION* ex, const EventHandlerPtr& h, bo
 	// but I am not sure if there is a better way to do it...
 
 	if ( h == ocsp_extension )
-		event_mgr.Enqueue(h, GetFile()->ToVal(), std::move(pX509Ext), val_mgr->Bool(global));
+		EnqueueFileEvent(h, {std::move(pX509Ext), val_mgr->Bool(global)});
 	else
-		event_mgr.Enqueue(h, GetFile()->ToVal(), std::move(pX509Ext));
+		EnqueueFileEvent(h, {std::move(pX509Ext)});
 
 	// let individual analyzers parse more.
 	ParseExtensionsSpecific(ex, global, ext_asn, oid);
 	}
 
+void X509Common::EnqueueFileEvent(const EventHandlerPtr& h, Args args)
+	{
+	if ( recorded_events )
+		recorded_events->emplace_back(h, args);
+
+	args.insert(args.begin(), GetFile()->ToVal());
+	event_mgr.Enqueue(h, std::move(args));
+	}
+
 StringValPtr X509Common::GetExtensionFromBIO(BIO* bio, file_analysis::File* f)
 	{
 	BIO_flush(bio);
@@ -7,13 +7,16 @@
 
 #include <openssl/asn1.h>
 #include <openssl/x509.h>
+#include <utility>
+#include <vector>
 
+#include "zeek/EventHandler.h"
+#include "zeek/ZeekArgs.h"
 #include "zeek/file_analysis/Analyzer.h"
 
 namespace zeek
 	{
 
-class EventHandlerPtr;
 class Reporter;
 class StringVal;
 template <class T> class IntrusivePtr;
@@ -30,6 +33,9 @@ namespace detail
 class X509Common : public file_analysis::Analyzer
 	{
 public:
+	// Events raised by an analyzer, without their file argument.
+	using RecordedEvents = std::vector<std::pair<EventHandlerPtr, Args>>;
+
 	~X509Common() override{};
 
 	/**
@@ -48,12 +54,26 @@ public:
 	static double GetTimeFromAsn1(const ASN1_TIME* atime, file_analysis::File* f,
 	                              Reporter* reporter);
 
+	/**
+	 * Raises an event with the analyzer's file as its first argument,
+	 * followed by \a args. While the analyzer is recording events, the
+	 * event is also remembered for replaying it later.
+	 *
+	 * @param h the event to raise.
+	 *
+	 * @param args the event's arguments, excluding the file.
+	 */
+	void EnqueueFileEvent(const EventHandlerPtr& h, Args args);
+
 protected:
 	X509Common(const zeek::Tag& arg_tag, RecordValPtr arg_args, file_analysis::File* arg_file);
 
 	void ParseExtension(X509_EXTENSION* ex, const EventHandlerPtr& h, bool global);
 	void ParseSignedCertificateTimestamps(X509_EXTENSION* ext);
 	virtual void ParseExtensionsSpecific(X509_EXTENSION* ex, bool, ASN1_OBJECT*, const char*) = 0;
+
+	// If set, EnqueueFileEvent() appends the events it raises here.
+	RecordedEvents* recorded_events = nullptr;
 	};
 
 	} // namespace detail
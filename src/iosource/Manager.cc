@@ -91,6 +91,25 @@ void Manager::InitPostScript()
 	wakeup = new WakeupHandler();
 	}
 
+void Manager::InitPostFork()
+	{
+	close(event_queue);
+	event_queue = kqueue();
+
+	if ( event_queue == -1 )
+		reporter->FatalError("Failed to initialize kqueue: %s", strerror(errno));
+
+	for ( const auto& [fd, src] : fd_map )
+		{
+		struct kevent event;
+		EV_SET(&event, fd, EVFILT_READ, EV_ADD, 0, 0, NULL);
+
+		if ( kevent(event_queue, &event, 1, NULL, 0, NULL) == -1 )
+			reporter->FatalError("Failed to register fd %d from %s: %s", fd, src->Tag(),
+			                     strerror(errno));
+		}
+	}
+
 void Manager::RemoveAll()
 	{
 	// We're cheating a bit here ...
@@ -45,6 +45,12 @@ public:
 	 */
 	void InitPostScript();
 
+	/**
+	 * Sets up a new event queue in a forked process, which can't use its
+	 * parent's, and registers the file descriptors of the parent's with it.
+	 */
+	void InitPostFork();
+
 	/**
 	 * Registers an IOSource with the manager. If the source is already
 	 * registered, the method will update its *dont_count* value but not
@@ -8,6 +8,7 @@
 
 #include "zeek/Hash.h"
 #include "zeek/RunState.h"
+#include "zeek/Stats.h"
 #include "zeek/broker/Manager.h"
 #include "zeek/iosource/BPF_Program.h"
 #include "zeek/iosource/Manager.h"
@@ -153,6 +154,9 @@ void PktSrc::Process()
 
 	run_state::detail::dispatch_packet(&current_packet, this);
 
+	if ( zeek::detail::packet_stage_profiler )
+		zeek::detail::packet_stage_profiler->EndPacket();
+
 	have_packet = false;
 	DoneWithPacket();
 	}
@@ -177,11 +181,27 @@ bool PktSrc::ExtractNextPacketInternal()
 	if ( run_state::pseudo_realtime )
 		run_state::detail::current_wallclock = util::current_time(true);
 
-	if ( ExtractNextPacket(&current_packet) )
+	if ( zeek::detail::packet_stage_profiler )
+		zeek::detail::packet_stage_profiler->BeginPacket();
+
+	bool have_next;
+
+		{
+		zeek::detail::PacketStageProfiler::Sample
+			stage_sample(zeek::detail::packet_stage_profiler,
+		                 zeek::detail::PacketStageProfiler::CAPTURE);
+		have_next = ExtractNextPacket(&current_packet);
+		}
+
+	if ( have_next )
 		{
 		if ( current_packet.time < 0 )
 			{
 			Weird("negative_packet_timestamp", &current_packet);
+
+			if ( zeek::detail::packet_stage_profiler )
+				zeek::detail::packet_stage_profiler->CancelPacket();
+
 			return false;
 			}
 
@@ -192,6 +212,9 @@ bool PktSrc::ExtractNextPacketInternal()
 		return true;
 		}
 
+	if ( zeek::detail::packet_stage_profiler )
+		zeek::detail::packet_stage_profiler->CancelPacket();
+
 	if ( run_state::pseudo_realtime && ! IsOpen() )
 		{
 		if ( broker_mgr->Active() )
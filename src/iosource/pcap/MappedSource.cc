@@ -0,0 +1,812 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/iosource/pcap/MappedSource.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "zeek/Event.h"
+#include "zeek/Reporter.h"
+#include "zeek/iosource/BPF_Program.h"
+#include "zeek/iosource/Packet.h"
+#include "zeek/iosource/pcap/pcap.bif.h"
+
+namespace zeek::iosource::pcap
+	{
+
+// Size of the blocks the decompressor produces, and how many of them it
+// buffers ahead of the reader.
+constexpr size_t DECOMPRESS_BLOCK_SIZE = 1024 * 1024;
+constexpr size_t DECOMPRESS_MAX_BLOCKS = 8;
+
+// Size of the windows for which the mapping gets read-ahead and
+// drop-behind hints.
+constexpr size_t READAHEAD_SIZE = 16 * 1024 * 1024;
+
+// Largest capture length accepted, the same as libpcap's.
+constexpr uint32_t MAX_SNAPLEN = 262144;
+
+constexpr uint32_t PCAPNG_SECTION_HEADER = 0x0A0D0D0A;
+constexpr uint32_t PCAPNG_BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+constexpr uint32_t PCAPNG_INTERFACE_DESCRIPTION = 1;
+constexpr uint32_t PCAPNG_OBSOLETE_PACKET = 2;
+constexpr uint32_t PCAPNG_SIMPLE_PACKET = 3;
+constexpr uint32_t PCAPNG_ENHANCED_PACKET = 6;
+constexpr uint16_t PCAPNG_OPTION_TSRESOL = 9;
+
+static uint16_t load16(const u_char* p)
+	{
+	uint16_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+	}
+
+static uint32_t load32(const u_char* p)
+	{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+	}
+
+// Trace files store LINKTYPE_ values, which match the DLT_ ones except for
+// a few that vary between platforms.
+static int linktype_to_dlt(uint32_t linktype)
+	{
+	linktype &= 0x03FFFFFF; // upper bits carry FCS information
+
+	if ( linktype == 101 ) // LINKTYPE_RAW
+		return DLT_RAW;
+
+	return static_cast<int>(linktype);
+	}
+
+namespace detail
+	{
+
+Decompressor::Decompressor(int fd)
+	{
+	gz = gzdopen(fd, "rb");
+	SetName("trace-decompressor");
+	}
+
+bool Decompressor::NextBlock(std::vector<u_char>* block)
+	{
+	std::unique_lock<std::mutex> guard(lock);
+	data_cond.wait(guard, [this] { return ! blocks.empty() || done || Killed(); });
+
+	if ( blocks.empty() )
+		return false;
+
+	*block = std::move(blocks.front());
+	blocks.pop_front();
+
+	guard.unlock();
+	space_cond.notify_one();
+	return true;
+	}
+
+std::string Decompressor::ErrorMessage()
+	{
+	std::lock_guard<std::mutex> guard(lock);
+	return error;
+	}
+
+void Decompressor::Run()
+	{
+	std::string err;
+
+	if ( ! gz )
+		err = "cannot initialize decompression";
+
+	while ( gz && ! Killed() )
+		{
+		std::vector<u_char> buf(DECOMPRESS_BLOCK_SIZE);
+		int n = gzread(static_cast<gzFile>(gz), buf.data(), buf.size());
+
+		if ( n < 0 )
+			{
+			int errnum;
+			err = gzerror(static_cast<gzFile>(gz), &errnum);
+			break;
+			}
+
+		if ( n == 0 )
+			break;
+
+		buf.resize(n);
+
+		std::unique_lock<std::mutex> guard(lock);
+		space_cond.wait(guard, [this]
+		                { return blocks.size() < DECOMPRESS_MAX_BLOCKS || stopping || Killed(); });
+
+		if ( stopping )
+			break;
+
+		blocks.push_back(std::move(buf));
+		guard.unlock();
+		data_cond.notify_one();
+		}
+
+	if ( gz )
+		gzclose(static_cast<gzFile>(gz));
+
+	gz = nullptr;
+
+	std::unique_lock<std::mutex> guard(lock);
+	error = std::move(err);
+	done = true;
+	guard.unlock();
+	data_cond.notify_all();
+	}
+
+void Decompressor::OnSignalStop()
+	{
+	std::unique_lock<std::mutex> guard(lock);
+	stopping = true;
+	guard.unlock();
+	space_cond.notify_all();
+	}
+
+void Decompressor::OnWaitForStop()
+	{
+	std::unique_lock<std::mutex> guard(lock);
+	data_cond.wait(guard, [this] { return done || Killed(); });
+	}
+
+void Decompressor::OnKill()
+	{
+	space_cond.notify_all();
+	data_cond.notify_all();
+	}
+
+	} // namespace detail
+
+MappedPcapSource::MappedPcapSource(const std::string& path, bool is_live)
+	{
+	props.path = path;
+	props.is_live = is_live;
+	}
+
+MappedPcapSource::~MappedPcapSource()
+	{
+	Close();
+	}
+
+void MappedPcapSource::Open()
+	{
+	if ( props.is_live )
+		{
+		Error("memory-mapped packet source supports only trace files");
+		return;
+		}
+
+	fd = open(props.path.c_str(), O_RDONLY);
+
+	if ( fd < 0 )
+		{
+		Error(util::fmt("%s: %s", props.path.c_str(), strerror(errno)));
+		return;
+		}
+
+	struct stat st;
+	u_char magic[4];
+
+	if ( fstat(fd, &st) < 0 || pread(fd, magic, sizeof(magic), 0) != sizeof(magic) )
+		{
+		FormatError("cannot read file header");
+		return;
+		}
+
+	if ( magic[0] == 0x1f && magic[1] == 0x8b )
+		{
+		int gz_fd = dup(fd);
+
+		if ( gz_fd < 0 )
+			{
+			FormatError(strerror(errno));
+			return;
+			}
+
+		decompressor = new detail::Decompressor(gz_fd);
+		decompressor->Start();
+		}
+
+	else if ( magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd )
+		{
+		FormatError("zstd-compressed trace files are not supported");
+		return;
+		}
+
+	else
+		{
+		map_size = st.st_size;
+		void* m = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if ( m == MAP_FAILED )
+			{
+			FormatError(strerror(errno));
+			return;
+			}
+
+		map = static_cast<const u_char*>(m);
+		madvise(m, map_size, MADV_SEQUENTIAL);
+		madvise(m, std::min(map_size, 2 * READAHEAD_SIZE), MADV_WILLNEED);
+		next_advice = READAHEAD_SIZE;
+		}
+
+	if ( ! ReadFileHeader() )
+		return;
+
+	props.selectable_fd = fd;
+	props.netmask = NETMASK_UNKNOWN;
+	props.is_live = false;
+
+	Opened(props);
+	}
+
+void MappedPcapSource::Close()
+	{
+	if ( fd < 0 )
+		return;
+
+	if ( map )
+		munmap(const_cast<u_char*>(map), map_size);
+
+	if ( decompressor )
+		{
+		// The threading manager deletes it at termination.
+		decompressor->SignalStop();
+		decompressor->WaitForStop();
+		}
+
+	close(fd);
+
+	fd = -1;
+	map = nullptr;
+	map_size = 0;
+	decompressor = nullptr;
+	block.clear();
+	block_offset = 0;
+
+	// Opening may have failed after getting the file.
+	if ( ! IsOpen() )
+		return;
+
+	Closed();
+
+	if ( Pcap::file_done )
+		event_mgr.Enqueue(Pcap::file_done, make_intrusive<StringVal>(props.path));
+	}
+
+const u_char* MappedPcapSource::Read(size_t n)
+	{
+	if ( map )
+		{
+		if ( map_size - offset < n )
+			return nullptr;
+
+		const u_char* p = map + offset;
+		offset += n;
+
+		if ( offset >= next_advice )
+			Advise();
+
+		return p;
+		}
+
+	while ( block.size() - block_offset < n )
+		{
+		std::vector<u_char> next;
+
+		if ( ! decompressor || ! decompressor->NextBlock(&next) )
+			return nullptr;
+
+		if ( block_offset < block.size() )
+			{
+			// Keep the partial record at the end of the current block.
+			std::vector<u_char> joined(block.begin() + block_offset, block.end());
+			joined.insert(joined.end(), next.begin(), next.end());
+			block = std::move(joined);
+			}
+		else
+			block = std::move(next);
+
+		block_offset = 0;
+		}
+
+	const u_char* p = block.data() + block_offset;
+	block_offset += n;
+	return p;
+	}
+
+bool MappedPcapSource::Exhausted() const
+	{
+	if ( map )
+		return offset == map_size;
+
+	return block_offset == block.size();
+	}
+
+void MappedPcapSource::Advise()
+	{
+	// Have the kernel read the window after the one just entered, and
+	// drop the one before the previous, which we're done with.
+	u_char* base = const_cast<u_char*>(map);
+	size_t ahead = next_advice + READAHEAD_SIZE;
+
+	if ( ahead < map_size )
+		madvise(base + ahead, std::min(READAHEAD_SIZE, map_size - ahead), MADV_WILLNEED);
+
+	if ( next_advice >= 2 * READAHEAD_SIZE )
+		madvise(base + next_advice - 2 * READAHEAD_SIZE, READAHEAD_SIZE, MADV_DONTNEED);
+
+	next_advice += READAHEAD_SIZE;
+	}
+
+void MappedPcapSource::FormatError(const char* msg)
+	{
+	if ( IsOpen() )
+		reporter->Error("failed to read a packet from %s: %s", props.path.c_str(), msg);
+	else
+		Error(util::fmt("%s: %s", props.path.c_str(), msg));
+
+	Close();
+	}
+
+bool MappedPcapSource::ReadFileHeader()
+	{
+	const u_char* p = Read(4);
+
+	if ( ! p )
+		{
+		FormatError("truncated file header");
+		return false;
+		}
+
+	uint32_t magic = load32(p);
+
+	if ( magic == PCAPNG_SECTION_HEADER )
+		{
+		pcapng = true;
+
+		if ( ! ReadSectionHeader() )
+			return false;
+
+		// The link type to report comes from the first interface.
+		while ( interfaces.empty() )
+			{
+			pcap_pkthdr hdr;
+			const u_char* data;
+			int link_type;
+			bool is_packet;
+
+			if ( ! ReadPcapngBlock(&hdr, &data, &link_type, &is_packet) )
+				{
+				if ( fd >= 0 )
+					FormatError("no interface description");
+
+				return false;
+				}
+			}
+
+		props.link_type = interfaces[0].link_type;
+		return true;
+		}
+
+	switch ( magic )
+		{
+		case 0xa1b2c3d4:
+			break;
+		case 0xd4c3b2a1:
+			swapped = true;
+			break;
+		case 0xa1b23c4d:
+			nanoseconds = true;
+			break;
+		case 0x4d3cb2a1:
+			swapped = nanoseconds = true;
+			break;
+		default:
+			FormatError("unknown file format");
+			return false;
+		}
+
+	// Version, time zone, accuracy, snaplen and link type.
+	p = Read(20);
+
+	if ( ! p )
+		{
+		FormatError("truncated file header");
+		return false;
+		}
+
+	props.link_type = linktype_to_dlt(Swap32(load32(p + 16)));
+	return true;
+	}
+
+bool MappedPcapSource::ReadSectionHeader()
+	{
+	// The block type has been read already.
+	const u_char* p = Read(8);
+
+	if ( ! p )
+		{
+		FormatError("truncated section header");
+		return false;
+		}
+
+	uint32_t len = load32(p);
+	uint32_t byte_order = load32(p + 4);
+
+	if ( byte_order == PCAPNG_BYTE_ORDER_MAGIC )
+		swapped = false;
+	else if ( byte_order == __builtin_bswap32(PCAPNG_BYTE_ORDER_MAGIC) )
+		swapped = true;
+	else
+		{
+		FormatError("invalid section header");
+		return false;
+		}
+
+	len = Swap32(len);
+
+	if ( len < 28 || len % 4 != 0 || ! Read(len - 12) )
+		{
+		FormatError("invalid section header");
+		return false;
+		}
+
+	// Interface IDs are local to their section.
+	interfaces.clear();
+	return true;
+	}
+
+bool MappedPcapSource::ReadInterface(const u_char* body, uint32_t len)
+	{
+	if ( len < 8 )
+		{
+		FormatError("invalid interface description");
+		return false;
+		}
+
+	Interface iface{linktype_to_dlt(Swap16(load16(body))), 1000000};
+
+	// Look for the timestamp resolution among the options.
+	for ( uint32_t i = 8; i + 4 <= len; )
+		{
+		uint16_t code = Swap16(load16(body + i));
+		uint16_t olen = Swap16(load16(body + i + 2));
+
+		if ( code == 0 || i + 4 + olen > len )
+			break;
+
+		if ( code == PCAPNG_OPTION_TSRESOL && olen >= 1 )
+			{
+			u_char res = body[i + 4];
+			u_char exp = res & 0x7f;
+
+			if ( (res & 0x80) ? exp > 63 : exp > 19 )
+				{
+				FormatError("unsupported timestamp resolution");
+				return false;
+				}
+
+			if ( res & 0x80 )
+				iface.ticks_per_second = uint64_t(1) << exp;
+			else
+				{
+				iface.ticks_per_second = 1;
+
+				for ( int j = 0; j < exp; ++j )
+					iface.ticks_per_second *= 10;
+				}
+			}
+
+		i += 4 + ((olen + 3) & ~3);
+		}
+
+	interfaces.push_back(iface);
+	return true;
+	}
+
+bool MappedPcapSource::ReadPcapRecord(pcap_pkthdr* hdr, const u_char** data, int* link_type)
+	{
+	const u_char* p = Read(16);
+
+	if ( ! p )
+		{
+		if ( ! Exhausted() )
+			FormatError("truncated packet header");
+
+		return false;
+		}
+
+	hdr->ts.tv_sec = Swap32(load32(p));
+	hdr->ts.tv_usec = Swap32(load32(p + 4));
+	hdr->caplen = Swap32(load32(p + 8));
+	hdr->len = Swap32(load32(p + 12));
+
+	if ( nanoseconds )
+		hdr->ts.tv_usec /= 1000;
+
+	if ( hdr->caplen > MAX_SNAPLEN )
+		{
+		FormatError("invalid capture length");
+		return false;
+		}
+
+	*data = Read(hdr->caplen);
+
+	if ( ! *data )
+		{
+		FormatError("truncated packet");
+		return false;
+		}
+
+	*link_type = props.link_type;
+	return true;
+	}
+
+bool MappedPcapSource::ReadPcapngBlock(pcap_pkthdr* hdr, const u_char** data, int* link_type,
+                                       bool* is_packet)
+	{
+	*is_packet = false;
+
+	const u_char* p = Read(4);
+
+	if ( ! p )
+		{
+		if ( ! Exhausted() )
+			FormatError("truncated block header");
+
+		return false;
+		}
+
+	uint32_t raw_type = load32(p);
+
+	if ( raw_type == PCAPNG_SECTION_HEADER )
+		return ReadSectionHeader();
+
+	p = Read(4);
+
+	if ( ! p )
+		{
+		FormatError("truncated block header");
+		return false;
+		}
+
+	uint32_t type = Swap32(raw_type);
+	uint32_t len = Swap32(load32(p));
+
+	if ( len < 12 || len % 4 != 0 )
+		{
+		FormatError("invalid block length");
+		return false;
+		}
+
+	// The body, followed by the repeated block length.
+	const u_char* body = Read(len - 8);
+
+	if ( ! body )
+		{
+		FormatError("truncated block");
+		return false;
+		}
+
+	uint32_t body_len = len - 12;
+	uint32_t interface_id = 0;
+	uint64_t ts = 0;
+	uint32_t data_offset;
+
+	switch ( type )
+		{
+		case PCAPNG_INTERFACE_DESCRIPTION:
+			return ReadInterface(body, body_len);
+
+		case PCAPNG_ENHANCED_PACKET:
+		case PCAPNG_OBSOLETE_PACKET:
+			if ( body_len < 20 )
+				{
+				FormatError("invalid packet block");
+				return false;
+				}
+
+			if ( type == PCAPNG_ENHANCED_PACKET )
+				interface_id = Swap32(load32(body));
+			else
+				interface_id = Swap16(load16(body));
+
+			ts = (uint64_t(Swap32(load32(body + 4))) << 32) | Swap32(load32(body + 8));
+			hdr->caplen = Swap32(load32(body + 12));
+			hdr->len = Swap32(load32(body + 16));
+			data_offset = 20;
+			break;
+
+		case PCAPNG_SIMPLE_PACKET:
+			if ( body_len < 4 )
+				{
+				FormatError("invalid packet block");
+				return false;
+				}
+
+			hdr->len = Swap32(load32(body));
+			hdr->caplen = std::min(hdr->len, body_len - 4);
+			data_offset = 4;
+			break;
+
+		default:
+			// Other blocks don't matter to us.
+			return true;
+		}
+
+	if ( interface_id >= interfaces.size() )
+		{
+		FormatError("packet for unknown interface");
+		return false;
+		}
+
+	if ( hdr->caplen > body_len - data_offset || hdr->caplen > MAX_SNAPLEN )
+		{
+		FormatError("invalid capture length");
+		return false;
+		}
+
+	const auto& iface = interfaces[interface_id];
+	uint64_t frac = ts % iface.ticks_per_second;
+
+	hdr->ts.tv_sec = ts / iface.ticks_per_second;
+	hdr->ts.tv_usec = static_cast<suseconds_t>(static_cast<double>(frac) * 1000000 /
+	                                           iface.ticks_per_second);
+
+	*data = body + data_offset;
+	*link_type = iface.link_type;
+	*is_packet = true;
+	return true;
+	}
+
+bool MappedPcapSource::ExtractNextPacket(Packet* pkt)
+	{
+	if ( fd < 0 )
+		return false;
+
+	pcap_pkthdr hdr;
+	const u_char* data;
+	int link_type;
+
+	while ( true )
+		{
+		bool ok;
+
+		if ( pcapng )
+			{
+			bool is_packet;
+			ok = ReadPcapngBlock(&hdr, &data, &link_type, &is_packet);
+
+			if ( ok && ! is_packet )
+				continue;
+			}
+		else
+			ok = ReadPcapRecord(&hdr, &data, &link_type);
+
+		if ( ! ok )
+			{
+			// Exhausted the file, or it's broken.
+			if ( fd >= 0 && decompressor )
+				{
+				auto err = decompressor->ErrorMessage();
+
+				if ( ! err.empty() )
+					reporter->Error("failed to read a packet from %s: %s", props.path.c_str(),
+					                err.c_str());
+				}
+
+			Close();
+			return false;
+			}
+
+		if ( filter && ! MatchesFilter(link_type, &hdr, data) )
+			continue;
+
+		break;
+		}
+
+	pkt->Init(link_type, &hdr.ts, hdr.caplen, hdr.len, data);
+
+	if ( hdr.len == 0 || hdr.caplen == 0 )
+		{
+		Weird("empty_pcap_header", pkt);
+		return false;
+		}
+
+	++stats.received;
+	stats.bytes_received += hdr.len;
+
+	return true;
+	}
+
+void MappedPcapSource::DoneWithPacket()
+	{
+	// Nothing to do, the data stays valid until the next read.
+	}
+
+bool MappedPcapSource::MatchesFilter(int link_type, const pcap_pkthdr* hdr, const u_char* data)
+	{
+	if ( link_type == props.link_type )
+		return pcap_offline_filter(filter, hdr, data);
+
+	// NFLOG does not support BPF filters, see PcapSource::SetFilter().
+	if ( link_type == DLT_NFLOG )
+		return true;
+
+	// The interfaces of a pcapng file may differ in link type, while the
+	// filter got compiled for the first one's.
+	auto it = link_type_filters.find(link_type);
+
+	if ( it == link_type_filters.end() )
+		{
+		auto code = std::make_unique<iosource::detail::BPF_Program>();
+		char errbuf[PCAP_ERRBUF_SIZE];
+
+		if ( ! code->Compile(BifConst::Pcap::snaplen, link_type, filter_expr.c_str(), Netmask(),
+		                     errbuf, sizeof(errbuf)) )
+			{
+			reporter->Warning("cannot compile BPF filter \"%s\" for link type %d in %s, "
+			                  "dropping its packets: %s",
+			                  filter_expr.c_str(), link_type, props.path.c_str(), errbuf);
+			code = nullptr;
+			}
+
+		it = link_type_filters.emplace(link_type, std::move(code)).first;
+		}
+
+	return it->second && pcap_offline_filter(it->second->GetProgram(), hdr, data);
+	}
+
+bool MappedPcapSource::PrecompileFilter(int index, const std::string& filter)
+	{
+	if ( ! PktSrc::PrecompileBPFFilter(index, filter) )
+		return false;
+
+	filter_exprs[index] = filter;
+	return true;
+	}
+
+bool MappedPcapSource::SetFilter(int index)
+	{
+	iosource::detail::BPF_Program* code = GetBPFFilter(index);
+
+	if ( ! code )
+		{
+		Error(util::fmt("No precompiled pcap filter for index %d", index));
+		return false;
+		}
+
+	// NFLOG does not support BPF filters, see PcapSource::SetFilter().
+	if ( LinkType() != DLT_NFLOG )
+		filter = code->GetProgram();
+
+	filter_expr = filter_exprs[index];
+	link_type_filters.clear();
+
+	return true;
+	}
+
+void MappedPcapSource::Statistics(Stats* s)
+	{
+	s->received = stats.received;
+	s->bytes_received = stats.bytes_received;
+	s->dropped = s->link = 0;
+	}
+
+iosource::PktSrc* MappedPcapSource::Instantiate(const std::string& path, bool is_live)
+	{
+	return new MappedPcapSource(path, is_live);
+	}
+
+	} // namespace zeek::iosource::pcap
@@ -0,0 +1,163 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <sys/types.h> // for u_char
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+extern "C"
+	{
+#include <pcap.h>
+	}
+
+#include "zeek/iosource/PktSrc.h"
+#include "zeek/threading/BasicThread.h"
+
+namespace zeek::iosource::pcap
+	{
+
+namespace detail
+	{
+
+/**
+ * A thread decompressing a gzip-compressed trace file ahead of the packet
+ * source reading it. Decompressed data is handed over in blocks, of which
+ * only a limited number is buffered.
+ */
+class Decompressor final : public threading::BasicThread
+	{
+public:
+	/**
+	 * Constructor. The decompressor takes ownership of the file descriptor.
+	 */
+	explicit Decompressor(int fd);
+
+	/**
+	 * Returns the next block of decompressed data, blocking until it's
+	 * available.
+	 * @param block receives the data.
+	 * @return false at the end of the data, including after an error.
+	 */
+	bool NextBlock(std::vector<u_char>* block);
+
+	/**
+	 * Returns a description of the error that ended decompression, or an
+	 * empty string if there was none.
+	 */
+	std::string ErrorMessage();
+
+protected:
+	void Run() override;
+	void OnSignalStop() override;
+	void OnWaitForStop() override;
+	void OnKill() override;
+
+private:
+	void* gz;
+
+	std::mutex lock;
+	std::condition_variable data_cond;
+	std::condition_variable space_cond;
+	std::deque<std::vector<u_char>> blocks;
+	std::string error;
+	bool done = false;
+	bool stopping = false;
+	};
+
+	} // namespace detail
+
+/**
+ * A packet source reading pcap and pcapng trace files through a memory
+ * mapping, handing out packets that point directly into it. Traces
+ * compressed with gzip are decompressed by a separate thread instead.
+ */
+class MappedPcapSource : public PktSrc
+	{
+public:
+	MappedPcapSource(const std::string& path, bool is_live);
+	~MappedPcapSource() override;
+
+	static PktSrc* Instantiate(const std::string& path, bool is_live);
+
+protected:
+	// PktSrc interface.
+	void Open() override;
+	void Close() override;
+	bool ExtractNextPacket(Packet* pkt) override;
+	void DoneWithPacket() override;
+	bool PrecompileFilter(int index, const std::string& filter) override;
+	bool SetFilter(int index) override;
+	void Statistics(Stats* stats) override;
+
+private:
+	// Returns the next n bytes of the file and moves past them, or null
+	// if fewer remain. The data remains valid until the next call.
+	const u_char* Read(size_t n);
+
+	// Returns true if all of the file has been read.
+	bool Exhausted() const;
+
+	// Gives the kernel read-ahead and drop-behind hints for the mapping.
+	void Advise();
+
+	uint16_t Swap16(uint16_t v) const { return swapped ? __builtin_bswap16(v) : v; }
+	uint32_t Swap32(uint32_t v) const { return swapped ? __builtin_bswap32(v) : v; }
+
+	bool ReadFileHeader();
+	bool ReadPcapRecord(pcap_pkthdr* hdr, const u_char** data, int* link_type);
+	bool ReadPcapngBlock(pcap_pkthdr* hdr, const u_char** data, int* link_type, bool* is_packet);
+	bool ReadSectionHeader();
+	bool ReadInterface(const u_char* body, uint32_t len);
+
+	// Applies the current filter to a packet of the given link type.
+	bool MatchesFilter(int link_type, const pcap_pkthdr* hdr, const u_char* data);
+
+	// Reports a problem with the file, while opening or reading it.
+	void FormatError(const char* msg);
+
+	Properties props;
+	Stats stats;
+
+	int fd = -1;
+
+	// The mapped file, for uncompressed traces.
+	const u_char* map = nullptr;
+	size_t map_size = 0;
+	size_t offset = 0;
+	size_t next_advice = 0;
+
+	// The decompressor and the current block of its data, for
+	// compressed traces.
+	detail::Decompressor* decompressor = nullptr;
+	std::vector<u_char> block;
+	size_t block_offset = 0;
+
+	bool pcapng = false;
+	bool swapped = false;
+	bool nanoseconds = false;
+
+	struct Interface
+		{
+		int link_type;
+		uint64_t ticks_per_second;
+		};
+
+	std::vector<Interface> interfaces; // for pcapng
+
+	bpf_program* filter = nullptr;
+
+	// The filters' expressions by index, and the current filter compiled
+	// for link types other than the file's first one. Link types it
+	// doesn't compile for map to null, and their packets get dropped.
+	std::map<int, std::string> filter_exprs;
+	std::string filter_expr;
+	std::map<int, std::unique_ptr<iosource::detail::BPF_Program>> link_type_filters;
+	};
+
+	} // namespace zeek::iosource::pcap
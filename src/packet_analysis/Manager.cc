@@ -96,6 +96,8 @@ void Manager::ProcessPacket(Packet* packet)
 #endif
 
 	zeek::detail::SegmentProfiler prof(detail::segment_logger, "dispatching-packet");
+	zeek::detail::PacketStageProfiler::Sample stage_sample(zeek::detail::packet_stage_profiler,
+	                                                       zeek::detail::PacketStageProfiler::DISPATCH);
 	if ( pkt_profiler )
 		pkt_profiler->ProfilePkt(zeek::run_state::processing_start_time, packet->cap_len);
 
@@ -111,6 +113,9 @@ void Manager::ProcessPacket(Packet* packet)
 	// Start packet analysis
 	root_analyzer->ForwardPacket(packet->cap_len, packet->data, packet, packet->link_type);
 
+	if ( zeek::detail::packet_stage_profiler )
+		zeek::detail::packet_stage_profiler->SetProtocol(packet);
+
 	if ( ! packet->processed )
 		{
 		if ( packet_not_processed )
@@ -9,6 +9,7 @@
 #include "zeek/IPAddr.h"
 #include "zeek/NetVar.h"
 #include "zeek/PacketFilter.h"
+#include "zeek/Reporter.h"
 #include "zeek/RunState.h"
 #include "zeek/TunnelEncapsulation.h"
 #include "zeek/packet_analysis/protocol/ip/IPBasedAnalyzer.h"
@@ -16,8 +17,42 @@
 
 using namespace zeek::packet_analysis::IP;
 
+// The repeating 0x6d5a pattern makes the Toeplitz hash symmetric with
+// regard to swapping source and destination.
+static constexpr uint8_t symmetric_rss_key[40] = {
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+};
+
+static uint32_t toeplitz_hash(const uint8_t* input, size_t len)
+	{
+	uint32_t result = 0;
+	uint32_t window = (symmetric_rss_key[0] << 24) | (symmetric_rss_key[1] << 16) |
+	                  (symmetric_rss_key[2] << 8) | symmetric_rss_key[3];
+
+	for ( size_t i = 0; i < len; ++i )
+		{
+		uint8_t next_key = i + 4 < sizeof(symmetric_rss_key) ? symmetric_rss_key[i + 4] : 0;
+
+		for ( int bit = 7; bit >= 0; --bit )
+			{
+			if ( input[i] & (1 << bit) )
+				result ^= window;
+
+			window = (window << 1) | ((next_key >> bit) & 1);
+			}
+		}
+
+	return result;
+	}
+
 IPAnalyzer::IPAnalyzer() : zeek::packet_analysis::Analyzer("IP")
 	{
+	if ( BifConst::Sharding::num_shards > 1 &&
+	     BifConst::Sharding::shard_index >= BifConst::Sharding::num_shards )
+		reporter->FatalError("Sharding::shard_index must be less than Sharding::num_shards");
+
 	discarder = new detail::Discarder();
 	if ( ! discarder->IsActive() )
 		{
@@ -142,6 +177,16 @@ bool IPAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* packet)
 	if ( packet_filter && packet_filter->Match(packet->ip_hdr, total_len, len) )
 		return false;
 
+	// When sharding, leave flows of other shards alone. Tunneled packets
+	// follow their outermost header.
+	if ( BifConst::Sharding::num_shards > 1 && (! packet->encap || packet->encap->Depth() == 0) )
+		{
+		uint32_t hash = FlowHash(*packet->ip_hdr, len, BifConst::Sharding::use_ports);
+
+		if ( hash % BifConst::Sharding::num_shards != BifConst::Sharding::shard_index )
+			return false;
+		}
+
 	if ( ! packet->l2_checksummed && ! detail::ignore_checksums && ip4 &&
 	     ! IPBasedAnalyzer::GetIgnoreChecksumsNets()->Contains(packet->ip_hdr->IPHeaderSrcAddr()) &&
 	     detail::in_cksum(reinterpret_cast<const uint8_t*>(ip4), ip_hdr_len) != 0xffff )
@@ -173,6 +218,11 @@ bool IPAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* packet)
 			{
 			f = detail::fragment_mgr->NextFragment(run_state::processing_start_time, packet->ip_hdr,
 			                                       packet->data + hdr_size);
+
+			if ( ! f )
+				// The reassembly failed and got abandoned.
+				return true;
+
 			std::shared_ptr<IP_Hdr> ih = f->ReassembledPkt();
 
 			if ( ! ih )
@@ -188,17 +238,17 @@ bool IPAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* packet)
 			len = total_len = packet->ip_hdr->TotalLen();
 			ip_hdr_len = packet->ip_hdr->HdrLen();
 			packet->cap_len = total_len + hdr_size;
-
-			if ( ip_hdr_len > total_len )
-				{
-				Weird("invalid_IP_header_size", packet);
-				return false;
-				}
 			}
 		}
 
 	detail::FragReassemblerTracker frt(f);
 
+	if ( f && ip_hdr_len > total_len )
+		{
+		Weird("invalid_IP_header_size", packet);
+		return false;
+		}
+
 	// We stop building the chain when seeing IPPROTO_ESP so if it's
 	// there, it's always the last.
 	if ( packet->ip_hdr->LastHeader() == IPPROTO_ESP )
@@ -319,3 +369,31 @@ int zeek::packet_analysis::IP::ParsePacket(int caplen, const u_char* const pkt,
 
 	return 0;
 	}
+
+uint32_t zeek::packet_analysis::IP::FlowHash(const IP_Hdr& ip, size_t caplen, bool use_ports)
+	{
+	// Addresses of both families, followed by the ports, laid out as the
+	// RSS input of the respective family.
+	uint8_t input[36];
+	size_t addr_len = ip.IP4_Hdr() ? 4 : 16;
+	const uint32_t* bytes;
+
+	ip.SrcAddr().GetBytes(&bytes);
+	memcpy(input, bytes, addr_len);
+	ip.DstAddr().GetBytes(&bytes);
+	memcpy(input + addr_len, bytes, addr_len);
+
+	size_t len = 2 * addr_len;
+	int proto = ip.NextProto();
+
+	if ( use_ports && ! ip.IsFragment() &&
+	     (proto == IPPROTO_TCP || proto == IPPROTO_UDP) &&
+	     ip.HdrLen() + 4 <= caplen )
+		{
+		// Source and destination port lead both headers.
+		memcpy(input + len, ip.Payload(), 4);
+		len += 4;
+		}
+
+	return toeplitz_hash(input, len);
+	}
@@ -58,4 +58,18 @@ private:
  *         for other return values.
  */
 int ParsePacket(int caplen, const u_char* const pkt, int proto, std::shared_ptr<IP_Hdr>& inner);
+
+/**
+ * Computes a hash of the flow an IP packet belongs to that's the same for
+ * both of its directions. This uses the Toeplitz function with the
+ * symmetric key common for NIC receive-side scaling, so that the result
+ * is the same across processes and platforms.
+ *
+ * @param ip The packet's IP header.
+ * @param caplen The number of captured bytes starting at the IP header.
+ * @param use_ports Whether to include TCP and UDP ports in the hash.
+ *        Ports are left out for fragments regardless.
+ * @return The hash value.
+ */
+uint32_t FlowHash(const IP_Hdr& ip, size_t caplen, bool use_ports);
 	}
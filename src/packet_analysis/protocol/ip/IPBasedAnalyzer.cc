@@ -4,6 +4,7 @@
 
 #include "zeek/Conn.h"
 #include "zeek/RunState.h"
+#include "zeek/Stats.h"
 #include "zeek/Val.h"
 #include "zeek/analyzer/Manager.h"
 #include "zeek/analyzer/protocol/pia/PIA.h"
@@ -35,7 +36,14 @@ bool IPBasedAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* pkt
 	const std::shared_ptr<IP_Hdr>& ip_hdr = pkt->ip_hdr;
 	detail::ConnKey key(tuple);
 
-	Connection* conn = session_mgr->FindConnection(key);
+	Connection* conn;
+
+		{
+		zeek::detail::PacketStageProfiler::Sample
+			stage_sample(zeek::detail::packet_stage_profiler,
+		                 zeek::detail::PacketStageProfiler::SESSION_LOOKUP);
+		conn = session_mgr->FindConnection(key);
+		}
 
 	if ( ! conn )
 		{
@@ -96,7 +104,14 @@ bool IPBasedAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* pkt
 	if ( conn->GetSessionAdapter()->Skipping() )
 		return true;
 
-	DeliverPacket(conn, run_state::processing_start_time, is_orig, len, pkt);
+		{
+		zeek::detail::PacketStageProfiler::Sample
+			stage_sample(zeek::detail::packet_stage_profiler,
+		                 zeek::detail::PacketStageProfiler::ANALYZER_DELIVERY);
+		conn->BeginPacket();
+		DeliverPacket(conn, run_state::processing_start_time, is_orig, len, pkt);
+		conn->EndPacket();
+		}
 
 	run_state::current_timestamp = 0;
 	run_state::current_pkt = nullptr;
@@ -4,10 +4,14 @@
 
 #include <broker/data.hh>
 #include <broker/error.hh>
+#include <openssl/sha.h>
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <limits>
 
 #include "zeek/Reporter.h"
+#include "zeek/digest.h"
 #include "zeek/probabilistic/CounterVector.h"
 #include "zeek/util.h"
 
@@ -70,6 +74,13 @@ std::unique_ptr<BloomFilter> BloomFilter::Unserialize(const broker::data& data)
 		case Counting:
 			bf = std::unique_ptr<BloomFilter>(new CountingBloomFilter());
 			break;
+
+		case Blocked:
+			bf = std::unique_ptr<BloomFilter>(new BlockedBloomFilter());
+			break;
+
+		default:
+			return nullptr;
 		}
 
 	if ( ! bf->DoUnserialize((*v)[2]) )
@@ -192,6 +203,152 @@ bool BasicBloomFilter::DoUnserialize(const broker::data& data)
 	return true;
 	}
 
+BlockedBloomFilter::BlockedBloomFilter() { }
+
+BlockedBloomFilter::BlockedBloomFilter(const detail::Hasher* hasher, size_t arg_blocks)
+	: BloomFilter(hasher), blocks(std::max(arg_blocks, size_t(1)), Block{})
+	{
+	}
+
+BlockedBloomFilter::~BlockedBloomFilter() { }
+
+size_t BlockedBloomFilter::Blocks(double fp, size_t capacity)
+	{
+	size_t cells = BasicBloomFilter::M(fp, capacity);
+	return std::max((cells + BLOCK_BITS - 1) / BLOCK_BITS, size_t(1));
+	}
+
+bool BlockedBloomFilter::Empty() const
+	{
+	for ( const auto& b : blocks )
+		{
+		for ( auto w : b.words )
+			if ( w )
+				return false;
+		}
+
+	return true;
+	}
+
+void BlockedBloomFilter::Clear()
+	{
+	std::fill(blocks.begin(), blocks.end(), Block{});
+	}
+
+bool BlockedBloomFilter::Merge(const BloomFilter* other)
+	{
+	if ( typeid(*this) != typeid(*other) )
+		return false;
+
+	const BlockedBloomFilter* o = static_cast<const BlockedBloomFilter*>(other);
+
+	if ( ! hasher->Equals(o->hasher) )
+		{
+		reporter->Error("incompatible hashers in BlockedBloomFilter merge");
+		return false;
+		}
+
+	else if ( blocks.size() != o->blocks.size() )
+		{
+		reporter->Error("different number of blocks in BlockedBloomFilter merge");
+		return false;
+		}
+
+	// A flat loop over the words lets the compiler vectorize this.
+	uint64_t* dst = &blocks[0].words[0];
+	const uint64_t* src = &o->blocks[0].words[0];
+
+	for ( size_t i = 0; i < blocks.size() * WORDS; ++i )
+		dst[i] |= src[i];
+
+	return true;
+	}
+
+BlockedBloomFilter* BlockedBloomFilter::Clone() const
+	{
+	BlockedBloomFilter* copy = new BlockedBloomFilter();
+
+	copy->hasher = hasher->Clone();
+	copy->blocks = blocks;
+
+	return copy;
+	}
+
+std::string BlockedBloomFilter::InternalState() const
+	{
+	u_char buf[SHA256_DIGEST_LENGTH];
+	uint64_t digest;
+	EVP_MD_CTX* ctx = zeek::detail::hash_init(zeek::detail::Hash_SHA256);
+	zeek::detail::hash_update(ctx, blocks.data(), blocks.size() * sizeof(Block));
+	zeek::detail::hash_final(ctx, buf);
+	memcpy(&digest, buf, sizeof(digest));
+	return util::fmt("%" PRIu64, digest);
+	}
+
+void BlockedBloomFilter::Add(const zeek::detail::HashKey* key)
+	{
+	detail::Hasher::digest_vector h = hasher->Hash(key);
+	auto& block = blocks[Select(h)];
+
+	for ( size_t i = 0; i < h.size(); ++i )
+		{
+		auto bit = Bit(h[i]);
+		block.words[bit / 64] |= uint64_t(1) << (bit % 64);
+		}
+	}
+
+size_t BlockedBloomFilter::Count(const zeek::detail::HashKey* key) const
+	{
+	detail::Hasher::digest_vector h = hasher->Hash(key);
+	const auto& block = blocks[Select(h)];
+
+	for ( size_t i = 0; i < h.size(); ++i )
+		{
+		auto bit = Bit(h[i]);
+
+		if ( ! (block.words[bit / 64] & (uint64_t(1) << (bit % 64))) )
+			return 0;
+		}
+
+	return 1;
+	}
+
+broker::expected<broker::data> BlockedBloomFilter::DoSerialize() const
+	{
+	broker::vector v;
+	v.reserve(blocks.size() * WORDS);
+
+	for ( const auto& b : blocks )
+		{
+		for ( auto w : b.words )
+			v.emplace_back(static_cast<uint64_t>(w));
+		}
+
+	return {std::move(v)};
+	}
+
+bool BlockedBloomFilter::DoUnserialize(const broker::data& data)
+	{
+	auto v = broker::get_if<broker::vector>(&data);
+
+	if ( ! (v && ! v->empty() && v->size() % WORDS == 0) )
+		return false;
+
+	blocks.assign(v->size() / WORDS, Block{});
+
+	for ( size_t i = 0; i < v->size(); ++i )
+		{
+		auto w = broker::get_if<uint64_t>(&(*v)[i]);
+
+		if ( ! w )
+			return false;
+
+		blocks[i / WORDS].words[i % WORDS] = *w;
+		}
+
+	return true;
+	}
+
 CountingBloomFilter::CountingBloomFilter()
 	{
 	cells = nullptr;
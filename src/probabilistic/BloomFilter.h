@@ -28,7 +28,8 @@ class CounterVector;
 enum BloomFilterType
 	{
 	Basic,
-	Counting
+	Counting,
+	Blocked
 	};
 
 /**
@@ -191,6 +192,98 @@ private:
 	detail::BitVector* bits;
 	};
 
+/**
+ * A blocked Bloom filter (Putze et al., "Cache-, Hash- and Space-Efficient
+ * Bloom Filters", 2007). It splits its bits into blocks the size of a cache
+ * line and sets all bits of an element within a single block, so that
+ * adding and looking up an element touches only one cache line. In
+ * return, it needs somewhat more bits than a basic Bloom filter for the
+ * same false-positive rate.
+ */
+class BlockedBloomFilter : public BloomFilter
+	{
+public:
+	/**
+	 * Constructs a blocked Bloom filter with a given number of blocks. The
+	 * number of blocks for a false-positive rate can be computed with
+	 * *Blocks*.
+	 *
+	 * @param hasher The hasher to use. The first hash value selects the
+	 * block, and each hash value selects one bit within it.
+	 *
+	 * @param blocks The number of blocks.
+	 */
+	BlockedBloomFilter(const detail::Hasher* hasher, size_t blocks);
+
+	/**
+	 * Destructor.
+	 */
+	~BlockedBloomFilter() override;
+
+	/**
+	 * Computes the number of blocks based on a given false positive rate
+	 * and capacity, by rounding up the number of cells a basic Bloom
+	 * filter would need to whole blocks.
+	 *
+	 * @param fp The false positive rate.
+	 *
+	 * @param capacity The expected number of elements that will be
+	 * stored.
+	 *
+	 * Returns: The number of blocks to use, at least one.
+	 */
+	static size_t Blocks(double fp, size_t capacity);
+
+	/**
+	 * The number of bits in a block.
+	 */
+	static constexpr size_t BLOCK_BITS = 512;
+
+	// Overridden from BloomFilter.
+	bool Empty() const override;
+	void Clear() override;
+	bool Merge(const BloomFilter* other) override;
+	BlockedBloomFilter* Clone() const override;
+	std::string InternalState() const override;
+
+protected:
+	friend class BloomFilter;
+
+	/**
+	 * Default constructor.
+	 */
+	BlockedBloomFilter();
+
+	// Overridden from BloomFilter.
+	void Add(const zeek::detail::HashKey* key) override;
+	size_t Count(const zeek::detail::HashKey* key) const override;
+	broker::expected<broker::data> DoSerialize() const override;
+	bool DoUnserialize(const broker::data& data) override;
+	BloomFilterType Type() const override { return BloomFilterType::Blocked; }
+
+private:
+	static constexpr size_t WORDS = BLOCK_BITS / 64;
+	static_assert(BLOCK_BITS == 1 << 9, "Bit() assumes nine bits per position");
+
+	struct alignas(64) Block
+		{
+		uint64_t words[WORDS];
+		};
+
+	/**
+	 * Returns the index of the block for a set of hash values.
+	 */
+	size_t Select(const detail::Hasher::digest_vector& h) const { return h[0] % blocks.size(); }
+
+	/**
+	 * Returns the position of the bit for a hash value within its block.
+	 * This uses the upper bits, as the lower ones select the block.
+	 */
+	static size_t Bit(detail::Hasher::digest d) { return d >> (64 - 9); }
+
+	std::vector<Block> blocks;
+	};
+
 /**
  * A counting Bloom filter.
  */
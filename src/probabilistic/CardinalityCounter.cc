@@ -5,8 +5,14 @@
 #include <broker/data.hh>
 #include <math.h>
 #include <stdint.h>
+#include <algorithm>
+#include <iterator>
 #include <utility>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "zeek/Reporter.h"
 
 namespace zeek::probabilistic::detail
@@ -61,16 +67,19 @@ void CardinalityCounter::Init(uint64_t size)
 
 	p = calc_p;
 
-	buckets.reserve(m);
-	for ( uint64_t i = 0; i < m; i++ )
-		buckets.push_back(0);
-
-	assert(buckets.size() == m);
-
 	V = m;
+
+	// The sparse representation only helps while it's more precise than
+	// the buckets. Otherwise, start out with the buckets right away.
+	if ( p < SPARSE_P )
+		sparse = true;
+	else
+		buckets.assign(m, 0);
 	}
 
-CardinalityCounter::CardinalityCounter(CardinalityCounter& other) : buckets(other.buckets)
+CardinalityCounter::CardinalityCounter(CardinalityCounter& other)
+	: buckets(other.buckets), sparse(other.sparse), sparse_list(other.sparse_list),
+	  sparse_buffer(other.sparse_buffer)
 	{
 	V = other.V;
 	alpha_m = other.alpha_m;
@@ -87,6 +96,9 @@ CardinalityCounter::CardinalityCounter(CardinalityCounter&& o) noexcept
 
 	o.m = 0;
 	buckets = std::move(o.buckets);
+	sparse = o.sparse;
+	sparse_list = std::move(o.sparse_list);
+	sparse_buffer = std::move(o.sparse_buffer);
 	}
 
 CardinalityCounter::CardinalityCounter(double error_margin, double confidence)
@@ -105,11 +117,6 @@ CardinalityCounter::CardinalityCounter(uint64_t size)
 CardinalityCounter::CardinalityCounter(uint64_t arg_size, uint64_t arg_V, double arg_alpha_m)
 	{
 	m = arg_size;
-
-	buckets.reserve(m);
-	for ( uint64_t i = 0; i < m; i++ )
-		buckets.push_back(0);
-
 	alpha_m = arg_alpha_m;
 	V = arg_V;
 	p = log2(m);
@@ -126,18 +133,107 @@ uint8_t CardinalityCounter::Rank(uint64_t hash_modified) const
 	return answer;
 	}
 
-void CardinalityCounter::AddElement(uint64_t hash)
+void CardinalityCounter::Update(uint64_t index, uint8_t rank)
 	{
-	uint64_t index = hash % m;
-	hash = hash - index;
-
 	if ( buckets[index] == 0 )
 		V--;
 
-	uint8_t temp = Rank(hash);
+	if ( rank > buckets[index] )
+		buckets[index] = rank;
+	}
+
+uint32_t CardinalityCounter::EncodeSparse(uint64_t hash)
+	{
+	uint32_t index = hash & ((uint64_t(1) << SPARSE_P) - 1);
+	uint32_t rank = 64 - SPARSE_P - CardinalityCounter::flsll(hash >> SPARSE_P) + 1;
+	return (index << 6) | rank;
+	}
+
+void CardinalityCounter::AddSparseEntry(uint32_t entry)
+	{
+	uint64_t sparse_index = entry >> 6;
+	uint8_t rank = entry & 0x3f;
+	uint64_t index = sparse_index & (m - 1);
+
+	// With all bits above the sparse index zero, the rank depends on the
+	// bits between the two indices.
+	if ( rank == 64 - SPARSE_P + 1 )
+		rank = Rank(sparse_index - index);
+
+	Update(index, rank);
+	}
+
+void CardinalityCounter::MergeSparse(const std::vector<uint32_t>& entries) const
+	{
+	std::vector<uint32_t> merged;
+	merged.reserve(sparse_list.size() + entries.size());
+	std::merge(sparse_list.begin(), sparse_list.end(), entries.begin(), entries.end(),
+	           std::back_inserter(merged));
+
+	// Entries with the same index end up next to each other, ordered by
+	// rank, so the last one of each run wins.
+	size_t n = 0;
+
+	for ( auto e : merged )
+		{
+		if ( n > 0 && (merged[n - 1] >> 6) == (e >> 6) )
+			merged[n - 1] = e;
+		else
+			merged[n++] = e;
+		}
+
+	merged.resize(n);
+	sparse_list = std::move(merged);
+	}
+
+void CardinalityCounter::FlushSparse() const
+	{
+	if ( sparse_buffer.empty() )
+		return;
+
+	std::sort(sparse_buffer.begin(), sparse_buffer.end());
+	MergeSparse(sparse_buffer);
+	sparse_buffer.clear();
+	}
+
+void CardinalityCounter::ToDense()
+	{
+	FlushSparse();
+
+	sparse = false;
+	buckets.assign(m, 0);
+	V = m;
+
+	for ( auto e : sparse_list )
+		AddSparseEntry(e);
 
-	if ( temp > buckets[index] )
-		buckets[index] = temp;
+	sparse_list = {};
+	sparse_buffer = {};
+	}
+
+void CardinalityCounter::AddElement(uint64_t hash)
+	{
+	if ( sparse )
+		{
+		sparse_buffer.push_back(EncodeSparse(hash));
+
+		// Batching keeps additions cheap. The buffer takes up to a
+		// sixteenth of the memory of the buckets.
+		if ( sparse_buffer.size() >= std::max(m / 64, uint64_t(1)) )
+			{
+			FlushSparse();
+
+			// Entries take four bytes, buckets one.
+			if ( sparse_list.size() > m / 4 )
+				ToDense();
+			}
+
+		return;
+		}
+
+	// m is a power of two.
+	uint64_t index = hash & (m - 1);
+	Update(index, Rank(hash - index));
 	}
 
 /**
@@ -151,9 +247,28 @@ void CardinalityCounter::AddElement(uint64_t hash)
  **/
 double CardinalityCounter::Size() const
 	{
+	if ( sparse )
+		{
+		FlushSparse();
+
+		// Linear counting over the buckets of the sparse representation.
+		// With that many of them, it's accurate for all cardinalities the
+		// sparse representation holds.
+		double sparse_m = uint64_t(1) << SPARSE_P;
+		return -sparse_m * log1p(-(double)sparse_list.size() / sparse_m);
+		}
+
+	// The sum of 2^-rank over all buckets only depends on how many
+	// buckets there are of each rank, which saves computing a power for
+	// every single one of them. Ranks never exceed 64.
+	uint64_t counts[65] = {};
+
+	for ( auto b : buckets )
+		++counts[b];
+
 	double answer = 0;
-	for ( unsigned int i = 0; i < m; i++ )
-		answer += pow(2, -((int)buckets[i]));
+	for ( int r = 0; r <= 64; r++ )
+		answer += ldexp(counts[r], -r);
 
 	answer = 1 / answer;
 	answer = (alpha_m * m * m * answer);
@@ -173,19 +288,61 @@ bool CardinalityCounter::Merge(CardinalityCounter* c)
 	if ( m != c->GetM() )
 		return false;
 
-	const std::vector<uint8_t>& temp = c->GetBuckets();
+	if ( c->sparse )
+		{
+		c->FlushSparse();
+
+		if ( ! sparse )
+			{
+			for ( auto e : c->sparse_list )
+				AddSparseEntry(e);
+
+			return true;
+			}
+
+		FlushSparse();
+		MergeSparse(c->sparse_list);
+
+		if ( sparse_list.size() > m / 4 )
+			ToDense();
+
+		return true;
+		}
 
-	V = 0;
+	if ( sparse )
+		ToDense();
 
-	for ( size_t i = 0; i < m; i++ )
+	const uint8_t* src = c->GetBuckets().data();
+	uint8_t* dst = buckets.data();
+	uint64_t zeros = 0;
+	size_t i = 0;
+
+#ifdef __SSE2__
+	// Take the maximum of 16 buckets at a time, counting the empty ones
+	// along the way.
+	const __m128i zero = _mm_setzero_si128();
+
+	for ( ; i + 16 <= m; i += 16 )
+		{
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		__m128i merged = _mm_max_epu8(a, b);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), merged);
+		zeros += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(merged, zero)));
+		}
+#endif
+
+	for ( ; i < m; i++ )
 		{
-		if ( temp[i] > buckets[i] )
-			buckets[i] = temp[i];
+		if ( src[i] > dst[i] )
+			dst[i] = src[i];
 
-		if ( buckets[i] == 0 )
-			++V;
+		if ( dst[i] == 0 )
+			++zeros;
 		}
 
+	V = zeros;
+
 	return true;
 	}
 
@@ -201,6 +358,19 @@ uint64_t CardinalityCounter::GetM() const
 
 broker::expected<broker::data> CardinalityCounter::Serialize() const
 	{
+	if ( sparse )
+		{
+		FlushSparse();
+
+		broker::vector entries;
+		entries.reserve(sparse_list.size());
+
+		for ( auto e : sparse_list )
+			entries.emplace_back(static_cast<uint64_t>(e));
+
+		return {broker::vector{m, V, alpha_m, std::move(entries)}};
+		}
+
 	broker::vector v = {m, V, alpha_m};
 	v.reserve(3 + m);
 
@@ -222,19 +392,52 @@ std::unique_ptr<CardinalityCounter> CardinalityCounter::Unserialize(const broker
 
 	if ( ! (m && V && alpha_m) )
 		return nullptr;
-	if ( v->size() != 3 + *m )
+
+	// Buckets get indexed by masking hash values.
+	if ( *m < 16 || (*m & (*m - 1)) != 0 )
 		return nullptr;
 
 	auto cc = std::unique_ptr<CardinalityCounter>(new CardinalityCounter(*m, *V, *alpha_m));
-	if ( *m != cc->m )
-		return nullptr;
-	if ( cc->buckets.size() != *m )
+
+	if ( v->size() == 4 )
+		{
+		auto entries = broker::get_if<broker::vector>(&(*v)[3]);
+
+		if ( ! entries || cc->p >= SPARSE_P )
+			return nullptr;
+
+		cc->sparse = true;
+		cc->sparse_list.reserve(entries->size());
+
+		for ( const auto& d : *entries )
+			{
+			auto x = broker::get_if<uint64_t>(&d);
+			if ( ! x )
+				return nullptr;
+
+			auto rank = *x & 0x3f;
+			if ( *x >> (SPARSE_P + 6) || rank == 0 || rank > 64 - SPARSE_P + 1 )
+				return nullptr;
+
+			// Entries need to be sorted by index, one per index.
+			if ( ! cc->sparse_list.empty() && (cc->sparse_list.back() >> 6) >= (*x >> 6) )
+				return nullptr;
+
+			cc->sparse_list.push_back(*x);
+			}
+
+		return cc;
+		}
+
+	if ( v->size() != 3 + *m )
 		return nullptr;
 
+	cc->buckets.assign(*m, 0);
+
 	for ( size_t i = 0; i < *m; ++i )
 		{
 		auto x = broker::get_if<uint64_t>(&(*v)[3 + i]);
-		if ( ! x )
+		if ( ! x || *x > 64 )
 			return nullptr;
 
 		cc->buckets[i] = *x;
@@ -281,13 +484,18 @@ std::unique_ptr<CardinalityCounter> CardinalityCounter::Unserialize(const broker
  */
 int CardinalityCounter::flsll(uint64_t mask)
 	{
-	int bit;
-
 	if ( mask == 0 )
 		return (0);
+
+#if defined(__GNUC__) || defined(__clang__)
+	return 64 - __builtin_clzll(mask);
+#else
+	int bit;
+
 	for ( bit = 1; mask != 1; bit++ )
 		mask = (uint64_t)mask >> 1;
 	return (bit);
+#endif
 	}
 
 	} // namespace zeek::probabilistic::detail
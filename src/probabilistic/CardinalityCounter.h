@@ -17,6 +17,13 @@ namespace zeek::probabilistic::detail
 
 /**
  * A probabilistic cardinality counter using the HyperLogLog algorithm.
+ *
+ * As long as few elements have been added, the counter uses the sparse
+ * representation of HyperLogLog++ (Heule et al., "HyperLogLog in Practice",
+ * 2013): rather than all buckets, it keeps a list of the buckets in use at
+ * a much higher precision, which is smaller and yields near-exact
+ * estimates. Once the list would take more memory than the buckets, the
+ * counter switches over to them.
  */
 class CardinalityCounter
 	{
@@ -158,6 +165,41 @@ private:
 	 */
 	uint8_t Rank(uint64_t hash_modified) const;
 
+	/**
+	 * Raises a bucket to a given rank unless it already has a higher one.
+	 */
+	void Update(uint64_t index, uint8_t rank);
+
+	/**
+	 * Turns a hash value into an entry for the sparse representation: the
+	 * lowest SPARSE_P bits of the hash as index, shifted left by six bits
+	 * to make room for the rank of the remaining ones.
+	 */
+	static uint32_t EncodeSparse(uint64_t hash);
+
+	/**
+	 * Adds an entry of the sparse representation to the buckets. This
+	 * leads to the same bucket and rank as adding the hash value that the
+	 * entry came from.
+	 */
+	void AddSparseEntry(uint32_t entry);
+
+	/**
+	 * Merges a sorted list of sparse entries into the sparse
+	 * representation, keeping the highest rank for each index.
+	 */
+	void MergeSparse(const std::vector<uint32_t>& entries) const;
+
+	/**
+	 * Moves buffered additions into the sorted list of sparse entries.
+	 */
+	void FlushSparse() const;
+
+	/**
+	 * Switches from the sparse representation to the buckets.
+	 */
+	void ToDense();
+
 	/**
 	 * flsll from FreeBSD; especially Linux does not have this.
 	 */
@@ -187,6 +229,24 @@ private:
 	uint64_t V;
 	double alpha_m;
 	int p; // the log2 of m
+
+	/**
+	 * The precision of the sparse representation, i.e., the log2 of the
+	 * number of buckets it distinguishes. Entries need to fit into 32 bits
+	 * along with a six-bit rank.
+	 */
+	static constexpr int SPARSE_P = 25;
+
+	/**
+	 * While sparse is set, the buckets are empty and the counter keeps
+	 * sparse_list instead, sorted by index with at most one entry each.
+	 * New entries go into sparse_buffer first so that they can be merged
+	 * into the list in batches. Both are mutable as estimating the size
+	 * flushes the buffer.
+	 */
+	bool sparse = false;
+	mutable std::vector<uint32_t> sparse_list;
+	mutable std::vector<uint32_t> sparse_buffer;
 	};
 
 	} // namespace zeek::probabilistic::detail
@@ -0,0 +1,153 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/probabilistic/CountMinSketch.h"
+
+#include <broker/data.hh>
+#include <broker/error.hh>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace zeek::probabilistic::detail
+	{
+
+CountMinSketch::CountMinSketch(size_t arg_width, size_t arg_depth, Hasher::seed_t seed)
+	: width(arg_width), depth(arg_depth), hasher(new DoubleHasher(arg_depth, seed)),
+	  counters(arg_width * arg_depth, 0)
+	{
+	}
+
+CountMinSketch::CountMinSketch(const CountMinSketch& other)
+	: width(other.width), depth(other.depth), total(other.total),
+	  hasher(other.hasher->Clone()), counters(other.counters)
+	{
+	}
+
+size_t CountMinSketch::Width(double epsilon)
+	{
+	return std::max(1.0, std::ceil(std::exp(1.0) / epsilon));
+	}
+
+size_t CountMinSketch::Depth(double delta)
+	{
+	return std::max(1.0, std::ceil(std::log(1 / delta)));
+	}
+
+double CountMinSketch::NumCounters(double epsilon, double delta)
+	{
+	return std::max(1.0, std::ceil(std::exp(1.0) / epsilon)) *
+	       std::max(1.0, std::ceil(std::log(1 / delta)));
+	}
+
+void CountMinSketch::Add(const zeek::detail::HashKey* key, uint64_t n)
+	{
+	auto h = hasher->Hash(key);
+
+	for ( size_t i = 0; i < depth; ++i )
+		{
+		auto& c = counters[i * width + h[i] % width];
+
+		// Saturate rather than wrap around, which would break the
+		// guarantee of never underestimating.
+		c = (c > std::numeric_limits<uint64_t>::max() - n) ? std::numeric_limits<uint64_t>::max()
+		                                                   : c + n;
+		}
+
+	total += n;
+	}
+
+uint64_t CountMinSketch::Estimate(const zeek::detail::HashKey* key) const
+	{
+	auto h = hasher->Hash(key);
+	uint64_t rval = std::numeric_limits<uint64_t>::max();
+
+	for ( size_t i = 0; i < depth; ++i )
+		rval = std::min(rval, counters[i * width + h[i] % width]);
+
+	return rval;
+	}
+
+bool CountMinSketch::Merge(const CountMinSketch* other)
+	{
+	if ( width != other->width || depth != other->depth || ! hasher->Equals(other->hasher.get()) )
+		return false;
+
+	for ( size_t i = 0; i < counters.size(); ++i )
+		{
+		auto n = other->counters[i];
+		auto& c = counters[i];
+		c = (c > std::numeric_limits<uint64_t>::max() - n) ? std::numeric_limits<uint64_t>::max()
+		                                                   : c + n;
+		}
+
+	total += other->total;
+	return true;
+	}
+
+void CountMinSketch::Clear()
+	{
+	std::fill(counters.begin(), counters.end(), 0);
+	total = 0;
+	}
+
+broker::expected<broker::data> CountMinSketch::Serialize() const
+	{
+	auto h = hasher->Serialize();
+
+	if ( ! h )
+		return broker::ec::invalid_data;
+
+	broker::vector v = {static_cast<uint64_t>(width), static_cast<uint64_t>(depth), total,
+	                    std::move(*h)};
+	v.reserve(4 + counters.size());
+
+	for ( auto c : counters )
+		v.emplace_back(c);
+
+	return {std::move(v)};
+	}
+
+std::unique_ptr<CountMinSketch> CountMinSketch::Unserialize(const broker::data& data)
+	{
+	auto v = broker::get_if<broker::vector>(&data);
+
+	if ( ! (v && v->size() >= 4) )
+		return nullptr;
+
+	auto width = broker::get_if<uint64_t>(&(*v)[0]);
+	auto depth = broker::get_if<uint64_t>(&(*v)[1]);
+	auto total = broker::get_if<uint64_t>(&(*v)[2]);
+
+	if ( ! (width && depth && total) )
+		return nullptr;
+
+	if ( *width == 0 || *depth == 0 || *width > v->size() || *depth > v->size() ||
+	     v->size() - 4 != *width * *depth )
+		return nullptr;
+
+	auto hasher = Hasher::Unserialize((*v)[3]);
+
+	if ( ! hasher || hasher->K() != *depth )
+		return nullptr;
+
+	auto cms = std::unique_ptr<CountMinSketch>(new CountMinSketch());
+	cms->width = *width;
+	cms->depth = *depth;
+	cms->total = *total;
+	cms->hasher = std::move(hasher);
+	cms->counters.reserve(*width * *depth);
+
+	for ( size_t i = 4; i < v->size(); ++i )
+		{
+		auto c = broker::get_if<uint64_t>(&(*v)[i]);
+
+		if ( ! c )
+			return nullptr;
+
+		cms->counters.push_back(*c);
+		}
+
+	return cms;
+	}
+
+	} // namespace zeek::probabilistic::detail
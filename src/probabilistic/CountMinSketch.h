@@ -0,0 +1,144 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <broker/expected.hh>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "zeek/probabilistic/Hasher.h"
+
+namespace broker
+	{
+class data;
+	}
+
+namespace zeek::detail
+	{
+class HashKey;
+	}
+
+namespace zeek::probabilistic::detail
+	{
+
+/**
+ * A count-min sketch, which estimates how often elements occur in a stream
+ * with a fixed amount of memory. Estimates never fall below the true count,
+ * and exceed it by at most epsilon times the total count with probability
+ * 1 - delta.
+ *
+ * Sketches with the same dimensions and seed can be merged by adding up
+ * their counters.
+ */
+class CountMinSketch
+	{
+public:
+	/**
+	 * The largest number of counters a sketch may have, which keeps its
+	 * memory use at 512 MiB.
+	 */
+	static constexpr uint64_t MAX_COUNTERS = uint64_t(1) << 26;
+
+	/**
+	 * Constructor.
+	 *
+	 * @param width The number of counters per row.
+	 *
+	 * @param depth The number of rows, each using its own hash function.
+	 *
+	 * @param seed The seed for the hash functions.
+	 */
+	CountMinSketch(size_t width, size_t depth, Hasher::seed_t seed);
+
+	/**
+	 * Copy-Constructor.
+	 */
+	CountMinSketch(const CountMinSketch& other);
+
+	/**
+	 * Computes the number of counters per row for a given error.
+	 *
+	 * @param epsilon The error of estimates, relative to the total count.
+	 *
+	 * @return The width, ceil(e / epsilon).
+	 */
+	static size_t Width(double epsilon);
+
+	/**
+	 * Computes the number of rows for a given error probability.
+	 *
+	 * @param delta The probability of an estimate exceeding the error.
+	 *
+	 * @return The depth, ceil(ln(1 / delta)).
+	 */
+	static size_t Depth(double delta);
+
+	/**
+	 * Computes the total number of counters for a given error and error
+	 * probability, without converting to an integer type. Callers check
+	 * it against MAX_COUNTERS before using Width() and Depth().
+	 *
+	 * @param epsilon The error of estimates, relative to the total count.
+	 *
+	 * @param delta The probability of an estimate exceeding the error.
+	 *
+	 * @return The product of width and depth.
+	 */
+	static double NumCounters(double epsilon, double delta);
+
+	/**
+	 * Counts occurrences of an element.
+	 *
+	 * @param key The key of the element.
+	 *
+	 * @param n The number of occurrences.
+	 */
+	void Add(const zeek::detail::HashKey* key, uint64_t n = 1);
+
+	/**
+	 * Estimates the number of occurrences of an element.
+	 *
+	 * @param key The key of the element.
+	 *
+	 * @return The smallest of the element's counters.
+	 */
+	uint64_t Estimate(const zeek::detail::HashKey* key) const;
+
+	/**
+	 * @return The total number of occurrences counted so far.
+	 */
+	uint64_t Total() const { return total; }
+
+	/**
+	 * Merges another sketch into this one. Both sketches need to have the
+	 * same dimensions and seed, otherwise the merge operation will not be
+	 * carried out.
+	 *
+	 * @param other The sketch to merge into this one.
+	 *
+	 * @return True if successful.
+	 */
+	bool Merge(const CountMinSketch* other);
+
+	/**
+	 * Resets all counters.
+	 */
+	void Clear();
+
+	broker::expected<broker::data> Serialize() const;
+	static std::unique_ptr<CountMinSketch> Unserialize(const broker::data& data);
+
+private:
+	CountMinSketch() = default;
+
+	size_t width = 0;
+	size_t depth = 0;
+	uint64_t total = 0;
+	std::unique_ptr<Hasher> hasher;
+
+	// Row i occupies counters [i * width, (i + 1) * width).
+	std::vector<uint64_t> counters;
+	};
+
+	} // namespace zeek::probabilistic::detail
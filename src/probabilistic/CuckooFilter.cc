@@ -0,0 +1,273 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/probabilistic/CuckooFilter.h"
+
+#include <broker/data.hh>
+#include <broker/error.hh>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "zeek/util.h"
+
+namespace zeek::probabilistic::detail
+	{
+
+CuckooFilter::CuckooFilter(size_t capacity, Hasher::seed_t arg_seed)
+	: seed(arg_seed), hash(arg_seed)
+	{
+	// Filters start failing inserts at around 95% occupancy.
+	auto needed = static_cast<size_t>(std::ceil(capacity / (SLOTS * 0.95)));
+
+	// Alternate buckets rely on the number of buckets being a power of two.
+	num_buckets = 1;
+
+	while ( num_buckets < needed )
+		num_buckets <<= 1;
+
+	table.resize(num_buckets * SLOTS, 0);
+	}
+
+void CuckooFilter::Locate(const zeek::detail::HashKey* key, size_t* bucket, Fingerprint* fp) const
+	{
+	auto h = hash(key->Key(), key->Size());
+	*bucket = h & (num_buckets - 1);
+	*fp = static_cast<Fingerprint>(h >> 48);
+
+	if ( *fp == 0 )
+		*fp = 1;
+	}
+
+size_t CuckooFilter::AltBucket(size_t bucket, Fingerprint fp) const
+	{
+	// Hashing the fingerprint spreads the alternate buckets of a
+	// fingerprint across the whole table. The XOR makes this symmetric.
+	return (bucket ^ (fp * uint64_t(0x5bd1e995))) & (num_buckets - 1);
+	}
+
+bool CuckooFilter::Contains(size_t bucket, Fingerprint fp) const
+	{
+	const auto* slots = &table[bucket * SLOTS];
+	return std::find(slots, slots + SLOTS, fp) != slots + SLOTS;
+	}
+
+bool CuckooFilter::InsertInto(size_t bucket, Fingerprint fp)
+	{
+	auto* slots = &table[bucket * SLOTS];
+	auto* slot = std::find(slots, slots + SLOTS, Fingerprint(0));
+
+	if ( slot == slots + SLOTS )
+		return false;
+
+	*slot = fp;
+	return true;
+	}
+
+bool CuckooFilter::RemoveFrom(size_t bucket, Fingerprint fp)
+	{
+	auto* slots = &table[bucket * SLOTS];
+	auto* slot = std::find(slots, slots + SLOTS, fp);
+
+	if ( slot == slots + SLOTS )
+		return false;
+
+	*slot = 0;
+	return true;
+	}
+
+bool CuckooFilter::Insert(size_t bucket, Fingerprint fp)
+	{
+	if ( InsertInto(bucket, fp) )
+		return true;
+
+	bucket = AltBucket(bucket, fp);
+
+	if ( InsertInto(bucket, fp) )
+		return true;
+
+	for ( int i = 0; i < MAX_KICKS; ++i )
+		{
+		auto slot = util::detail::random_number() % SLOTS;
+		std::swap(fp, table[bucket * SLOTS + slot]);
+		bucket = AltBucket(bucket, fp);
+
+		if ( InsertInto(bucket, fp) )
+			return true;
+		}
+
+	victim = fp;
+	victim_bucket = bucket;
+	return false;
+	}
+
+bool CuckooFilter::Add(const zeek::detail::HashKey* key)
+	{
+	if ( victim )
+		return false;
+
+	size_t bucket;
+	Fingerprint fp;
+	Locate(key, &bucket, &fp);
+
+	// Even when Insert() gives up, the element itself made it in and
+	// the victim still counts.
+	Insert(bucket, fp);
+	++count;
+	return true;
+	}
+
+bool CuckooFilter::Lookup(const zeek::detail::HashKey* key) const
+	{
+	size_t bucket;
+	Fingerprint fp;
+	Locate(key, &bucket, &fp);
+
+	auto alt = AltBucket(bucket, fp);
+
+	if ( Contains(bucket, fp) || Contains(alt, fp) )
+		return true;
+
+	return victim == fp && (victim_bucket == bucket || victim_bucket == alt);
+	}
+
+bool CuckooFilter::Remove(const zeek::detail::HashKey* key)
+	{
+	size_t bucket;
+	Fingerprint fp;
+	Locate(key, &bucket, &fp);
+
+	auto alt = AltBucket(bucket, fp);
+
+	if ( RemoveFrom(bucket, fp) || RemoveFrom(alt, fp) )
+		{
+		--count;
+
+		// There's room for the victim now.
+		if ( victim )
+			{
+			auto v = std::exchange(victim, 0);
+			Insert(victim_bucket, v);
+			}
+
+		return true;
+		}
+
+	if ( victim == fp && (victim_bucket == bucket || victim_bucket == alt) )
+		{
+		victim = 0;
+		--count;
+		return true;
+		}
+
+	return false;
+	}
+
+bool CuckooFilter::Merge(const CuckooFilter* other)
+	{
+	if ( num_buckets != other->num_buckets || hash != other->hash )
+		return false;
+
+	CuckooFilter merged(*this);
+
+	for ( size_t i = 0; i < other->table.size(); ++i )
+		{
+		auto fp = other->table[i];
+
+		if ( ! fp )
+			continue;
+
+		if ( merged.victim )
+			return false;
+
+		merged.Insert(i / SLOTS, fp);
+		}
+
+	if ( other->victim )
+		{
+		if ( merged.victim )
+			return false;
+
+		merged.Insert(other->victim_bucket, other->victim);
+		}
+
+	merged.count += other->count;
+	*this = std::move(merged);
+	return true;
+	}
+
+void CuckooFilter::Clear()
+	{
+	std::fill(table.begin(), table.end(), 0);
+	count = 0;
+	victim = 0;
+	}
+
+broker::expected<broker::data> CuckooFilter::Serialize() const
+	{
+	broker::vector v = {static_cast<uint64_t>(num_buckets),
+	                    count,
+	                    static_cast<uint64_t>(seed.h[0]),
+	                    static_cast<uint64_t>(seed.h[1]),
+	                    static_cast<uint64_t>(victim),
+	                    static_cast<uint64_t>(victim_bucket)};
+	v.reserve(6 + num_buckets);
+
+	// Each bucket's fingerprints fit into one value.
+	for ( size_t i = 0; i < num_buckets; ++i )
+		{
+		uint64_t packed = 0;
+
+		for ( size_t j = 0; j < SLOTS; ++j )
+			packed |= static_cast<uint64_t>(table[i * SLOTS + j]) << (16 * j);
+
+		v.emplace_back(packed);
+		}
+
+	return {std::move(v)};
+	}
+
+std::unique_ptr<CuckooFilter> CuckooFilter::Unserialize(const broker::data& data)
+	{
+	auto v = broker::get_if<broker::vector>(&data);
+
+	if ( ! (v && v->size() >= 7) )
+		return nullptr;
+
+	auto num_buckets = broker::get_if<uint64_t>(&(*v)[0]);
+	auto count = broker::get_if<uint64_t>(&(*v)[1]);
+	auto h1 = broker::get_if<uint64_t>(&(*v)[2]);
+	auto h2 = broker::get_if<uint64_t>(&(*v)[3]);
+	auto victim = broker::get_if<uint64_t>(&(*v)[4]);
+	auto victim_bucket = broker::get_if<uint64_t>(&(*v)[5]);
+
+	if ( ! (num_buckets && count && h1 && h2 && victim && victim_bucket) )
+		return nullptr;
+
+	if ( (*num_buckets & (*num_buckets - 1)) != 0 || *num_buckets != v->size() - 6 ||
+	     *victim > UINT16_MAX || *victim_bucket >= *num_buckets )
+		return nullptr;
+
+	auto cf = std::unique_ptr<CuckooFilter>(new CuckooFilter());
+	cf->seed = {*h1, *h2};
+	cf->hash = UHF(cf->seed);
+	cf->num_buckets = *num_buckets;
+	cf->count = *count;
+	cf->victim = *victim;
+	cf->victim_bucket = *victim_bucket;
+	cf->table.reserve(*num_buckets * SLOTS);
+
+	for ( size_t i = 6; i < v->size(); ++i )
+		{
+		auto packed = broker::get_if<uint64_t>(&(*v)[i]);
+
+		if ( ! packed )
+			return nullptr;
+
+		for ( size_t j = 0; j < SLOTS; ++j )
+			cf->table.push_back(static_cast<Fingerprint>(*packed >> (16 * j)));
+		}
+
+	return cf;
+	}
+
+	} // namespace zeek::probabilistic::detail
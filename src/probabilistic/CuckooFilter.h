@@ -0,0 +1,154 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <broker/expected.hh>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "zeek/probabilistic/Hasher.h"
+
+namespace broker
+	{
+class data;
+	}
+
+namespace zeek::detail
+	{
+class HashKey;
+	}
+
+namespace zeek::probabilistic::detail
+	{
+
+/**
+ * A cuckoo filter (Fan et al., "Cuckoo Filter: Practically Better Than
+ * Bloom", 2014). Like a Bloom filter, it answers set membership queries
+ * with false positives, but it also supports removing elements.
+ *
+ * The filter stores 16-bit fingerprints of elements in buckets of four
+ * slots. Each element has two candidate buckets, the second derived from
+ * the first and the fingerprint alone, so that fingerprints can move
+ * between their buckets to make room without knowing their elements.
+ * The false-positive rate is about 8 / 2^16.
+ *
+ * Only remove elements that were added before, otherwise the filter may
+ * remove the fingerprint of another element.
+ */
+class CuckooFilter
+	{
+public:
+	/**
+	 * The largest capacity a filter supports, which keeps the size of its
+	 * table well within range.
+	 */
+	static constexpr uint64_t MAX_CAPACITY = uint64_t(1) << 32;
+
+	/**
+	 * Constructor.
+	 *
+	 * @param capacity The number of elements the filter needs to hold, at
+	 * most MAX_CAPACITY.
+	 *
+	 * @param seed The seed for the hash function.
+	 */
+	CuckooFilter(size_t capacity, Hasher::seed_t seed);
+
+	/**
+	 * Adds an element.
+	 *
+	 * @param key The key of the element.
+	 *
+	 * @return False if the filter is full.
+	 */
+	bool Add(const zeek::detail::HashKey* key);
+
+	/**
+	 * Checks whether an element may have been added.
+	 *
+	 * @param key The key of the element.
+	 *
+	 * @return True if the element's fingerprint is present.
+	 */
+	bool Lookup(const zeek::detail::HashKey* key) const;
+
+	/**
+	 * Removes an element.
+	 *
+	 * @param key The key of the element.
+	 *
+	 * @return False if the element's fingerprint isn't present.
+	 */
+	bool Remove(const zeek::detail::HashKey* key);
+
+	/**
+	 * @return The number of elements in the filter.
+	 */
+	uint64_t Count() const { return count; }
+
+	/**
+	 * Merges another filter into this one by adding its fingerprints. Both
+	 * filters need to have the same number of buckets and seed, otherwise
+	 * the merge operation will not be carried out. If the merged filter
+	 * would exceed its capacity, this one remains unchanged.
+	 *
+	 * @param other The filter to merge into this one.
+	 *
+	 * @return True if successful.
+	 */
+	bool Merge(const CuckooFilter* other);
+
+	/**
+	 * Removes all elements.
+	 */
+	void Clear();
+
+	broker::expected<broker::data> Serialize() const;
+	static std::unique_ptr<CuckooFilter> Unserialize(const broker::data& data);
+
+private:
+	using Fingerprint = uint16_t;
+
+	static constexpr size_t SLOTS = 4;
+	static constexpr int MAX_KICKS = 500;
+
+	CuckooFilter() = default;
+
+	/**
+	 * Computes the first bucket and the fingerprint of an element.
+	 * Fingerprints are never zero, which marks empty slots.
+	 */
+	void Locate(const zeek::detail::HashKey* key, size_t* bucket, Fingerprint* fp) const;
+
+	/**
+	 * Returns the other bucket of a fingerprint in a given bucket.
+	 */
+	size_t AltBucket(size_t bucket, Fingerprint fp) const;
+
+	bool Contains(size_t bucket, Fingerprint fp) const;
+	bool InsertInto(size_t bucket, Fingerprint fp);
+	bool RemoveFrom(size_t bucket, Fingerprint fp);
+
+	/**
+	 * Inserts a fingerprint into one of its buckets, moving others out of
+	 * the way if necessary. If that fails, the last fingerprint moved out
+	 * becomes the victim.
+	 */
+	bool Insert(size_t bucket, Fingerprint fp);
+
+	Hasher::seed_t seed;
+	UHF hash;
+	size_t num_buckets = 0;
+	uint64_t count = 0;
+
+	// Slot j of bucket i is at index i * SLOTS + j.
+	std::vector<Fingerprint> table;
+
+	// A fingerprint that didn't fit anymore. While there is one, the
+	// filter is full.
+	Fingerprint victim = 0;
+	size_t victim_bucket = 0;
+	};
+
+	} // namespace zeek::probabilistic::detail
@@ -0,0 +1,269 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/probabilistic/QuantileSketch.h"
+
+#include <broker/data.hh>
+#include <broker/error.hh>
+#include <algorithm>
+#include <cmath>
+
+#include "zeek/util.h"
+
+namespace zeek::probabilistic::detail
+	{
+
+QuantileSketch::QuantileSketch(uint64_t arg_k) : k(arg_k), levels(1)
+	{
+	max_size = Capacity(0);
+	}
+
+size_t QuantileSketch::Capacity(size_t level) const
+	{
+	// Each level down from the top gets 2/3 of the room of the one above.
+	auto depth = levels.size() - 1 - level;
+	auto cap = static_cast<size_t>(std::ceil(k * std::pow(2.0 / 3.0, depth)));
+	return std::max(cap, size_t(2));
+	}
+
+bool QuantileSketch::Add(double x)
+	{
+	if ( std::isnan(x) )
+		return false;
+
+	if ( n == 0 )
+		min = max = x;
+	else
+		{
+		min = std::min(min, x);
+		max = std::max(max, x);
+		}
+
+	levels[0].push_back(x);
+	++size;
+	++n;
+
+	Shrink();
+	return true;
+	}
+
+void QuantileSketch::Compress()
+	{
+	for ( size_t h = 0; h < levels.size(); ++h )
+		{
+		if ( levels[h].size() < Capacity(h) )
+			continue;
+
+		if ( h + 1 == levels.size() )
+			levels.emplace_back();
+
+		auto& cur = levels[h];
+		auto& next = levels[h + 1];
+
+		std::sort(cur.begin(), cur.end());
+
+		// With an odd number of values, the largest one stays behind so
+		// that the total weight remains the same.
+		size_t len = cur.size() - cur.size() % 2;
+		size_t offset = util::detail::random_number() % 2;
+
+		for ( size_t i = offset; i < len; i += 2 )
+			next.push_back(cur[i]);
+
+		cur.erase(cur.begin(), cur.begin() + len);
+		break;
+		}
+
+	Recount();
+	}
+
+void QuantileSketch::Recount()
+	{
+	size = 0;
+	max_size = 0;
+
+	for ( size_t h = 0; h < levels.size(); ++h )
+		{
+		size += levels[h].size();
+		max_size += Capacity(h);
+		}
+	}
+
+void QuantileSketch::Shrink()
+	{
+	// Some level is at capacity whenever the total size is, so every
+	// round makes progress.
+	while ( size >= max_size )
+		Compress();
+	}
+
+std::vector<std::pair<double, uint64_t>> QuantileSketch::Weighted() const
+	{
+	std::vector<std::pair<double, uint64_t>> rval;
+	rval.reserve(size);
+
+	for ( size_t h = 0; h < levels.size(); ++h )
+		{
+		for ( auto x : levels[h] )
+			rval.emplace_back(x, uint64_t(1) << h);
+		}
+
+	std::sort(rval.begin(), rval.end());
+	return rval;
+	}
+
+double QuantileSketch::Quantile(double q) const
+	{
+	if ( n == 0 )
+		return 0;
+
+	if ( q <= 0 )
+		return min;
+
+	if ( q >= 1 )
+		return max;
+
+	double target = q * n;
+	uint64_t cumulative = 0;
+
+	for ( const auto& [x, weight] : Weighted() )
+		{
+		cumulative += weight;
+
+		if ( cumulative >= target )
+			return x;
+		}
+
+	return max;
+	}
+
+double QuantileSketch::Rank(double x) const
+	{
+	if ( n == 0 )
+		return 0;
+
+	uint64_t cumulative = 0;
+
+	for ( size_t h = 0; h < levels.size(); ++h )
+		{
+		for ( auto y : levels[h] )
+			{
+			if ( y <= x )
+				cumulative += uint64_t(1) << h;
+			}
+		}
+
+	return static_cast<double>(cumulative) / n;
+	}
+
+bool QuantileSketch::Merge(const QuantileSketch* other)
+	{
+	if ( k != other->k )
+		return false;
+
+	if ( other->n == 0 )
+		return true;
+
+	if ( n == 0 )
+		{
+		min = other->min;
+		max = other->max;
+		}
+	else
+		{
+		min = std::min(min, other->min);
+		max = std::max(max, other->max);
+		}
+
+	// Copied first, as inserting into our levels would invalidate the
+	// iterators when merging a sketch into itself.
+	auto other_levels = other->levels;
+	n += other->n;
+
+	if ( levels.size() < other_levels.size() )
+		levels.resize(other_levels.size());
+
+	for ( size_t h = 0; h < other_levels.size(); ++h )
+		levels[h].insert(levels[h].end(), other_levels[h].begin(), other_levels[h].end());
+
+	Recount();
+	Shrink();
+	return true;
+	}
+
+broker::expected<broker::data> QuantileSketch::Serialize() const
+	{
+	broker::vector v = {k, n, min, max};
+	v.reserve(4 + levels.size());
+
+	for ( const auto& level : levels )
+		{
+		broker::vector l;
+		l.reserve(level.size());
+
+		for ( auto x : level )
+			l.emplace_back(x);
+
+		v.emplace_back(std::move(l));
+		}
+
+	return {std::move(v)};
+	}
+
+std::unique_ptr<QuantileSketch> QuantileSketch::Unserialize(const broker::data& data)
+	{
+	auto v = broker::get_if<broker::vector>(&data);
+
+	// Levels beyond 64 would have values weighing more than 2^64.
+	if ( ! (v && v->size() >= 5 && v->size() <= 4 + 64) )
+		return nullptr;
+
+	auto k = broker::get_if<uint64_t>(&(*v)[0]);
+	auto n = broker::get_if<uint64_t>(&(*v)[1]);
+	auto min = broker::get_if<double>(&(*v)[2]);
+	auto max = broker::get_if<double>(&(*v)[3]);
+
+	if ( ! (k && n && min && max) || *k < 2 || std::isnan(*min) || std::isnan(*max) )
+		return nullptr;
+
+	auto qs = std::make_unique<QuantileSketch>(*k);
+	qs->n = *n;
+	qs->min = *min;
+	qs->max = *max;
+	qs->levels.clear();
+
+	uint64_t weight = 0;
+
+	for ( size_t i = 4; i < v->size(); ++i )
+		{
+		auto l = broker::get_if<broker::vector>(&(*v)[i]);
+
+		if ( ! l )
+			return nullptr;
+
+		auto h = i - 4;
+		auto& level = qs->levels.emplace_back();
+		level.reserve(l->size());
+
+		for ( const auto& d : *l )
+			{
+			auto x = broker::get_if<double>(&d);
+
+			// NaN would break sorting the levels.
+			if ( ! x || std::isnan(*x) )
+				return nullptr;
+
+			level.push_back(*x);
+			weight += uint64_t(1) << h;
+			}
+		}
+
+	// The retained values need to account for all values added.
+	if ( weight != *n )
+		return nullptr;
+
+	qs->Recount();
+	qs->Shrink();
+	return qs;
+	}
+
+	} // namespace zeek::probabilistic::detail
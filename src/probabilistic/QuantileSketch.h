@@ -0,0 +1,137 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <broker/expected.hh>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace broker
+	{
+class data;
+	}
+
+namespace zeek::probabilistic::detail
+	{
+
+/**
+ * A mergeable quantile sketch using the KLL algorithm (Karnin, Lang and
+ * Liberty, "Optimal Quantile Approximation in Streams", 2016).
+ *
+ * The sketch keeps values in a hierarchy of compactors. Once a compactor
+ * fills up, it sorts its values and promotes every other one to the next
+ * level, where each value stands for twice as many. Lower levels get less
+ * room than higher ones, so memory grows only logarithmically with the
+ * number of values. The rank error is about 1.7 / k with high probability.
+ *
+ * As long as fewer than *k* values have been added, results are exact.
+ */
+class QuantileSketch
+	{
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param k The capacity of the highest compactor, which determines
+	 * the accuracy of the sketch.
+	 */
+	explicit QuantileSketch(uint64_t k);
+
+	/**
+	 * Adds a value to the sketch. NaN values are ignored, as they have no
+	 * place in the order of values.
+	 *
+	 * @param x The value.
+	 *
+	 * @return False if the value was NaN and not added.
+	 */
+	bool Add(double x);
+
+	/**
+	 * Estimates a quantile of the values added so far.
+	 *
+	 * @param q The quantile, between 0 and 1. Values outside of that
+	 * range get clamped.
+	 *
+	 * @return The smallest value whose rank is at least q times the
+	 * number of values, or 0 if the sketch is empty.
+	 */
+	double Quantile(double q) const;
+
+	/**
+	 * Estimates the fraction of values added so far that don't exceed a
+	 * given value.
+	 *
+	 * @param x The value.
+	 *
+	 * @return The normalized rank of x, or 0 if the sketch is empty.
+	 */
+	double Rank(double x) const;
+
+	/**
+	 * @return The number of values added so far.
+	 */
+	uint64_t Count() const { return n; }
+
+	/**
+	 * @return The parameter the sketch was created with.
+	 */
+	uint64_t K() const { return k; }
+
+	/**
+	 * Merges another sketch into this one. Both sketches need to have the
+	 * same *k*, otherwise the merge operation will not be carried out.
+	 *
+	 * @param other The sketch to merge into this one.
+	 *
+	 * @return True if successful.
+	 */
+	bool Merge(const QuantileSketch* other);
+
+	broker::expected<broker::data> Serialize() const;
+	static std::unique_ptr<QuantileSketch> Unserialize(const broker::data& data);
+
+private:
+	/**
+	 * Returns how many values a level may hold before it gets compacted.
+	 */
+	size_t Capacity(size_t level) const;
+
+	/**
+	 * Compacts the lowest level that is full, adding a level on top if
+	 * necessary.
+	 */
+	void Compress();
+
+	/**
+	 * Recomputes the number of retained values and the capacity of the
+	 * sketch from its levels.
+	 */
+	void Recount();
+
+	/**
+	 * Compacts levels until the sketch no longer exceeds its capacity.
+	 */
+	void Shrink();
+
+	/**
+	 * Returns all retained values along with their weights, sorted by
+	 * value.
+	 */
+	std::vector<std::pair<double, uint64_t>> Weighted() const;
+
+	uint64_t k;
+	uint64_t n = 0;
+	double min = 0;
+	double max = 0;
+
+	// Values of level h each stand for 2^h values added.
+	std::vector<std::vector<double>> levels;
+
+	// The number of retained values, and the sum of the capacities.
+	size_t size = 0;
+	size_t max_size = 0;
+	};
+
+	} // namespace zeek::probabilistic::detail
@@ -421,7 +421,8 @@ void CPPCompile::GenForOverTable(const ExprPtr& tbl, const IDPtr& value_var,
                                  const IDPList* loop_vars)
 	{
 	Emit("auto tv__CPP = %s;", GenExpr(tbl, GEN_DONT_CARE));
-	Emit("const PDict<TableEntryVal>* loop_vals__CPP = tv__CPP->AsTable();");
+	Emit("TableVal::LoopEntries loop_entries__CPP(*tv__CPP);");
+	Emit("const PDict<TableEntryVal>* loop_vals__CPP = loop_entries__CPP.Get();");
 
 	Emit("if ( loop_vals__CPP->Length() > 0 )");
 	StartBlock();
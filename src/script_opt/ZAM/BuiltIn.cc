@@ -57,6 +57,9 @@ bool ZAMCompiler::IsZAM_BuiltIn(const Expr* e)
 		{"strstr", &ZAMCompiler::BuiltIn_strstr},
 		{"sub_bytes", &ZAMCompiler::BuiltIn_sub_bytes},
 		{"to_lower", &ZAMCompiler::BuiltIn_to_lower},
+		{"vector_max", &ZAMCompiler::BuiltIn_vector_max},
+		{"vector_min", &ZAMCompiler::BuiltIn_vector_min},
+		{"vector_sum", &ZAMCompiler::BuiltIn_vector_sum},
 	};
 
 	for ( auto& b : builtins )
@@ -416,6 +419,57 @@ bool ZAMCompiler::BuiltIn_to_lower(const NameExpr* n, const ExprPList& args)
 	return true;
 	}
 
+bool ZAMCompiler::BuiltIn_vector_max(const NameExpr* n, const ExprPList& args)
+	{
+	return BuiltIn_vector_reduction(n, args, OP_VECTOR_MAX_VV);
+	}
+
+bool ZAMCompiler::BuiltIn_vector_min(const NameExpr* n, const ExprPList& args)
+	{
+	return BuiltIn_vector_reduction(n, args, OP_VECTOR_MIN_VV);
+	}
+
+bool ZAMCompiler::BuiltIn_vector_sum(const NameExpr* n, const ExprPList& args)
+	{
+	return BuiltIn_vector_reduction(n, args, OP_VECTOR_SUM_VV);
+	}
+
+bool ZAMCompiler::BuiltIn_vector_reduction(const NameExpr* n, const ExprPList& args, ZOp op)
+	{
+	if ( ! n )
+		{
+		reporter->Warning("return value from built-in function ignored");
+		return true;
+		}
+
+	if ( args[0]->Tag() != EXPR_NAME )
+		return false;
+
+	// Leave anything that's not statically a vector-of-numeric to the
+	// BiF, which reports the error.
+	const auto& t = args[0]->GetType();
+	if ( t->Tag() != TYPE_VECTOR )
+		return false;
+
+	switch ( t->Yield()->Tag() )
+		{
+		case TYPE_COUNT:
+		case TYPE_INT:
+		case TYPE_DOUBLE:
+		case TYPE_TIME:
+		case TYPE_INTERVAL:
+			break;
+
+		default:
+			return false;
+		}
+
+	int nslot = Frame1Slot(n, OP1_WRITE);
+	AddInst(ZInstI(op, nslot, FrameSlot(args[0]->AsNameExpr())));
+
+	return true;
+	}
+
 bro_uint_t ZAMCompiler::ConstArgsMask(const ExprPList& args, int nargs) const
 	{
 	ASSERT(args.length() == nargs);
@@ -25,3 +25,9 @@ bool BuiltIn_reading_traces(const NameExpr* n, const ExprPList& args);
 bool BuiltIn_strstr(const NameExpr* n, const ExprPList& args);
 bool BuiltIn_sub_bytes(const NameExpr* n, const ExprPList& args);
 bool BuiltIn_to_lower(const NameExpr* n, const ExprPList& args);
+bool BuiltIn_vector_max(const NameExpr* n, const ExprPList& args);
+bool BuiltIn_vector_min(const NameExpr* n, const ExprPList& args);
+bool BuiltIn_vector_sum(const NameExpr* n, const ExprPList& args);
+
+// Shared by the vector_{max,min,sum} built-ins.
+bool BuiltIn_vector_reduction(const NameExpr* n, const ExprPList& args, ZOp op);
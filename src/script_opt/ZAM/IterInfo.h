@@ -31,9 +31,11 @@ public:
 	// and the type of the value variable (if any).
 	void BeginLoop(const TableVal* _tv, ZInstAux* _aux)
 		{
+		Clear();
 		tv = _tv;
 		aux = _aux;
-		auto tvd = tv->AsTable();
+		entries.emplace(*tv);
+		auto tvd = entries->Get();
 		tbl_iter = tvd->begin();
 		tbl_end = tvd->end();
 		}
@@ -77,6 +79,7 @@ public:
 		{
 		tbl_iter = std::nullopt;
 		tbl_end = std::nullopt;
+		entries = std::nullopt;
 		}
 
 private:
@@ -88,6 +91,11 @@ private:
 	// Associated auxiliary information.
 	ZInstAux* aux = nullptr;
 
+	// Holds on to the entries being iterated over, in case the loop
+	// body unshares them from the table.  Declared ahead of the
+	// iterators so that it outlives them.
+	std::optional<TableVal::LoopEntries> entries;
+
 	std::optional<DictIterator> tbl_iter;
 	std::optional<DictIterator> tbl_end;
 	};
@@ -103,11 +111,13 @@ public:
 	// that any use of the object starts with InitLoop().  That lets
 	// us use quasi-static objects for non-recursive functions.
 
-	// Initializes for looping over the elements of a raw vector.
-	void InitLoop(const std::vector<std::optional<ZVal>>* _vv)
+	// Initializes for looping over the elements of a vector.  We hold
+	// the vector itself rather than its raw storage, since the loop
+	// body can modify the vector and thereby unshare the storage.
+	void InitLoop(const VectorVal* _vv)
 		{
 		vv = _vv;
-		n = vv->size();
+		n = vv->Size();
 		iter = 0;
 		}
 
@@ -130,7 +140,7 @@ public:
 	bro_uint_t n; // we loop from 0 ... n-1
 
 	// The low-level value we're iterating over.
-	const std::vector<std::optional<ZVal>>* vv;
+	const VectorVal* vv;
 	const String* s;
 	};
 
@@ -104,4 +104,11 @@ void ZAM_run_time_warning(const Location* loc, const char* msg)
 	reporter->Warning("%s: %s", d.Description(), msg);
 	}
 
+void ZAM_builtin_error(const Location* loc, const char* msg)
+	{
+	reporter->PushLocation(loc);
+	reporter->Error("%s", msg);
+	reporter->PopLocation();
+	}
+
 	} // namespace zeek::detail
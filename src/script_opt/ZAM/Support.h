@@ -51,6 +51,9 @@ extern bool ZAM_error;
 
 extern void ZAM_run_time_warning(const Location* loc, const char* msg);
 
+// Reports an error the way a BiF does, without aborting execution.
+extern void ZAM_builtin_error(const Location* loc, const char* msg);
+
 extern StringVal* ZAM_to_lower(const StringVal* sv);
 extern StringVal* ZAM_sub_bytes(const StringVal* s, bro_uint_t start, bro_int_t n);
 
@@ -70,6 +70,44 @@ struct Stem
 		 * The Stem's parent process ID (i.e. PID of the Supervisor).
 		 */
 		pid_t parent_pid = 0;
+		/**
+		 * Whether the Stem runs within a node template.
+		 */
+		bool is_template = false;
+		};
+
+	/**
+	 * A node template: a process that loads the scripts for a kind of node
+	 * once and then forks all nodes of that kind from its own image.
+	 */
+	struct Template
+		{
+		Template(Supervisor::NodeConfig config) : process(std::move(config)) { }
+
+		/**
+		 * The template's process, configured like the node it was created
+		 * for.
+		 */
+		SupervisorNode process;
+		/**
+		 * Bidirectional pipes that allow the Stem and the template to talk.
+		 */
+		std::unique_ptr<detail::PipePair> pipe;
+		/**
+		 * Messages not yet sent to the template, which only starts reading
+		 * them once it has loaded its scripts.
+		 */
+		std::string pending;
+		/**
+		 * Leftover data read from the template without yet seeing a
+		 * complete message.
+		 */
+		std::string msg_buffer;
+		/**
+		 * JSON configurations of the nodes forked by the template, keyed
+		 * by node names.
+		 */
+		std::map<std::string, std::string> nodes;
 		};
 
 	Stem(State stem_state);
@@ -93,6 +131,31 @@ struct Stem
 	 */
 	std::variant<bool, SupervisedNode> Spawn(SupervisorNode* node);
 
+	/**
+	 * Like Spawn(), but for a node template.
+	 */
+	std::variant<bool, SupervisedNode> SpawnTemplate(Template* t);
+
+	/**
+	 * Creates a node by way of the template for its kind, spawning the
+	 * template first if necessary.  Returns a SupervisedNode in the
+	 * template's process.
+	 */
+	std::optional<SupervisedNode> CreateFromTemplate(std::string name, std::string json,
+	                                                 Supervisor::NodeConfig config);
+
+	/**
+	 * Destroys a node forked from a template, along with the template if
+	 * no other nodes use it.
+	 */
+	void DestroyFromTemplate(const std::string& name);
+
+	void SendToTemplate(Template* t, std::string_view msg);
+
+	void FlushTemplate(Template* t);
+
+	void ProcessTemplateMessages(Template* t);
+
 	int AliveNodeCount() const;
 
 	void KillNodes(int signal);
@@ -118,8 +181,11 @@ struct Stem
 	std::unique_ptr<detail::Flare> signal_flare;
 	std::unique_ptr<detail::PipePair> pipe;
 	std::map<std::string, SupervisorNode> nodes;
+	std::map<std::string, Template> templates; // keyed by template_key()
+	std::map<std::string, std::string> templated_nodes; // node name -> template key
 	std::string msg_buffer;
 	bool shutting_down = false;
+	bool is_template;
 	};
 	}
 
@@ -186,6 +252,46 @@ static std::string make_create_message(const Supervisor::NodeConfig& node)
 	return util::fmt("create %s %s", node.name.data(), json_str.data());
 	}
 
+// Describes everything that a node template's scripts may depend on: the
+// node's configuration except for what gets applied to nodes only after
+// forking them from the template.  Nodes with the same key share a
+// template.
+static std::string template_key(const Supervisor::NodeConfig& config)
+	{
+	std::string rval;
+
+	auto add = [&rval](std::string_view s)
+	{
+		rval += std::to_string(s.size());
+		rval += ':';
+		rval += s;
+	};
+
+	auto it = config.cluster.find(config.name);
+	add(it == config.cluster.end() ? "" : std::to_string(static_cast<int>(it->second.role)));
+	add(config.bare_mode ? (*config.bare_mode ? "T" : "F") : "");
+
+	for ( const auto& s : config.scripts )
+		add(s);
+
+	for ( const auto& [name, val] : config.env )
+		{
+		add(name);
+		add(val);
+		}
+
+	for ( const auto& [name, ep] : config.cluster )
+		{
+		add(name);
+		add(std::to_string(static_cast<int>(ep.role)));
+		add(ep.host);
+		add(std::to_string(ep.port));
+		add(ep.interface.value_or(""));
+		}
+
+	return rval;
+	}
+
 detail::ParentProcessCheckTimer::ParentProcessCheckTimer(double t, double arg_interval)
 	: Timer(t, TIMER_PPID_CHECK), interval(arg_interval)
 	{
@@ -616,9 +722,10 @@ size_t Supervisor::ProcessMessages()
 	}
 
 Stem::Stem(State ss)
-	: parent_pid(ss.parent_pid), signal_flare(new detail::Flare()), pipe(std::move(ss.pipe))
+	: parent_pid(ss.parent_pid), signal_flare(new detail::Flare()), pipe(std::move(ss.pipe)),
+	  is_template(ss.is_template)
 	{
-	util::detail::set_thread_name("zeek.stem");
+	util::detail::set_thread_name(is_template ? "zeek.template" : "zeek.stem");
 	pipe->Swap();
 	stem = this;
 	setsignal(SIGCHLD, stem_signal_handler);
@@ -657,6 +764,18 @@ void Stem::Reap()
 
 		Wait(&node, WNOHANG);
 		}
+
+	for ( auto& t : templates )
+		{
+		auto& process = t.second.process;
+
+		if ( ! process.pid )
+			continue;
+
+		if ( Wait(&process, WNOHANG) && ! process.killed )
+			LogError("Node template of '%s' died, its nodes die with it",
+			         process.Name().data());
+		}
 	}
 
 bool Stem::Wait(SupervisorNode* node, int options) const
@@ -815,6 +934,42 @@ std::optional<SupervisedNode> Stem::Revive()
 		ReportStatus(node);
 		}
 
+	for ( auto& t : templates )
+		{
+		auto& process = t.second.process;
+		auto time_since_spawn = now - process.spawn_time;
+
+		if ( process.pid )
+			{
+			if ( time_since_spawn > revival_reset )
+				{
+				process.revival_attempts = 0;
+				process.revival_delay = 1;
+				}
+
+			continue;
+			}
+
+		auto delay = std::chrono::seconds(process.revival_delay);
+
+		if ( time_since_spawn < delay )
+			continue;
+
+		++process.revival_attempts;
+
+		if ( process.revival_attempts % attempts_before_delay_increase == 0 )
+			process.revival_delay *= delay_increase_factor;
+
+		auto spawn_res = SpawnTemplate(&t.second);
+
+		if ( std::holds_alternative<SupervisedNode>(spawn_res) )
+			return std::get<SupervisedNode>(spawn_res);
+
+		if ( std::get<bool>(spawn_res) )
+			LogError("Node template of '%s' (PID %d) revived after premature exit",
+			         process.Name().data(), process.pid);
+		}
+
 	return {};
 	}
 
@@ -854,6 +1009,146 @@ std::variant<bool, SupervisedNode> Stem::Spawn(SupervisorNode* node)
 	return true;
 	}
 
+std::variant<bool, SupervisedNode> Stem::SpawnTemplate(Template* t)
+	{
+	auto& process = t->process;
+	auto ppid = getpid();
+	auto template_pipe = std::make_unique<detail::PipePair>(FD_CLOEXEC, O_NONBLOCK);
+	auto fork_res = fork_with_stdio_redirect(
+		util::fmt("node template %s", process.Name().data()));
+	auto template_pid = fork_res.pid;
+
+	if ( template_pid == -1 )
+		{
+		LogError("failed to fork Zeek node template for '%s': %s", process.Name().data(),
+		         strerror(errno));
+		return false;
+		}
+
+	if ( template_pid == 0 )
+		{
+		setsignal(SIGCHLD, SIG_DFL);
+		setsignal(SIGTERM, SIG_DFL);
+		util::detail::set_thread_name("zeek.template");
+		SupervisedNode rval;
+		rval.config = process.config;
+		rval.parent_pid = ppid;
+		// A copy, as this Stem's pipes go away with it.
+		rval.template_pipe = std::make_shared<detail::PipePair>(*template_pipe);
+		return rval;
+		}
+
+	process.pid = template_pid;
+	// Output of the template's nodes comes with their own prefixes.
+	process.stdout_pipe.pipe = std::move(fork_res.stdout_pipe);
+	process.stdout_pipe.stream = stdout;
+	process.stderr_pipe.pipe = std::move(fork_res.stderr_pipe);
+	process.stderr_pipe.stream = stderr;
+	process.spawn_time = std::chrono::steady_clock::now();
+	t->pipe = std::move(template_pipe);
+	t->pending.clear();
+	t->msg_buffer.clear();
+	DBG_STEM("Stem spawned node template: %s (PID %d)", process.Name().data(), process.pid);
+
+	for ( const auto& [name, json] : t->nodes )
+		SendToTemplate(t, util::fmt("create %s %s", name.data(), json.data()));
+
+	return true;
+	}
+
+std::optional<SupervisedNode> Stem::CreateFromTemplate(std::string name, std::string json,
+                                                       Supervisor::NodeConfig config)
+	{
+	auto key = template_key(config);
+	auto it = templates.find(key);
+
+	templated_nodes[name] = key;
+
+	if ( it != templates.end() )
+		{
+		auto& t = it->second;
+		SendToTemplate(&t, util::fmt("create %s %s", name.data(), json.data()));
+		t.nodes.emplace(std::move(name), std::move(json));
+		return {};
+		}
+
+	it = templates.emplace(key, std::move(config)).first;
+	auto& t = it->second;
+	t.nodes.emplace(std::move(name), std::move(json));
+	DBG_STEM("Stem creating node template: %s", t.process.Name().data());
+	auto spawn_res = SpawnTemplate(&t);
+
+	if ( std::holds_alternative<SupervisedNode>(spawn_res) )
+		return std::get<SupervisedNode>(spawn_res);
+
+	return {};
+	}
+
+void Stem::DestroyFromTemplate(const std::string& name)
+	{
+	auto tn = templated_nodes.find(name);
+	auto it = templates.find(tn->second);
+	auto& t = it->second;
+	templated_nodes.erase(tn);
+	t.nodes.erase(name);
+
+	if ( ! t.nodes.empty() )
+		{
+		SendToTemplate(&t, util::fmt("destroy %s", name.data()));
+		return;
+		}
+
+	// Without any nodes left, the template isn't needed anymore.  Its
+	// Stem takes the last node down with it.
+	DBG_STEM("Stem destroying node template: %s (PID %d)", t.process.Name().data(),
+	         t.process.pid);
+	Destroy(&t.process);
+	templates.erase(it);
+	}
+
+void Stem::SendToTemplate(Template* t, std::string_view msg)
+	{
+	t->pending.append(msg.data(), msg.size());
+	t->pending.push_back('\0');
+	FlushTemplate(t);
+	}
+
+void Stem::FlushTemplate(Template* t)
+	{
+	if ( ! t->process.pid )
+		// Sent once it's revived.
+		return;
+
+	while ( ! t->pending.empty() )
+		{
+		auto n = write(t->pipe->OutFD(), t->pending.data(), t->pending.size());
+
+		if ( n < 0 )
+			{
+			if ( errno == EINTR )
+				continue;
+
+			if ( errno != EAGAIN && errno != EWOULDBLOCK )
+				LogError("Stem failed to write to node template of '%s': %s",
+				         t->process.Name().data(), strerror(errno));
+
+			return;
+			}
+
+		t->pending.erase(0, n);
+		}
+	}
+
+void Stem::ProcessTemplateMessages(Template* t)
+	{
+	auto [bytes_read, msgs] = read_msgs(t->pipe->InFD(), &t->msg_buffer, '\0');
+
+	// A template's Stem reports the status of its nodes and logs the same
+	// way as this one, so pass its messages on to the Supervisor.
+	for ( const auto& msg : msgs )
+		util::safe_write(pipe->OutFD(), msg.data(), msg.size() + 1);
+	}
+
 int Stem::AliveNodeCount() const
 	{
 	auto rval = 0;
@@ -862,6 +1157,10 @@ int Stem::AliveNodeCount() const
 		if ( n.second.pid )
 			++rval;
 
+	for ( const auto& t : templates )
+		if ( t.second.process.pid )
+			++rval;
+
 	return rval;
 	}
 
@@ -869,6 +1168,9 @@ void Stem::KillNodes(int signal)
 	{
 	for ( auto& n : nodes )
 		KillNode(&n.second, signal);
+
+	for ( auto& t : templates )
+		KillNode(&t.second.process, signal);
 	}
 
 void Stem::Shutdown(int exit_code)
@@ -976,8 +1278,9 @@ SupervisedNode Stem::Run()
 std::optional<SupervisedNode> Stem::Poll()
 	{
 	std::map<std::string, int> node_pollfd_indices;
+	std::map<std::string, int> template_pollfd_indices;
 	constexpr auto fixed_fd_count = 2;
-	const auto total_fd_count = fixed_fd_count + (nodes.size() * 2);
+	const auto total_fd_count = fixed_fd_count + (nodes.size() * 2) + (templates.size() * 4);
 	auto pfds = std::make_unique<pollfd[]>(total_fd_count);
 	int pfd_idx = 0;
 	pfds[pfd_idx++] = {pipe->InFD(), POLLIN, 0};
@@ -998,6 +1301,33 @@ std::optional<SupervisedNode> Stem::Poll()
 			pfds[pfd_idx++] = {-1, POLLIN, 0};
 		}
 
+	for ( const auto& [key, t] : templates )
+		{
+		template_pollfd_indices[key] = pfd_idx;
+		const auto& process = t.process;
+
+		if ( t.pipe )
+			{
+			pfds[pfd_idx++] = {t.pipe->InFD(), POLLIN, 0};
+			pfds[pfd_idx++] = {t.pending.empty() ? -1 : t.pipe->OutFD(), POLLOUT, 0};
+			}
+		else
+			{
+			pfds[pfd_idx++] = {-1, POLLIN, 0};
+			pfds[pfd_idx++] = {-1, POLLOUT, 0};
+			}
+
+		if ( process.stdout_pipe.pipe )
+			pfds[pfd_idx++] = {process.stdout_pipe.pipe->ReadFD(), POLLIN, 0};
+		else
+			pfds[pfd_idx++] = {-1, POLLIN, 0};
+
+		if ( process.stderr_pipe.pipe )
+			pfds[pfd_idx++] = {process.stderr_pipe.pipe->ReadFD(), POLLIN, 0};
+		else
+			pfds[pfd_idx++] = {-1, POLLIN, 0};
+		}
+
 	// Note: the poll timeout here is for periodically checking if the parent
 	// process died (see below).
 	constexpr auto poll_timeout_ms = 1000;
@@ -1063,6 +1393,23 @@ std::optional<SupervisedNode> Stem::Poll()
 			node.stderr_pipe.Process();
 		}
 
+	for ( auto& [key, t] : templates )
+		{
+		auto idx = template_pollfd_indices[key];
+
+		if ( pfds[idx].revents )
+			ProcessTemplateMessages(&t);
+
+		if ( pfds[idx + 1].revents )
+			FlushTemplate(&t);
+
+		if ( pfds[idx + 2].revents )
+			t.process.stdout_pipe.Process();
+
+		if ( pfds[idx + 3].revents )
+			t.process.stderr_pipe.Process();
+		}
+
 	if ( ! pfds[0].revents )
 		// No messages from supervisor to process, so return early.
 		return {};
@@ -1094,6 +1441,18 @@ std::optional<SupervisedNode> Stem::Poll()
 			const auto& node_json = msg_tokens[2];
 			assert(nodes.find(node_name) == nodes.end());
 			auto node_config = Supervisor::NodeConfig::FromJSON(node_json);
+
+			// Within a template, the nodes get forked right here.
+			if ( node_config.preparse && ! is_template )
+				{
+				auto new_node = CreateFromTemplate(node_name, node_json, std::move(node_config));
+
+				if ( new_node )
+					return new_node;
+
+				continue;
+				}
+
 			auto it = nodes.emplace(node_name, std::move(node_config)).first;
 			auto& node = it->second;
 
@@ -1107,6 +1466,13 @@ std::optional<SupervisedNode> Stem::Poll()
 			}
 		else if ( cmd == "destroy" )
 			{
+			if ( templated_nodes.count(node_name) )
+				{
+				DBG_STEM("Stem destroying node from template: %s", node_name.data());
+				DestroyFromTemplate(node_name);
+				continue;
+				}
+
 			auto it = nodes.find(node_name);
 			auto& node = it->second;
 			DBG_STEM("Stem destroying node: %s (PID %d)", node_name.data(), node.pid);
@@ -1115,6 +1481,15 @@ std::optional<SupervisedNode> Stem::Poll()
 			}
 		else if ( cmd == "restart" )
 			{
+			if ( auto tn = templated_nodes.find(node_name); tn != templated_nodes.end() )
+				{
+				// Quick, since the template forks it again right away.
+				DBG_STEM("Stem restarting node from template: %s", node_name.data());
+				SendToTemplate(&templates.find(tn->second)->second,
+				               util::fmt("restart %s", node_name.data()));
+				continue;
+				}
+
 			auto it = nodes.find(node_name);
 			assert(it != nodes.end());
 			auto& node = it->second;
@@ -1249,6 +1624,8 @@ Supervisor::NodeConfig Supervisor::NodeConfig::FromRecord(const RecordVal* node)
 	if ( bare_mode_val )
 		rval.bare_mode = bare_mode_val->AsBool();
 
+	rval.preparse = node->GetFieldOrDefault("preparse")->AsBool();
+
 	auto scripts_val = node->GetField("scripts")->AsVectorVal();
 
 	for ( auto i = 0u; i < scripts_val->Size(); ++i )
@@ -1325,6 +1702,9 @@ Supervisor::NodeConfig Supervisor::NodeConfig::FromJSON(std::string_view json)
 	if ( auto it = j.FindMember("bare_mode"); it != j.MemberEnd() )
 		rval.bare_mode = it->value.GetBool();
 
+	if ( auto it = j.FindMember("preparse"); it != j.MemberEnd() )
+		rval.preparse = it->value.GetBool();
+
 	auto& scripts = j["scripts"];
 
 	for ( auto it = scripts.Begin(); it != scripts.End(); ++it )
@@ -1389,6 +1769,8 @@ RecordValPtr Supervisor::NodeConfig::ToRecord() const
 	if ( bare_mode )
 		rval->AssignField("bare_mode", *bare_mode);
 
+	rval->AssignField("preparse", preparse);
+
 	auto st = rt->GetFieldType<VectorType>("scripts");
 	auto scripts_val = make_intrusive<VectorVal>(std::move(st));
 
@@ -1511,7 +1893,7 @@ bool SupervisedNode::InitCluster() const
 	return true;
 	}
 
-void SupervisedNode::Init(Options* options) const
+void SupervisedNode::InitProcess() const
 	{
 	const auto& node_name = config.name;
 
@@ -1563,6 +1945,15 @@ void SupervisedNode::Init(Options* options) const
 			fprintf(stderr, "node '%s' failed to set CPU affinity: %s\n", node_name.data(),
 			        strerror(errno));
 		}
+	}
+
+void SupervisedNode::Init(Options* options) const
+	{
+	const auto& node_name = config.name;
+
+	// A template leaves this to the nodes it forks.
+	if ( ! IsTemplate() )
+		InitProcess();
 
 	if ( ! config.env.empty() )
 		{
@@ -1591,13 +1982,61 @@ void SupervisedNode::Init(Options* options) const
 	if ( config.bare_mode )
 		options->bare_mode = *config.bare_mode;
 
-	if ( config.interface )
+	if ( config.interface && ! IsTemplate() )
 		options->interface = *config.interface;
 
 	for ( const auto& s : config.scripts )
 		options->scripts_to_load.emplace_back(s);
 	}
 
+void SupervisedNode::InitPostFork(Options* options, std::string_view template_name) const
+	{
+	const auto& node_name = config.name;
+
+	InitProcess();
+
+	if ( ! config.cluster.empty() )
+		{
+		if ( setenv("CLUSTER_NODE", node_name.data(), true) == -1 )
+			{
+			fprintf(stderr, "node '%s' failed to setenv: %s\n", node_name.data(), strerror(errno));
+			exit(1);
+			}
+		}
+
+	options->interface = config.interface;
+
+	// Scripts may have taken on the name of the node the template was
+	// created for while loading.  Those of the cluster framework did.
+	for ( const auto& id_name : {"Cluster::node", "peer_description"} )
+		{
+		const auto& id = id::find(id_name);
+
+		if ( ! id || ! id->GetVal() || id->GetType()->Tag() != TYPE_STRING )
+			continue;
+
+		if ( id->GetVal()->AsStringVal()->ToStdString() == template_name )
+			id->SetVal(make_intrusive<StringVal>(node_name));
+		}
+	}
+
+void Supervisor::RunTemplate(Options* options)
+	{
+	auto template_name = supervised_node->config.name;
+
+	Stem::State ss;
+	ss.pipe = std::make_unique<detail::PipePair>(*supervised_node->template_pipe);
+	ss.parent_pid = supervised_node->parent_pid;
+	ss.is_template = true;
+
+		{
+		Stem stem{std::move(ss)};
+		supervised_node = stem.Run();
+		}
+
+	supervised_node->InitPostFork(options, template_name);
+	}
+
 RecordValPtr Supervisor::Status(std::string_view node_name)
 	{
 	auto rval = make_intrusive<RecordVal>(BifType::Record::Supervisor::Status);
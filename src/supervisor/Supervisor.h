@@ -197,6 +197,12 @@ public:
 		 * node inherits the bare-mode status of the supervisor.
 		 */
 		std::optional<bool> bare_mode;
+		/**
+		 * Whether to fork the node from a process that already loaded the
+		 * scripts for nodes of its kind, rather than having it load them
+		 * itself.
+		 */
+		bool preparse = false;
 		/**
 		 * Additional script filename/paths that the node should load.
 		 */
@@ -231,6 +237,18 @@ public:
 	 */
 	static const std::optional<detail::SupervisedNode>& ThisNode() { return supervised_node; }
 
+	/**
+	 * Turns a node template into a Stem that forks the nodes it was created
+	 * for from the current process image.  Called once the template has
+	 * loaded its scripts.  The template itself does not return from this,
+	 * but the nodes it forks do, after applying the parts of their
+	 * configuration that don't affect script loading.  ThisNode() then
+	 * describes the node.
+	 * @param options  the Zeek options to modify as appropriate for the
+	 * node's configuration.
+	 */
+	static void RunTemplate(Options* options);
+
 	using NodeMap = std::map<std::string, detail::SupervisorNode, std::less<>>;
 
 	/**
@@ -385,7 +403,23 @@ struct SupervisedNode
 	void Init(Options* options) const;
 
 	/**
-	 * The node's configuration options.
+	 * Initialize a Supervised node forked from a node template, applying
+	 * what Init() leaves out for templates.
+	 * @param options  the Zeek options to extend/modify as appropriate
+	 * for the node's configuration.
+	 * @param template_name  the name of the node that the template was
+	 * created for, which its scripts may have picked up.
+	 */
+	void InitPostFork(Options* options, std::string_view template_name) const;
+
+	/**
+	 * @return  true if this is a node template rather than a node.
+	 */
+	bool IsTemplate() const { return template_pipe != nullptr; }
+
+	/**
+	 * The node's configuration options.  For a node template, those of
+	 * the node it was created for.
 	 */
 	Supervisor::NodeConfig config;
 	/**
@@ -393,6 +427,16 @@ struct SupervisedNode
 	 * of the Stem process).
 	 */
 	pid_t parent_pid;
+	/**
+	 * For a node template, bidirectional pipes that allow the Stem and the
+	 * template to talk.
+	 */
+	std::shared_ptr<detail::PipePair> template_pipe;
+
+private:
+	// Applies the configuration that concerns the node's process, but
+	// not its scripts.
+	void InitProcess() const;
 	};
 
 /**
@@ -31,6 +31,17 @@ Manager::~Manager() { }
 
 void Manager::InitPostScript() { }
 
+void Manager::SyncShardedMetrics(bool force)
+	{
+	auto now = std::chrono::steady_clock::now();
+
+	if ( ! force && now - last_shard_sync < SHARD_SYNC_INTERVAL )
+		return;
+
+	last_shard_sync = now;
+	detail::sync_sharded_metrics();
+	}
+
 void Manager::InitPostBrokerSetup(broker::endpoint& ep)
 	{
 	auto reg = NativeManager::merge(NativeManager{pimpl.get()}, ep);
@@ -451,3 +462,82 @@ SCENARIO("telemetry managers provide access to histogram families")
 			}
 		}
 	}
+
+SCENARIO("sharded metrics collect values per thread until synced")
+	{
+	GIVEN("a telemetry manager")
+		{
+		Manager mgr;
+		WHEN("incrementing a sharded counter from several threads")
+			{
+			ShardedCounter<> counter{mgr.CounterSingleton("zeek", "sharded-count", "test")};
+			std::vector<std::thread> threads;
+			for ( int i = 0; i < 4; ++i )
+				threads.emplace_back(
+					[&counter]
+					{
+						for ( int j = 0; j < 1000; ++j )
+							counter.Inc();
+					});
+			counter.Inc(10);
+			for ( auto& t : threads )
+				t.join();
+			THEN("the increments only show up in the underlying counter once synced")
+				{
+				CHECK_EQ(counter.Value(), 4010);
+				CHECK_EQ(counter.Target().Value(), 0);
+				mgr.SyncShardedMetrics(true);
+				CHECK_EQ(counter.Target().Value(), 4010);
+				counter.Inc(5);
+				mgr.SyncShardedMetrics(true);
+				CHECK_EQ(counter.Target().Value(), 4015);
+				}
+			}
+		WHEN("adding observations to a sharded histogram")
+			{
+			int64_t buckets[] = {10, 20};
+			auto hist = mgr.ShardedHistogramInstance<int64_t>("zeek", "sharded-hist",
+			                                                  {{"kind", "test"}}, buckets, "test");
+			std::thread t{[&hist]
+			              {
+							  hist->Observe(1);
+							  hist->Observe(9);
+							  hist->Observe(10);
+						  }};
+			hist->Observe(11);
+			hist->Observe(19);
+			hist->Observe(20);
+			hist->Observe(21);
+			t.join();
+			THEN("syncing adds up the cumulative bucket counts and the sum")
+				{
+				CHECK_EQ(hist->Sum(), 0);
+				mgr.SyncShardedMetrics(true);
+				CHECK_EQ(hist->Sum(), 91);
+				CHECK_EQ(hist->Count(), 7);
+				CHECK_EQ(hist->CountAt(0), 3);
+				CHECK_EQ(hist->CountAt(1), 6);
+				CHECK_EQ(hist->CountAt(2), 7);
+				hist->Observe(5);
+				hist->Observe(30);
+				mgr.SyncShardedMetrics(true);
+				CHECK_EQ(hist->Sum(), 126);
+				CHECK_EQ(hist->CountAt(0), 4);
+				CHECK_EQ(hist->CountAt(1), 7);
+				CHECK_EQ(hist->CountAt(2), 9);
+				}
+			}
+		WHEN("destroying sharded metrics")
+			{
+			auto counter = std::make_unique<ShardedCounter<>>(
+				mgr.CounterSingleton("zeek", "sharded-final-count", "test"));
+			auto target = counter->Target();
+			counter->Inc(3);
+			counter.reset();
+			THEN("what they collected since the last sync still shows up")
+				{
+				CHECK_EQ(target.Value(), 3);
+				}
+			}
+		}
+	}
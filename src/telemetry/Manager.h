@@ -2,8 +2,11 @@
 
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <initializer_list>
+#include <memory>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -12,6 +15,7 @@
 #include "zeek/telemetry/Counter.h"
 #include "zeek/telemetry/Gauge.h"
 #include "zeek/telemetry/Histogram.h"
+#include "zeek/telemetry/Sharded.h"
 
 #include "broker/telemetry/fwd.hh"
 
@@ -50,6 +54,18 @@ public:
 	 */
 	virtual void InitPostScript();
 
+	/**
+	 * Adds what sharded metrics collected since the last call to their
+	 * underlying metrics. The main loop calls this regularly, which only
+	 * does work once per SHARD_SYNC_INTERVAL unless @p force is set.
+	 */
+	void SyncShardedMetrics(bool force = false);
+
+	/**
+	 * How often the main loop syncs sharded metrics.
+	 */
+	static constexpr std::chrono::milliseconds SHARD_SYNC_INTERVAL{1000};
+
 	/**
 	 * @return A counter metric family. Creates the family lazily if necessary.
 	 * @param prefix The prefix (namespace) this family belongs to.
@@ -388,6 +404,67 @@ public:
 		return fam.GetOrAdd({});
 		}
 
+	/**
+	 * Creates a sharded histogram, along with the counters it exports to.
+	 * Those are `<name>-bucket`, with the bucket's upper bound as an extra
+	 * `le` label, `<name>-count` and `<name>-sum`. Creates the hosting
+	 * metric families lazily if necessary.
+	 * @param prefix The prefix (namespace) this family belongs to.
+	 * @param name The human-readable name of the metric, e.g., `latency`.
+	 * @param labels Values for all label dimensions of the metric.
+	 * @param upper_bounds Upper bounds of the buckets, in increasing order.
+	 * @param helptext Short explanation of the metric.
+	 * @param unit Unit of measurement of the observations.
+	 */
+	template <class ValueType = int64_t>
+	std::unique_ptr<ShardedHistogram<ValueType>>
+	ShardedHistogramInstance(std::string_view prefix, std::string_view name,
+	                         Span<const LabelView> labels, ConstSpan<ValueType> upper_bounds,
+	                         std::string_view helptext, std::string_view unit = "1")
+		{
+		std::string base{name};
+		std::vector<std::string_view> label_names;
+
+		for ( const auto& label : labels )
+			label_names.emplace_back(label.first);
+
+		auto count = CounterFamily(prefix, base + "-count", label_names, helptext)
+		                 .GetOrAdd(labels);
+		auto sum = CounterFamily<ValueType>(prefix, base + "-sum", label_names, helptext, unit)
+		               .GetOrAdd(labels);
+
+		label_names.emplace_back("le");
+		auto bucket_family = CounterFamily(prefix, base + "-bucket", label_names, helptext);
+		std::vector<LabelView> bucket_labels{labels.begin(), labels.end()};
+		bucket_labels.emplace_back("le", "");
+		std::vector<IntCounter> buckets;
+
+		for ( size_t i = 0; i <= upper_bounds.size(); ++i )
+			{
+			auto le = i < upper_bounds.size() ? detail::format_upper_bound(upper_bounds[i])
+			                                   : std::string{"+Inf"};
+			bucket_labels.back().second = le;
+			buckets.emplace_back(bucket_family.GetOrAdd(bucket_labels));
+			}
+
+		std::vector<ValueType> bounds{upper_bounds.begin(), upper_bounds.end()};
+		return std::make_unique<ShardedHistogram<ValueType>>(std::move(bounds), std::move(buckets),
+		                                                     count, sum);
+		}
+
+	/// @copydoc ShardedHistogramInstance
+	template <class ValueType = int64_t>
+	std::unique_ptr<ShardedHistogram<ValueType>>
+	ShardedHistogramInstance(std::string_view prefix, std::string_view name,
+	                         std::initializer_list<LabelView> labels,
+	                         ConstSpan<ValueType> upper_bounds, std::string_view helptext,
+	                         std::string_view unit = "1")
+		{
+		auto lbl_span = Span{labels.begin(), labels.size()};
+		return ShardedHistogramInstance<ValueType>(prefix, name, lbl_span, upper_bounds, helptext,
+		                                           unit);
+		}
+
 protected:
 	template <class F> static void WithLabelNames(Span<const LabelView> xs, F continuation)
 		{
@@ -414,6 +491,8 @@ protected:
 	void InitPostBrokerSetup(broker::endpoint&);
 
 	IntrusivePtr<broker::telemetry::metric_registry_impl> pimpl;
+
+	std::chrono::steady_clock::time_point last_shard_sync;
 	};
 
 	} // namespace zeek::telemetry
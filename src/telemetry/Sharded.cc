@@ -0,0 +1,79 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/telemetry/Sharded.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <mutex>
+#include <unordered_set>
+
+namespace zeek::telemetry::detail
+	{
+
+namespace
+	{
+
+struct Registry
+	{
+	std::mutex lock;
+	std::unordered_set<ShardedMetric*> metrics;
+	};
+
+// Never destroyed, so that metrics with static storage duration can still
+// unregister at exit.
+Registry& registry()
+	{
+	static auto* rval = new Registry;
+	return *rval;
+	}
+
+	} // namespace
+
+size_t next_shard_index() noexcept
+	{
+	static std::atomic<size_t> next{0};
+	return std::min(next.fetch_add(1, std::memory_order_relaxed), NUM_SHARDS);
+	}
+
+void ShardedMetric::Register()
+	{
+	auto& r = registry();
+	std::lock_guard<std::mutex> guard{r.lock};
+	r.metrics.insert(this);
+	}
+
+void ShardedMetric::Unregister()
+	{
+	auto& r = registry();
+	std::lock_guard<std::mutex> guard{r.lock};
+	r.metrics.erase(this);
+
+	// Holding the lock keeps this from overlapping with a sync of all
+	// metrics.
+	Sync();
+	}
+
+void sync_sharded_metrics()
+	{
+	auto& r = registry();
+	std::lock_guard<std::mutex> guard{r.lock};
+
+	for ( auto* m : r.metrics )
+		m->Sync();
+	}
+
+std::string format_upper_bound(int64_t bound)
+	{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%" PRId64, bound);
+	return buf;
+	}
+
+std::string format_upper_bound(double bound)
+	{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%g", bound);
+	return buf;
+	}
+
+	} // namespace zeek::telemetry::detail
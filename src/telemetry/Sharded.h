@@ -0,0 +1,308 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "zeek/telemetry/Counter.h"
+
+namespace zeek::telemetry
+	{
+
+namespace detail
+	{
+
+/**
+ * The number of shards that threads update without atomic instructions.
+ * Threads beyond this many share one more shard, which they update
+ * atomically.
+ */
+constexpr size_t NUM_SHARDS = 16;
+
+/**
+ * Hands out the next shard index for a thread using sharded metrics for
+ * the first time.
+ */
+extern size_t next_shard_index() noexcept;
+
+/**
+ * @return The index of the calling thread's shard, at most NUM_SHARDS.
+ */
+inline size_t shard_index() noexcept
+	{
+	thread_local size_t idx = next_shard_index();
+	return idx;
+	}
+
+/**
+ * Adds @p amount to a value of shard @p idx. Shards belonging to a single
+ * thread get updated with plain loads and stores, which is safe since only
+ * that thread ever writes to them.
+ */
+template <class T> void shard_add(std::atomic<T>& v, T amount, size_t idx) noexcept
+	{
+	if ( idx < NUM_SHARDS )
+		{
+		v.store(v.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+		return;
+		}
+
+	if constexpr ( std::is_integral_v<T> )
+		v.fetch_add(amount, std::memory_order_relaxed);
+	else
+		{
+		auto old = v.load(std::memory_order_relaxed);
+
+		while ( ! v.compare_exchange_weak(old, old + amount, std::memory_order_relaxed) )
+			;
+		}
+	}
+
+/**
+ * Base class for metrics that collect values in per-thread shards and
+ * only add them to a regular metric when synced. Instances register
+ * themselves for Manager::SyncShardedMetrics() once fully constructed.
+ */
+class ShardedMetric
+	{
+public:
+	ShardedMetric() = default;
+	virtual ~ShardedMetric() = default;
+
+	ShardedMetric(const ShardedMetric&) = delete;
+	ShardedMetric& operator=(const ShardedMetric&) = delete;
+
+	/**
+	 * Adds everything collected since the last call to the underlying
+	 * metric. Calls are serialized by the caller.
+	 */
+	virtual void Sync() = 0;
+
+protected:
+	void Register();
+
+	// Syncs one last time and stops syncing. Must be called by the
+	// destructors of derived classes.
+	void Unregister();
+	};
+
+/**
+ * Syncs all sharded metrics. May get called from any thread.
+ */
+extern void sync_sharded_metrics();
+
+/**
+ * Formats the upper bound of a histogram bucket for its label.
+ */
+extern std::string format_upper_bound(int64_t bound);
+extern std::string format_upper_bound(double bound);
+
+	} // namespace detail
+
+/**
+ * A counter that threads can increment without contending for cache lines
+ * or using atomic instructions, for use on hot paths. Increments only show
+ * up in the underlying counter once synced, which the telemetry manager
+ * does periodically.
+ */
+template <class ValueType = int64_t> class ShardedCounter final : public detail::ShardedMetric
+	{
+public:
+	explicit ShardedCounter(Counter<ValueType> target) : target(target) { Register(); }
+
+	~ShardedCounter() override { Unregister(); }
+
+	/**
+	 * Increments the value by @p amount.
+	 * @pre `amount >= 0`
+	 */
+	void Inc(ValueType amount = 1) noexcept
+		{
+		auto idx = detail::shard_index();
+		detail::shard_add(shards[idx].value, amount, idx);
+		}
+
+	/**
+	 * @return The current value, including increments not yet synced.
+	 */
+	ValueType Value() const noexcept
+		{
+		ValueType rval = 0;
+
+		for ( const auto& s : shards )
+			rval += s.value.load(std::memory_order_relaxed);
+
+		return rval;
+		}
+
+	/**
+	 * @return The underlying counter.
+	 */
+	Counter<ValueType> Target() const noexcept { return target; }
+
+	void Sync() override
+		{
+		auto total = Value();
+
+		if ( total != reported )
+			{
+			target.Inc(total - reported);
+			reported = total;
+			}
+		}
+
+private:
+	struct alignas(64) Shard
+		{
+		std::atomic<ValueType> value{0};
+		};
+
+	Counter<ValueType> target;
+	std::array<Shard, detail::NUM_SHARDS + 1> shards;
+	ValueType reported = 0;
+	};
+
+/**
+ * A histogram that threads can add observations to without contending for
+ * cache lines or using atomic instructions, for use on hot paths. Each
+ * shard counts and sums up observations per bucket.
+ *
+ * Regular histograms only take one observation at a time, so syncing into
+ * one would take as much work as the observations did. Instead, this one
+ * exports to counters laid out like a Prometheus histogram, which syncing
+ * adds each bucket's new observations to at once: one counter per bucket,
+ * counting the observations up to its upper bound, plus counters of all
+ * observations and of their sum. Manager::ShardedHistogramInstance()
+ * creates them.
+ */
+template <class ValueType = double> class ShardedHistogram final : public detail::ShardedMetric
+	{
+public:
+	/**
+	 * Constructor.
+	 * @param bounds The buckets' upper bounds, in increasing order.
+	 * @param buckets Counters of the observations up to each of the bounds,
+	 *                followed by one for all observations.
+	 * @param count Counter of all observations.
+	 * @param sum Counter of the sum of all observations.
+	 */
+	ShardedHistogram(std::vector<ValueType> bounds, std::vector<IntCounter> buckets,
+	                 IntCounter count, Counter<ValueType> sum)
+		: bounds(std::move(bounds)), buckets(std::move(buckets)), count(count), sum(sum)
+		{
+		auto num_buckets = this->bounds.size() + 1;
+		buckets_per_shard = (num_buckets + Line::SIZE - 1) / Line::SIZE * Line::SIZE;
+		lines = std::make_unique<Line[]>((detail::NUM_SHARDS + 1) * buckets_per_shard /
+		                                 Line::SIZE);
+		reported.resize(num_buckets);
+		Register();
+		}
+
+	~ShardedHistogram() override { Unregister(); }
+
+	/**
+	 * Adds @p value to the bucket it falls into.
+	 * @pre `value >= 0`, as the sum is a counter.
+	 */
+	void Observe(ValueType value) noexcept
+		{
+		auto idx = detail::shard_index();
+		auto b = std::lower_bound(bounds.begin(), bounds.end(), value) - bounds.begin();
+		auto& bucket = BucketAt(idx, b);
+		detail::shard_add(bucket.count, int64_t(1), idx);
+		detail::shard_add(bucket.sum, value, idx);
+		}
+
+	/**
+	 * @return The synced number of observations up to the upper bound of
+	 *         bucket @p index, or of all observations for the last index.
+	 */
+	int64_t CountAt(size_t index) const noexcept { return buckets[index].Value(); }
+
+	/**
+	 * @return The synced number of all observations.
+	 */
+	int64_t Count() const noexcept { return count.Value(); }
+
+	/**
+	 * @return The synced sum of all observations.
+	 */
+	ValueType Sum() const noexcept { return sum.Value(); }
+
+	void Sync() override
+		{
+		int64_t new_count = 0;
+		ValueType new_sum = 0;
+
+		for ( size_t b = 0; b <= bounds.size(); ++b )
+			{
+			int64_t n = 0;
+			ValueType s = 0;
+
+			for ( size_t idx = 0; idx <= detail::NUM_SHARDS; ++idx )
+				{
+				const auto& bucket = BucketAt(idx, b);
+				n += bucket.count.load(std::memory_order_relaxed);
+				s += bucket.sum.load(std::memory_order_relaxed);
+				}
+
+			// Buckets count everything below their upper bound.
+			new_count += n - reported[b].first;
+			new_sum += s - reported[b].second;
+			reported[b] = {n, s};
+
+			if ( new_count > 0 )
+				buckets[b].Inc(new_count);
+			}
+
+		if ( new_count > 0 )
+			count.Inc(new_count);
+
+		if ( new_sum > 0 )
+			sum.Inc(new_sum);
+		}
+
+private:
+	struct Bucket
+		{
+		std::atomic<int64_t> count{0};
+		std::atomic<ValueType> sum{0};
+		};
+
+	// Shards start at cache line boundaries.
+	struct alignas(64) Line
+		{
+		static constexpr size_t SIZE = 64 / sizeof(Bucket);
+		Bucket buckets[SIZE];
+		};
+
+	Bucket& BucketAt(size_t idx, size_t b) noexcept
+		{
+		auto i = idx * buckets_per_shard + b;
+		return lines[i / Line::SIZE].buckets[i % Line::SIZE];
+		}
+
+	const Bucket& BucketAt(size_t idx, size_t b) const noexcept
+		{
+		auto i = idx * buckets_per_shard + b;
+		return lines[i / Line::SIZE].buckets[i % Line::SIZE];
+		}
+
+	std::vector<ValueType> bounds;
+	std::vector<IntCounter> buckets;
+	IntCounter count;
+	Counter<ValueType> sum;
+	size_t buckets_per_shard;
+	std::unique_ptr<Line[]> lines;
+	std::vector<std::pair<int64_t, ValueType>> reported; // count and sum per bucket
+	};
+
+	} // namespace zeek::telemetry
@@ -26,6 +26,10 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #if defined(HAVE_MALLINFO) || defined(HAVE_MALLINFO2)
 #include <malloc.h>
 #endif
@@ -1314,6 +1318,45 @@ const char* strpbrk_n(size_t len, const char* s, const char* charset)
 	return nullptr;
 	}
 
+TEST_CASE("util find_line_delimiter")
+	{
+	const u_char s[] = "0123456789abcdefghij\r\nxyz";
+	const u_char* end = s + sizeof(s) - 1;
+	CHECK(find_line_delimiter(s, end) == s + 20);
+	CHECK(find_line_delimiter(s + 21, end) == s + 21);
+	CHECK(find_line_delimiter(s + 22, end) == end);
+	CHECK(find_line_delimiter(s, s + 5) == s + 5);
+
+	const u_char n[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+	CHECK(find_line_delimiter(n, n + sizeof(n)) == n + sizeof(n) - 1);
+	}
+
+const unsigned char* find_line_delimiter(const unsigned char* s, const unsigned char* end)
+	{
+#ifdef __SSE2__
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i lf = _mm_set1_epi8('\n');
+	const __m128i nul = _mm_setzero_si128();
+
+	for ( ; end - s >= 16; s += 16 )
+		{
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+		__m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, cr),
+		                                         _mm_cmpeq_epi8(chunk, lf)),
+		                            _mm_cmpeq_epi8(chunk, nul));
+
+		if ( int mask = _mm_movemask_epi8(hits) )
+			return s + __builtin_ctz(mask);
+		}
+#endif
+
+	for ( ; s < end; ++s )
+		if ( *s == '\r' || *s == '\n' || *s == '\0' )
+			return s;
+
+	return end;
+	}
+
 #ifndef HAVE_STRCASESTR
 
 TEST_CASE("util strcasestr")
@@ -2125,6 +2168,11 @@ uint64_t calculate_unique_id(size_t pool)
 	return zeek::detail::HashKey::HashBytes(&(uid_pool[pool].key), sizeof(uid_pool[pool].key));
 	}
 
+void reset_unique_ids()
+	{
+	uid_pool.clear();
+	}
+
 bool safe_write(int fd, const char* data, int len)
 	{
 	while ( len > 0 )
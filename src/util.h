@@ -330,6 +330,10 @@ extern unsigned char encode_hex(int h);
 template <class T> int atoi_n(int len, const char* s, const char** end, int base, T& result);
 extern char* uitoa_n(uint64_t value, char* str, int n, int base, const char* prefix = nullptr);
 extern const char* strpbrk_n(size_t len, const char* s, const char* charset);
+
+// Returns a pointer to the first CR, LF or NUL in [s, end), or end if there
+// is none. Scans 16 bytes at a time where SSE2 is available.
+extern const unsigned char* find_line_delimiter(const unsigned char* s, const unsigned char* end);
 int strstr_n(const int big_len, const unsigned char* big, const int little_len,
              const unsigned char* little);
 
@@ -434,6 +438,10 @@ extern int time_compare(struct timeval* tv_a, struct timeval* tv_b);
 extern uint64_t calculate_unique_id();
 extern uint64_t calculate_unique_id(const size_t pool);
 
+// Forgets the instance IDs of all UID pools, so that a forked process
+// calculates its own ones rather than repeating its parent's UIDs.
+extern void reset_unique_ids();
+
 // Use for map's string keys.
 struct ltstr
 	{
@@ -111,6 +111,8 @@ zeek::EventRegistry* zeek::event_registry = nullptr;
 zeek::detail::ProfileLogger* zeek::detail::profiling_logger = nullptr;
 zeek::detail::ProfileLogger* zeek::detail::segment_logger = nullptr;
 zeek::detail::SampleLogger* zeek::detail::sample_logger = nullptr;
+zeek::detail::HandlerProfiler* zeek::detail::handler_profiler = nullptr;
+zeek::detail::PacketStageProfiler* zeek::detail::packet_stage_profiler = nullptr;
 
 zeek::detail::FragmentManager* zeek::detail::fragment_mgr = nullptr;
 
@@ -128,6 +130,9 @@ zeek::OpaqueTypePtr entropy_type;
 zeek::OpaqueTypePtr cardinality_type;
 zeek::OpaqueTypePtr topk_type;
 zeek::OpaqueTypePtr bloomfilter_type;
+zeek::OpaqueTypePtr countmin_type;
+zeek::OpaqueTypePtr quantile_type;
+zeek::OpaqueTypePtr cuckoofilter_type;
 zeek::OpaqueTypePtr x509_opaque_type;
 zeek::OpaqueTypePtr ocsp_resp_opaque_type;
 zeek::OpaqueTypePtr paraglob_type;
@@ -295,6 +300,10 @@ static void terminate_bro()
 
 	script_coverage_mgr.WriteStats();
 
+	// Bring metrics collected on hot paths up to date for zeek_done.
+	if ( telemetry_mgr )
+		telemetry_mgr->SyncShardedMetrics(true);
+
 	if ( zeek_done )
 		event_mgr.Enqueue(zeek_done, Args{});
 
@@ -386,6 +395,31 @@ static std::vector<std::string> get_script_signature_files()
 	return rval;
 	}
 
+// Reads the signature files given on the command line and through scripts.
+// Returns false if that failed.
+static bool load_signatures(const Options& options)
+	{
+	std::vector<SignatureFile> all_signature_files;
+
+	// Append signature files given on the command line
+	for ( const auto& sf : options.signature_files )
+		all_signature_files.emplace_back(sf);
+
+	// Append signature files defined in "signature_files" script option
+	for ( auto&& sf : get_script_signature_files() )
+		all_signature_files.emplace_back(std::move(sf));
+
+	// Append signature files defined in @load-sigs
+	for ( const auto& sf : zeek::detail::sig_files )
+		all_signature_files.emplace_back(sf);
+
+	if ( all_signature_files.empty() )
+		return true;
+
+	rule_matcher = new RuleMatcher(options.signature_re_level);
+	return rule_matcher->ReadFiles(all_signature_files);
+	}
+
 SetupResult setup(int argc, char** argv, Options* zopts)
 	{
 	ZEEK_LSAN_DISABLE();
@@ -620,6 +654,9 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 	cardinality_type = make_intrusive<OpaqueType>("cardinality");
 	topk_type = make_intrusive<OpaqueType>("topk");
 	bloomfilter_type = make_intrusive<OpaqueType>("bloomfilter");
+	countmin_type = make_intrusive<OpaqueType>("countmin");
+	quantile_type = make_intrusive<OpaqueType>("quantile");
+	cuckoofilter_type = make_intrusive<OpaqueType>("cuckoofilter");
 	x509_opaque_type = make_intrusive<OpaqueType>("x509");
 	ocsp_resp_opaque_type = make_intrusive<OpaqueType>("ocsp_resp");
 	paraglob_type = make_intrusive<OpaqueType>("paraglob");
@@ -636,6 +673,11 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 	dbl_histogram_metric_type = make_intrusive<OpaqueType>("dbl_histogram_metric");
 	dbl_histogram_metric_family_type = make_intrusive<OpaqueType>("dbl_histogram_metric_family");
 
+	// Whether this is a node forked from a template, which got to the
+	// compilation of signatures and scripts already.
+	bool preforked = false;
+	const FuncInfo* init_stmts = nullptr;
+
 	// The leak-checker tends to produce some false
 	// positives (memory which had already been
 	// allocated before we start the checking is
@@ -696,6 +738,32 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 		if ( reporter->Errors() > 0 )
 			exit(1);
 
+		// A node template does the work that all of its nodes share up to
+		// here, plus compiling signatures and scripts, and then forks the
+		// nodes. That needs to happen before anything starts threads.
+		if ( Supervisor::ThisNode() && Supervisor::ThisNode()->IsTemplate() )
+			{
+			if ( ! load_signatures(options) )
+				exit(1);
+
+			init_stmts = stmts ? analyze_global_stmts(stmts) : nullptr;
+			analyze_scripts();
+
+			Supervisor::RunTemplate(&options);
+			preforked = true;
+
+			// Only returns in a node. Those must not share their event
+			// queue, DNS socket, random numbers or connection UIDs.
+			iosource_mgr->InitPostFork();
+			dns_mgr->InitPostFork();
+
+			if ( ! util::detail::have_random_seed() )
+				util::detail::init_random_seed(nullptr, nullptr, false);
+
+			util::reset_unique_ids();
+			run_state::zeek_start_time = util::current_time(true);
+			}
+
 		iosource_mgr->InitPostScript();
 		log_mgr->InitPostScript();
 		plugin_mgr->InitPostScript();
@@ -703,6 +771,7 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 		broker_mgr->InitPostScript();
 		telemetry_mgr->InitPostScript();
 		timer_mgr->InitPostScript();
+		fragment_mgr->InitPostScript();
 		event_mgr.InitPostScript();
 
 		if ( supervisor_mgr )
@@ -743,29 +812,14 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 			id->SetVal(make_intrusive<StringVal>(*options.pcap_filter));
 			}
 
-		std::vector<SignatureFile> all_signature_files;
-
-		// Append signature files given on the command line
-		for ( const auto& sf : options.signature_files )
-			all_signature_files.emplace_back(sf);
-
-		// Append signature files defined in "signature_files" script option
-		for ( auto&& sf : get_script_signature_files() )
-			all_signature_files.emplace_back(std::move(sf));
-
-		// Append signature files defined in @load-sigs
-		for ( const auto& sf : zeek::detail::sig_files )
-			all_signature_files.emplace_back(sf);
-
-		if ( ! all_signature_files.empty() )
+		if ( ! preforked && ! load_signatures(options) )
 			{
-			rule_matcher = new RuleMatcher(options.signature_re_level);
-			if ( ! rule_matcher->ReadFiles(all_signature_files) )
-				{
-				delete dns_mgr;
-				exit(1);
-				}
+			delete dns_mgr;
+			exit(1);
+			}
 
+		if ( rule_matcher )
+			{
 			if ( options.print_signature_debug_info )
 				rule_matcher->PrintDebug();
 
@@ -798,9 +852,11 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 			exit(reporter->Errors() != 0);
 			}
 
-		auto init_stmts = stmts ? analyze_global_stmts(stmts) : nullptr;
-
-		analyze_scripts();
+		if ( ! preforked )
+			{
+			init_stmts = stmts ? analyze_global_stmts(stmts) : nullptr;
+			analyze_scripts();
+			}
 
 		if ( analysis_options.report_recursive )
 			// This option is report-and-exit.
@@ -859,6 +915,12 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 				segment_logger = profiling_logger;
 			}
 
+		if ( handler_profiling_sample_rate > 0 )
+			handler_profiler = new HandlerProfiler(handler_profiling_sample_rate);
+
+		if ( packet_stage_sample_rate > 0 )
+			packet_stage_profiler = new PacketStageProfiler(packet_stage_sample_rate);
+
 		if ( ! run_state::reading_live && ! run_state::reading_traces )
 			// Set up network_time to track real-time, since
 			// we don't have any other source for it.